@@ -0,0 +1,580 @@
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <cairo.h>
+
+#include "fakegw.h"
+#include "gateway.h"
+#include "perf.h"
+#include "trace.h"
+#include "xform.h"
+
+/* ---------- Headless ingest/render benchmark ----------
+ *
+ * Runs the real receive path (NetConn I/O thread, frame parsing,
+ * gateway_push_batch into the tiered histories) against the synthetic
+ * gateway on loopback, and renders the traces with the GUI's Cairo
+ * trace path onto an image surface at a fixed frame rate. At the end it
+ * prints throughput, frame times, latency and CPU time per stage, and
+ * exits non-zero if samples were lost on the way.
+ *
+ *   make bench
+ *   bench/mng_bench --rate 20000 --sensors 5 --seconds 10
+ *   bench/mng_bench --rate 2000 --sensors 32   (advertised ADC channels)
+ *   bench/mng_bench --reconnect   (drop the link halfway, then check that
+ *                                  the histories kept their order)
+ *   bench/mng_bench --mc-group 239.255.0.7 --mc-drop 10
+ *                                 (batches over multicast, every 10th
+ *                                  datagram left out; checks that exactly
+ *                                  those are counted lost)
+ *   bench/mng_bench --serve --port 50012   (gateway for the GUI only)
+ *   bench/mng_bench --serve --mc-group 239.255.0.7   (... with MULTICAST,
+ *                                  for gui_app --multicast)
+ */
+#define BENCH_WIDTH 1200
+#define BENCH_HEIGHT 600
+#define BENCH_SETTLE_MS 2000
+#define BENCH_MC_PORT (PORT + 1)
+
+static gint opt_seconds = 5;
+static gint opt_rate = 1000;
+static gint opt_sensors = SENSOR_COUNT;
+static gint opt_batch_ms = 10;
+static gint opt_fps = 60;
+static gint opt_window_ms = 1000;
+static gint opt_port = 0;
+static gboolean opt_legacy = FALSE;
+static gboolean opt_serve = FALSE;
+static gboolean opt_reconnect = FALSE;
+static gchar *opt_png = NULL;
+static gchar *opt_mc_group = NULL;
+static gint opt_mc_port = BENCH_MC_PORT;
+static gint opt_mc_drop = 0;
+
+static GOptionEntry entries[] = {
+    {"seconds", 0, 0, G_OPTION_ARG_INT, &opt_seconds,
+     "Run time (default 5)", "S"},
+    {"rate", 0, 0, G_OPTION_ARG_INT, &opt_rate,
+     "Samples/s per streaming sensor (default 1000)", "HZ"},
+    {"sensors", 0, 0, G_OPTION_ARG_INT, &opt_sensors,
+     "Number of streaming channels (default 5, up to 64)", "N"},
+    {"batch-ms", 0, 0, G_OPTION_ARG_INT, &opt_batch_ms,
+     "Gateway batch period (default 10)", "MS"},
+    {"fps", 0, 0, G_OPTION_ARG_INT, &opt_fps,
+     "Frames rendered per second (default 60)", "N"},
+    {"window-ms", 0, 0, G_OPTION_ARG_INT, &opt_window_ms,
+     "Visible time window (default 1000)", "MS"},
+    {"legacy-wire", 0, 0, G_OPTION_ARG_NONE, &opt_legacy,
+     "Stream legacy sensor_data_t batches instead of packed", NULL},
+    {"png", 0, 0, G_OPTION_ARG_FILENAME, &opt_png,
+     "Write the last frame to FILE", "FILE"},
+    {"serve", 0, 0, G_OPTION_ARG_NONE, &opt_serve,
+     "Only run the synthetic gateway (for the GUI)", NULL},
+    {"reconnect", 0, 0, G_OPTION_ARG_NONE, &opt_reconnect,
+     "Drop the link halfway through, reconnect and re-CONFIGURE", NULL},
+    {"port", 0, 0, G_OPTION_ARG_INT, &opt_port,
+     "Gateway port (default: any free one, PORT with --serve)", "N"},
+    {"mc-group", 0, 0, G_OPTION_ARG_STRING, &opt_mc_group,
+     "Answer MULTICAST and send the batches to this group", "ADDR"},
+    {"mc-port", 0, 0, G_OPTION_ARG_INT, &opt_mc_port,
+     "UDP port of the group (default 50013)", "N"},
+    {"mc-drop", 0, 0, G_OPTION_ARG_INT, &opt_mc_drop,
+     "Leave out every N-th datagram, N >= 2 (default 0 = none)", "N"},
+    {NULL}};
+
+static int64_t cpu_ns(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* ---------- Receive side (I/O thread) ---------- */
+
+static atomic_int connected = 0;
+static atomic_int resumed = 0; /* back after a drop, not yet set up */
+static atomic_int closed = 0;
+static atomic_int mc_joined = 0; /* 1 joined, -errno if not */
+static _Atomic int64_t io_cpu_ns = 0;   /* whole I/O thread */
+static _Atomic int64_t push_cpu_ns = 0; /* decode + ring insertion */
+
+static void on_frame(NetConn *c, const Frame *f, void *user)
+{
+    Gateway *gw = user;
+    int64_t t_recv = g_get_monotonic_time();
+
+    perf_add(&gw->stats.bytes, f->len);
+
+    if (f->type == FRAME_CHANNELS)
+    {
+        gateway_set_channels(gw, f);
+    }
+    else if (f->type == FRAME_RATES)
+    {
+        sensor_rate_t rates[MAX_CHANNELS];
+        int n = frame_rates(f, rates, MAX_CHANNELS);
+
+        /* Only read by the final report */
+        for (int i = 0; i < n; i++)
+            if (rates[i].sensor_id < MAX_CHANNELS &&
+                gw->chan[rates[i].sensor_id] >= 0)
+                gw->rate_hz[gw->chan[rates[i].sensor_id]] = rates[i].rate_hz;
+    }
+    else if (f->type == FRAME_FORMAT)
+    {
+        /* As in the GUI: datagrams are packed, so only after the ack */
+        gw->wire = frame_format(f);
+        if (opt_mc_group && gw->wire == WIRE_PACKED)
+            net_send(c, "MULTICAST\n");
+    }
+    else if (f->type == FRAME_PONG)
+    {
+        int64_t sent, gw_us;
+        if (frame_pong(f, &sent, &gw_us))
+            clock_pong(&gw->clock, sent, gw_us, t_recv);
+    }
+    else if (f->type == FRAME_BATCH)
+    {
+        int64_t c0 = cpu_ns(CLOCK_THREAD_CPUTIME_ID);
+        uint64_t newest = gateway_push_batch(gw, f, 0);
+        int64_t c1 = cpu_ns(CLOCK_THREAD_CPUTIME_ID);
+        int64_t sampled;
+
+        atomic_fetch_add(&push_cpu_ns, c1 - c0);
+
+        if (newest && clock_to_local(&gw->clock, newest, &sampled))
+        {
+            latency_note(LAT_NET, t_recv - sampled);
+            latency_note(LAT_RING, g_get_monotonic_time() - sampled);
+        }
+    }
+
+    atomic_store(&io_cpu_ns, cpu_ns(CLOCK_THREAD_CPUTIME_ID));
+}
+
+static void on_event(NetConn *c, NetEvent ev, int err, void *user)
+{
+    Gateway *gw = user;
+    (void)c;
+
+    if (ev == NET_EV_CONNECTED)
+    {
+        if (atomic_exchange(&connected, 1))
+            atomic_store(&resumed, 1);
+        return;
+    }
+
+    /* As in the GUI: before any sample of the next session */
+    if (ev == NET_EV_RECONNECTING)
+    {
+        gateway_link_lost(gw);
+        return;
+    }
+
+    if (ev == NET_EV_MULTICAST)
+    {
+        atomic_store(&mc_joined, err ? -err : 1);
+        return;
+    }
+
+    fprintf(stderr, "bench: connection %s: %s\n",
+            ev == NET_EV_CLOSED ? "closed" : "failed", strerror(err));
+    atomic_store(&closed, 1);
+}
+
+static const NetHandlers handlers = {
+    .on_frame = on_frame,
+    .on_event = on_event,
+};
+
+/* ---------- Render side (main thread) ---------- */
+
+static void render_frame(cairo_t *cr, Gateway *gw, uint64_t window)
+{
+    const int plot_w = BENCH_WIDTH, plot_h = BENCH_HEIGHT;
+    uint64_t t_max = 0;
+
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_paint(cr);
+
+    for (int s = 0; s < MAX_CHANNELS; s++)
+    {
+        SensorHistory *h = gateway_hist(gw, s);
+        uint64_t ts;
+
+        if (h && history_latest_ts(h, &ts) && ts > t_max)
+            t_max = ts;
+    }
+
+    uint64_t t_min = t_max > window ? t_max - window : 0;
+
+    /* Every channel that streams, like the GUI with all of them checked */
+    for (int s = 0; s < MAX_CHANNELS; s++)
+    {
+        SensorHistory *h = gateway_hist(gw, s);
+
+        if (!h)
+            continue;
+
+        const double *color = channel_color(s);
+        const ChannelType *type = channel_type(s);
+        TraceStyle st = {
+            .color = {color[0], color[1], color[2]},
+            .y_max = channel_y_max(s),
+            .steps = type->steps,
+        };
+        const double *x, *v;
+        int n = trace_points(h, t_min, window, plot_w, &x, &v);
+
+        if (n >= 2 && type->bits)
+            trace_stroke_bits(cr, &st, type->bits, 0, plot_h, plot_h);
+        else if (n >= 2)
+            trace_stroke(cr, &st, 0, plot_h, plot_h, x, v, n);
+    }
+
+    cairo_surface_flush(cairo_get_target(cr));
+}
+
+static void note_screen_latency(Gateway *gw)
+{
+    uint64_t t0 = atomic_load(&gw->server_t0);
+    uint64_t newest = 0;
+    int64_t sampled;
+
+    for (int s = 0; s < MAX_CHANNELS; s++)
+    {
+        SensorHistory *h = gateway_hist(gw, s);
+        uint64_t ts;
+
+        if (h && history_latest_ts(h, &ts) && ts > newest)
+            newest = ts;
+    }
+
+    if (t0 && clock_to_local(&gw->clock, t0 + newest, &sampled))
+        latency_note(LAT_SCREEN, g_get_monotonic_time() - sampled);
+}
+
+static void send_ping(Gateway *gw)
+{
+    char ping[32];
+
+    snprintf(ping, sizeof(ping), "PING %" PRId64 "\n", g_get_monotonic_time());
+    net_send(gw->conn, ping);
+}
+
+static uint64_t ingested(Gateway *gw)
+{
+    uint64_t n = 0;
+
+    for (int s = 0; s < MAX_CHANNELS; s++)
+        n += atomic_load(&gw->stats.samples[s]);
+    return n;
+}
+
+/* ---------- Reconnect check ---------- */
+
+/* What the GUI does once a dropped link is back: format, rates, START */
+static void resume_stream(Gateway *gw)
+{
+    char cmd[NET_CMD_MAX];
+    int n = snprintf(cmd, sizeof(cmd), "CONFIGURE");
+
+    for (int i = 0; i < opt_sensors && n < (int)sizeof(cmd); i++)
+        if (gw->chan[i] >= 0)
+            n += snprintf(cmd + n, sizeof(cmd) - n, " %s %d",
+                          channel_id(gw->chan[i]), opt_rate);
+    if (n < (int)sizeof(cmd))
+        snprintf(cmd + n, sizeof(cmd) - n, "\n");
+
+    if (!opt_legacy)
+        net_send(gw->conn, "FORMAT PACKED\n");
+    net_send(gw->conn, cmd);
+    net_send(gw->conn, "START\n");
+}
+
+/*
+ * Every level of every history in timestamp order, which the binary
+ * searches of the rings rely on. Counts the slots that are not.
+ */
+static uint64_t histories_unordered(Gateway *gw)
+{
+    uint64_t bad = 0;
+
+    for (int s = 0; s < MAX_CHANNELS; s++)
+    {
+        SensorHistory *h = gateway_hist(gw, s);
+
+        for (int l = 0; h && l <= HISTORY_TIERS; l++)
+        {
+            SampleRing *r = &h->level[l];
+            uint64_t *ts = g_new(uint64_t, r->capacity);
+            int n = ring_snapshot_since(r, 0, ts, NULL, (int)r->capacity);
+
+            for (int i = 1; i < n; i++)
+                if (ts[i] < ts[i - 1])
+                    bad++;
+            g_free(ts);
+        }
+    }
+    return bad;
+}
+
+/* ---------- Driver ---------- */
+
+static int serve(void)
+{
+    FakeGwConfig cfg = {
+        .port = opt_port ? opt_port : PORT,
+        .sensors = opt_sensors,
+        .rate_hz = opt_rate,
+        .batch_ms = opt_batch_ms,
+        .mc_group = opt_mc_group,
+        .mc_port = opt_mc_port,
+        .mc_drop = opt_mc_drop,
+    };
+
+    if (!fakegw_start(&cfg))
+        return 1;
+
+    printf("Synthetic gateway on 127.0.0.1:%d, Ctrl+C to stop\n", cfg.port);
+    if (opt_mc_group)
+        printf("MULTICAST to %s:%d, leaving out every %d-th datagram "
+               "(0 = none)\n",
+               opt_mc_group, opt_mc_port, opt_mc_drop);
+    for (;;)
+        g_usleep(G_USEC_PER_SEC);
+}
+
+int main(int argc, char **argv)
+{
+    GError *err = NULL;
+    GOptionContext *ctx = g_option_context_new("- ingest/render benchmark");
+
+    g_option_context_add_main_entries(ctx, entries, NULL);
+    if (!g_option_context_parse(ctx, &argc, &argv, &err))
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 2;
+    }
+    g_option_context_free(ctx);
+
+    if (opt_sensors < 1 || opt_sensors > MAX_CHANNELS)
+        opt_sensors = SENSOR_COUNT;
+    if (opt_fps < 1)
+        opt_fps = 1;
+    if (opt_mc_drop < 0 || opt_mc_drop == 1)
+    {
+        fprintf(stderr, "bench: --mc-drop must be 0 or at least 2\n");
+        return 2;
+    }
+    if (opt_mc_group && (opt_legacy || opt_reconnect) && !opt_serve)
+    {
+        fprintf(stderr, "bench: --mc-group needs the packed wire and "
+                        "no --reconnect\n");
+        return 2;
+    }
+
+    if (opt_serve)
+        return serve();
+
+    FakeGwConfig cfg = {
+        .port = opt_port,
+        .sensors = opt_sensors,
+        .rate_hz = opt_rate,
+        .batch_ms = opt_batch_ms,
+        .mc_group = opt_mc_group,
+        .mc_port = opt_mc_port,
+        .mc_drop = opt_mc_drop,
+    };
+    FakeGw *fake = fakegw_start(&cfg);
+    if (!fake)
+        return 1;
+
+    Gateway *gw = &gateways[0];
+    gateway_count = 1;
+    g_strlcpy(gw->ip, "127.0.0.1", sizeof(gw->ip));
+    gateway_init_history(gw, DEFAULT_RAW_SAMPLES, DEFAULT_TIER_BUCKETS);
+    gateway_default_channels(gw);
+    gateway_reset(gw);
+    clock_reset(&gw->clock);
+
+    gw->conn = net_open(gw->ip, cfg.port, DEFAULT_CONNECT_TIMEOUT_MS,
+                        &handlers, gw);
+    while (gw->conn && !atomic_load(&connected) && !atomic_load(&closed))
+        g_usleep(1000);
+    if (!gw->conn || atomic_load(&closed))
+        return 1;
+    net_set_reconnect(gw->conn, opt_reconnect);
+
+    if (!opt_legacy)
+        net_send(gw->conn, "FORMAT PACKED\n");
+    send_ping(gw);
+
+    /* Joined before START, so the first datagram is seen and none is
+       missed unnoticed */
+    for (int i = 0; opt_mc_group && !atomic_load(&mc_joined) &&
+                    i < DEFAULT_CONNECT_TIMEOUT_MS && !atomic_load(&closed);
+         i++)
+        g_usleep(1000);
+    if (opt_mc_group && atomic_load(&mc_joined) != 1)
+    {
+        int err = -atomic_load(&mc_joined);
+
+        fprintf(stderr, "bench: FAILED, cannot join %s:%d: %s\n",
+                opt_mc_group, opt_mc_port,
+                err > 0 ? strerror(err) : "no MULTICAST reply");
+        net_close(gw->conn, FALSE);
+        fakegw_stop(fake);
+        return 1;
+    }
+
+    net_send(gw->conn, "START\n");
+
+    cairo_surface_t *surface =
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, BENCH_WIDTH,
+                                   BENCH_HEIGHT);
+    cairo_t *cr = cairo_create(surface);
+
+    uint64_t window = (uint64_t)opt_window_ms * 1000;
+    int64_t frame_us = G_USEC_PER_SEC / opt_fps;
+    int64_t t_start = g_get_monotonic_time();
+    int64_t t_end = t_start + (int64_t)opt_seconds * G_USEC_PER_SEC;
+    int64_t next_frame = t_start, next_tick = t_start + G_USEC_PER_SEC;
+    int64_t render_ns = 0;
+    int64_t t_kick = opt_reconnect ? t_start + opt_seconds * G_USEC_PER_SEC / 2
+                                   : 0;
+    int frames = 0;
+
+    perf_update();
+
+    while (g_get_monotonic_time() < t_end && !atomic_load(&closed))
+    {
+        int64_t now = g_get_monotonic_time();
+
+        if (now < next_frame)
+        {
+            g_usleep(next_frame - now);
+            continue;
+        }
+        next_frame += frame_us;
+
+        if (t_kick && now >= t_kick)
+        {
+            fakegw_kick(fake);
+            t_kick = 0;
+        }
+        if (atomic_exchange(&resumed, 0))
+            resume_stream(gw);
+
+        int64_t w0 = g_get_monotonic_time();
+        int64_t c0 = cpu_ns(CLOCK_THREAD_CPUTIME_ID);
+
+        render_frame(cr, gw, window);
+
+        render_ns += cpu_ns(CLOCK_THREAD_CPUTIME_ID) - c0;
+        perf_frame(g_get_monotonic_time() - w0);
+        note_screen_latency(gw);
+        frames++;
+
+        if (now >= next_tick)
+        {
+            perf_update();
+            send_ping(gw);
+            next_tick += G_USEC_PER_SEC;
+        }
+    }
+
+    int64_t elapsed_us = g_get_monotonic_time() - t_start;
+
+    /* Stop and let the last batches arrive before counting */
+    net_send(gw->conn, "STOP\n");
+    for (int i = 0; i < BENCH_SETTLE_MS; i++)
+    {
+        if (!fakegw_streaming(fake) && ingested(gw) >= fakegw_sent(fake))
+            break;
+        g_usleep(1000);
+    }
+
+    perf_update();
+    if (opt_png)
+        cairo_surface_write_to_png(surface, opt_png);
+
+    uint64_t sent = fakegw_sent(fake);
+    uint64_t got = ingested(gw);
+    uint64_t bad = atomic_load(&gw->stats.out_of_order) +
+                   atomic_load(&gw->stats.dropped);
+    uint64_t unordered = histories_unordered(gw);
+    unsigned gaps = atomic_load(&gw->gap_count);
+    uint64_t skipped = fakegw_skipped(fake);
+    NetMulticastStats mc;
+    double secs = elapsed_us / 1e6;
+    struct rusage ru;
+    char report[PERF_REPORT_MAX];
+
+    net_multicast_stats(gw->conn, &mc);
+    getrusage(RUSAGE_SELF, &ru);
+    perf_report(report, sizeof(report));
+
+    printf("==== mng_bench: %d sensor(s) x %d Hz, %s wire, %d ms batches, "
+           "%.1f s ====\n",
+           opt_sensors, opt_rate, opt_legacy ? "legacy" : "packed",
+           opt_batch_ms, secs);
+    printf("%s\n", report);
+    printf("samples: %" PRIu64 " sent, %" PRIu64 " ingested (%.0f/s), "
+           "%" PRIu64 " bad\n",
+           sent, got, got / secs, bad);
+    printf("frames:  %d rendered (%.1f fps) at %dx%d, %s transforms\n",
+           frames, frames / secs, BENCH_WIDTH, BENCH_HEIGHT,
+           xform_backend());
+    printf("cpu:     gateway %.3f s, I/O thread %.3f s "
+           "(decode+insert %.3f s), render %.3f s, process %.3f s\n",
+           fakegw_cpu_s(fake), atomic_load(&io_cpu_ns) / 1e9,
+           atomic_load(&push_cpu_ns) / 1e9, render_ns / 1e9,
+           ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+               (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6);
+    if (got)
+        printf("         %.1f ns/sample decode+insert, %.3f ms/frame "
+               "render\n",
+               atomic_load(&push_cpu_ns) / (double)got,
+               frames ? render_ns / 1e6 / frames : 0.0);
+    if (opt_reconnect)
+        printf("reconnect: %u gap(s) recorded, %" PRIu64
+               " history slot(s) out of order\n",
+               gaps, unordered);
+    if (opt_mc_group)
+        printf("multicast: %" PRIu64 " datagram(s) received, %" PRIu64
+               " left out, %" PRIu64 " counted lost, %" PRIu64 " late\n",
+               mc.datagrams, skipped, mc.lost, mc.late);
+
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+    net_close(gw->conn, FALSE);
+    fakegw_stop(fake);
+
+    /* Samples in flight when the link dropped are gone */
+    if ((opt_reconnect ? got > sent : got != sent) || bad)
+    {
+        fprintf(stderr, "bench: FAILED, lost or bad samples\n");
+        return 1;
+    }
+    if (opt_reconnect && (gaps == 0 || unordered))
+    {
+        fprintf(stderr, "bench: FAILED, reconnect did not keep the "
+                        "histories in order\n");
+        return 1;
+    }
+    /* A left-out last datagram has no successor to show the gap */
+    if (opt_mc_group && (mc.lost > skipped || mc.lost + 1 < skipped))
+    {
+        fprintf(stderr, "bench: FAILED, %" PRIu64 " datagram(s) counted "
+                        "lost, %" PRIu64 " left out\n",
+                mc.lost, skipped);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,654 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "fakegw.h"
+#include "proto.h"
+
+#define FAKEGW_LINE_MAX (16 + MAX_CHANNELS * CHANNEL_ID_LEN)
+#define FAKEGW_MAX_RATE 100000
+#define PACKED_SAMPLE_MAX 13 /* sid + 10-byte varint + u16 */
+
+struct FakeGw
+{
+    FakeGwConfig cfg;
+    int listen_fd;
+    pthread_t thread;
+    atomic_int running;
+
+    /* Client state, gateway thread only */
+    int fd;
+    gboolean packed;
+    int channels; /* advertised, the first cfg.sensors of them stream */
+    unsigned rate_hz[MAX_CHANNELS];
+    unsigned decimate[MAX_CHANNELS]; /* every n-th sample, 1 = all */
+    double next_ts[MAX_CHANNELS];
+    uint64_t muted; /* UNSUBSCRIBEd channels */
+    char line[FAKEGW_LINE_MAX];
+    size_t line_len;
+    int mc_fd; /* batches go to the group while >= 0 */
+    struct sockaddr_in mc_addr;
+    uint32_t mc_seq;
+
+    atomic_int streaming;
+    atomic_int kick; /* drop the client, see fakegw_kick() */
+    _Atomic uint64_t sent;
+    _Atomic uint64_t skipped; /* datagrams left out for mc_drop */
+    _Atomic int64_t cpu_ns;
+
+    /* Per-batch scratch */
+    sensor_data_t *samples;
+    int samples_cap;
+    unsigned char *out;
+};
+
+static int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Something hardware-like per sensor */
+static unsigned int sample_value(int sid, double t_s)
+{
+    switch (sid)
+    {
+    case temp_sid:
+        return (unsigned int)(500 + 100 * sin(2 * M_PI * 0.2 * t_s));
+    case adc_zero_sid:
+        return (unsigned int)(2048 + 2000 * sin(2 * M_PI * 5 * t_s));
+    case adc_one_sid:
+        return (unsigned int)(2048 + 2000 * sin(2 * M_PI * 7 * t_s + 1));
+    case sw_sid:
+        return (unsigned int)t_s & 0xFF;
+    case pb_sid:
+        return (unsigned int)(t_s * 2) & 1;
+    default:
+        return (unsigned int)(2048 + 2000 * sin(2 * M_PI * sid * t_s));
+    }
+}
+
+/* The built-in sensors, then further ADC channels: ADC2, ADC3, ... */
+static void channel_desc(int sid, ChannelDesc *d)
+{
+    if (sid < SENSOR_COUNT)
+    {
+        g_strlcpy(d->id, channel_id(sid), sizeof(d->id));
+        g_strlcpy(d->label, channel_label(sid), sizeof(d->label));
+        d->y_max = channel_y_max(sid);
+        return;
+    }
+
+    snprintf(d->id, sizeof(d->id), "ADC%d", sid - SENSOR_COUNT + 2);
+    snprintf(d->label, sizeof(d->label), "ADC %d", sid - SENSOR_COUNT + 2);
+    d->y_max = CHANNEL_DEFAULT_Y_MAX;
+}
+
+static gboolean send_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+
+    while (len > 0)
+    {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        p += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+static gboolean send_channels(FakeGw *g)
+{
+    char line[CHANNELS_MAGIC_LEN + CHANNELS_MAX_LEN];
+    size_t n = g_strlcpy(line, CHANNELS_MAGIC, sizeof(line));
+
+    for (int s = 0; s < g->channels; s++)
+    {
+        ChannelDesc d;
+
+        channel_desc(s, &d);
+        n += snprintf(line + n, sizeof(line) - n, "%s%s:%s:%g",
+                      s ? "," : "", d.id, d.label, d.y_max);
+    }
+    n += snprintf(line + n, sizeof(line) - n, "\n");
+    return send_all(g->fd, line, n);
+}
+
+static gboolean send_rates(FakeGw *g)
+{
+    unsigned char buf[RATES_HEADER_MAX + sizeof(sensor_rate_t) * MAX_CHANNELS];
+    sensor_rate_t rates[MAX_CHANNELS];
+    int header = snprintf((char *)buf, RATES_HEADER_MAX, "%s%d\n",
+                          RATES_COUNT_MAGIC, g->channels);
+
+    for (int s = 0; s < g->channels; s++)
+    {
+        rates[s].sensor_id = s;
+        rates[s].rate_hz = g->rate_hz[s];
+    }
+
+    memcpy(buf + header, rates, sizeof(sensor_rate_t) * g->channels);
+    return send_all(g->fd, buf, header + sizeof(sensor_rate_t) * g->channels);
+}
+
+static int cmp_ts(const void *a, const void *b)
+{
+    uint64_t x = ((const sensor_data_t *)a)->timestamp;
+    uint64_t y = ((const sensor_data_t *)b)->timestamp;
+    return (x > y) - (x < y);
+}
+
+static size_t put_le(unsigned char *p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+    return bytes;
+}
+
+/* Encode samples [0, n) as one batch; the caller keeps it under the cap */
+static size_t encode_batch(FakeGw *g, const sensor_data_t *smp, int n)
+{
+    unsigned char *p = g->out + sizeof(uint32_t);
+
+    if (!g->packed)
+    {
+        memcpy(p, smp, n * sizeof(sensor_data_t));
+        p += n * sizeof(sensor_data_t);
+    }
+    else
+    {
+        uint64_t prev = smp[0].timestamp;
+
+        p += put_le(p, prev, sizeof(uint64_t));
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t delta = smp[i].timestamp - prev;
+            prev = smp[i].timestamp;
+
+            *p++ = (unsigned char)smp[i].sensor_id;
+            do
+            {
+                unsigned char b = delta & 0x7F;
+                delta >>= 7;
+                *p++ = b | (delta ? 0x80 : 0);
+            } while (delta);
+            p += put_le(p, smp[i].sensor_value, 2);
+        }
+    }
+
+    uint32_t len = (uint32_t)(p - g->out - sizeof(uint32_t));
+    uint32_t net_len = htonl(len);
+    memcpy(g->out, &net_len, sizeof(net_len));
+    return len + sizeof(uint32_t);
+}
+
+/* mc_drop: the datagram uses up its sequence number but is not sent */
+static gboolean skip_datagram(FakeGw *g, uint32_t seq)
+{
+    uint32_t drop = g->cfg.mc_drop > 0 ? (uint32_t)g->cfg.mc_drop : 0;
+
+    if (!drop || seq % drop != drop - 1)
+        return FALSE;
+
+    atomic_fetch_add(&g->skipped, 1);
+    return TRUE;
+}
+
+/* One batch as a datagram: the length prefix becomes the sequence number */
+static gboolean send_datagram(FakeGw *g, uint32_t seq, size_t len)
+{
+    seq = htonl(seq);
+    memcpy(g->out, &seq, sizeof(seq));
+
+    /* A full socket buffer loses the datagram, like the network would */
+    if (sendto(g->mc_fd, g->out, len, 0, (struct sockaddr *)&g->mc_addr,
+               sizeof(g->mc_addr)) < 0 &&
+        errno != EAGAIN && errno != ENOBUFS && errno != EINTR)
+        return FALSE;
+    return TRUE;
+}
+
+/* Everything that came due since the last batch, in timestamp order */
+static gboolean send_due(FakeGw *g)
+{
+    int64_t now = mono_us();
+    int n = 0;
+
+    for (int s = 0; s < g->channels; s++)
+    {
+        if (g->rate_hz[s] == 0 || ((g->muted >> s) & 1))
+            continue;
+
+        double period = 1e6 * g->decimate[s] / g->rate_hz[s];
+
+        if (g->next_ts[s] == 0 || g->next_ts[s] < now - 1e6)
+            g->next_ts[s] = now; /* (re)start, skip long stalls */
+
+        while (g->next_ts[s] <= now)
+        {
+            if (n == g->samples_cap)
+            {
+                g->samples_cap = g->samples_cap ? 2 * g->samples_cap : 4096;
+                g->samples = g_renew(sensor_data_t, g->samples,
+                                     g->samples_cap);
+            }
+
+            uint64_t ts = (uint64_t)g->next_ts[s];
+            g->samples[n].sensor_id = (sensor_id_t)s;
+            g->samples[n].sensor_value = sample_value(s, ts / 1e6);
+            g->samples[n].timestamp = ts;
+            n++;
+            g->next_ts[s] += period;
+        }
+    }
+
+    qsort(g->samples, n, sizeof(sensor_data_t), cmp_ts);
+
+    size_t per_sample = g->packed ? PACKED_SAMPLE_MAX : sizeof(sensor_data_t);
+    int max_batch = (int)((MAX_BATCH_BYTES - sizeof(uint64_t)) / per_sample);
+
+    for (int i = 0; i < n; i += max_batch)
+    {
+        int count = (n - i < max_batch) ? n - i : max_batch;
+        size_t len = encode_batch(g, g->samples + i, count);
+
+        if (g->mc_fd >= 0)
+        {
+            uint32_t seq = g->mc_seq++;
+
+            if (skip_datagram(g, seq))
+                continue;
+            if (!send_datagram(g, seq, len))
+                return FALSE;
+        }
+        else if (!send_all(g->fd, g->out, len))
+        {
+            return FALSE;
+        }
+        atomic_fetch_add(&g->sent, count);
+    }
+    return TRUE;
+}
+
+static int sensor_index(FakeGw *g, const char *id)
+{
+    for (int s = 0; s < g->channels; s++)
+    {
+        ChannelDesc d;
+
+        channel_desc(s, &d);
+        if (g_ascii_strcasecmp(id, d.id) == 0)
+            return s;
+    }
+    return -1;
+}
+
+static void set_subscribed(FakeGw *g, const char *id, gboolean subscribe)
+{
+    int s = id ? sensor_index(g, id) : -1;
+
+    if (s < 0)
+        return;
+
+    if (subscribe)
+        g->muted &= ~(1ULL << s);
+    else
+        g->muted |= 1ULL << s;
+    g->next_ts[s] = 0;
+}
+
+static void multicast_off(FakeGw *g)
+{
+    if (g->mc_fd >= 0)
+        close(g->mc_fd);
+    g->mc_fd = -1;
+}
+
+/* "MULTICAST" moves the batches to the group, "MULTICAST OFF" back */
+static gboolean handle_multicast(FakeGw *g, const char *arg)
+{
+    char reply[MULTICAST_MAGIC_LEN + MULTICAST_MAX_LEN];
+    unsigned char ttl = 1, loop = 1;
+
+    if (arg && strcmp(arg, "OFF") == 0)
+    {
+        multicast_off(g);
+        return TRUE;
+    }
+
+    /* Unknown to this gateway, or the client would not decode them */
+    if (!g->cfg.mc_group || !g->packed)
+        return TRUE;
+
+    if (g->mc_fd < 0)
+    {
+        memset(&g->mc_addr, 0, sizeof(g->mc_addr));
+        g->mc_addr.sin_family = AF_INET;
+        g->mc_addr.sin_port = htons(g->cfg.mc_port);
+        if (inet_pton(AF_INET, g->cfg.mc_group, &g->mc_addr.sin_addr) != 1)
+            return TRUE;
+
+        g->mc_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          0);
+        if (g->mc_fd < 0)
+            return TRUE;
+
+        /* Receivers on this host see the group; it stays on the LAN */
+        setsockopt(g->mc_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        setsockopt(g->mc_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop,
+                   sizeof(loop));
+    }
+
+    snprintf(reply, sizeof(reply), "%s%s %d\n", MULTICAST_MAGIC,
+             g->cfg.mc_group, g->cfg.mc_port);
+    return send_all(g->fd, reply, strlen(reply));
+}
+
+/* FALSE to drop the client */
+static gboolean handle_command(FakeGw *g, char *line)
+{
+    char *save = NULL;
+    char *tok1 = strtok_r(line, " ", &save);
+    char *tok2 = strtok_r(NULL, " ", &save);
+    char *tok3 = strtok_r(NULL, " ", &save);
+
+    if (!tok1)
+        return TRUE;
+
+    if (strcmp(tok1, "START") == 0)
+    {
+        memset(g->next_ts, 0, sizeof(g->next_ts));
+        atomic_store(&g->streaming, 1);
+    }
+    else if (strcmp(tok1, "STOP") == 0)
+    {
+        atomic_store(&g->streaming, 0);
+    }
+    else if (strcmp(tok1, "SHUTDOWN") == 0)
+    {
+        return FALSE;
+    }
+    else if (strcmp(tok1, "FORMAT") == 0 && tok2)
+    {
+        char reply[FORMAT_MAX_LEN];
+
+        g->packed = strcmp(tok2, "PACKED") == 0;
+        snprintf(reply, sizeof(reply), "FORMAT %s\n",
+                 g->packed ? "PACKED" : "LEGACY");
+        return send_all(g->fd, reply, strlen(reply));
+    }
+    else if (strcmp(tok1, "MULTICAST") == 0)
+    {
+        return handle_multicast(g, tok2);
+    }
+    else if (strcmp(tok1, "PING") == 0 && tok2)
+    {
+        char reply[PONG_MAX_LEN];
+
+        snprintf(reply, sizeof(reply), "PONG %s %lld\n", tok2,
+                 (long long)mono_us());
+        return send_all(g->fd, reply, strlen(reply));
+    }
+    else if (strcmp(tok1, "SUBSCRIBE") == 0 ||
+             strcmp(tok1, "UNSUBSCRIBE") == 0)
+    {
+        gboolean on = tok1[0] == 'S';
+
+        set_subscribed(g, tok2, on);
+        set_subscribed(g, tok3, on);
+        for (char *id; (id = strtok_r(NULL, " ", &save));)
+            set_subscribed(g, id, on);
+    }
+    else if (strcmp(tok1, "DECIMATE") == 0)
+    {
+        /* <id> <n> pairs; the rates stay, so no RATES reply */
+        while (tok2 && tok3)
+        {
+            int s = sensor_index(g, tok2);
+            int n = atoi(tok3);
+
+            if (s >= 0 && n >= 1)
+                g->decimate[s] = n;
+            tok2 = strtok_r(NULL, " ", &save);
+            tok3 = strtok_r(NULL, " ", &save);
+        }
+    }
+    else if (strcmp(tok1, "CONFIGURE") == 0)
+    {
+        /* Any number of <id> <hz> pairs, answered with one RATES */
+        gboolean changed = FALSE;
+
+        while (tok2 && tok3)
+        {
+            int s = sensor_index(g, tok2);
+            int hz = atoi(tok3);
+
+            if (s >= 0 && hz >= 0 && hz <= FAKEGW_MAX_RATE)
+            {
+                g->rate_hz[s] = hz;
+                g->next_ts[s] = 0;
+                changed = TRUE;
+            }
+            tok2 = strtok_r(NULL, " ", &save);
+            tok3 = strtok_r(NULL, " ", &save);
+        }
+        if (changed)
+            return send_rates(g);
+    }
+    return TRUE;
+}
+
+static gboolean read_commands(FakeGw *g)
+{
+    char buf[FAKEGW_LINE_MAX];
+    ssize_t n = recv(g->fd, buf, sizeof(buf), 0);
+
+    if (n <= 0)
+        return n < 0 && errno == EINTR;
+
+    for (ssize_t i = 0; i < n; i++)
+    {
+        if (buf[i] != '\n')
+        {
+            if (g->line_len < sizeof(g->line) - 1)
+                g->line[g->line_len++] = buf[i];
+            continue;
+        }
+
+        g->line[g->line_len] = 0;
+        g->line_len = 0;
+        if (!handle_command(g, g->line))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void serve_client(FakeGw *g)
+{
+    g->packed = FALSE;
+    g->line_len = 0;
+    g->muted = 0;
+    atomic_store(&g->streaming, 0);
+
+    g->channels = MAX(g->cfg.sensors, SENSOR_COUNT);
+    for (int s = 0; s < g->channels; s++)
+    {
+        g->rate_hz[s] = s < g->cfg.sensors ? g->cfg.rate_hz : 0;
+        g->decimate[s] = 1;
+    }
+
+    if (!send_channels(g) || !send_rates(g))
+        return;
+
+    int64_t next_batch = mono_us();
+
+    while (atomic_load(&g->running))
+    {
+        int wait_ms = 100;
+
+        if (atomic_load(&g->streaming))
+        {
+            int64_t left = next_batch - mono_us();
+            wait_ms = left > 0 ? (int)(left / 1000) : 0;
+        }
+
+        struct pollfd p = {.fd = g->fd, .events = POLLIN};
+        int r = poll(&p, 1, wait_ms);
+
+        if (r < 0 && errno != EINTR)
+            return;
+        if (r > 0 && !read_commands(g))
+            return;
+        if (atomic_exchange(&g->kick, 0))
+            return;
+
+        if (atomic_load(&g->streaming) && mono_us() >= next_batch)
+        {
+            if (!send_due(g))
+                return;
+            next_batch += g->cfg.batch_ms * 1000;
+            if (next_batch < mono_us())
+                next_batch = mono_us(); /* fell behind: don't burst */
+        }
+
+        atomic_store(&g->cpu_ns, thread_cpu_ns());
+    }
+}
+
+static void *fakegw_thread(void *arg)
+{
+    FakeGw *g = arg;
+
+    while (atomic_load(&g->running))
+    {
+        struct pollfd p = {.fd = g->listen_fd, .events = POLLIN};
+
+        if (poll(&p, 1, 100) <= 0)
+            continue;
+
+        g->fd = accept(g->listen_fd, NULL, NULL);
+        if (g->fd < 0)
+            continue;
+
+        serve_client(g);
+        close(g->fd);
+        g->fd = -1;
+        multicast_off(g);
+        atomic_store(&g->streaming, 0);
+    }
+
+    atomic_store(&g->cpu_ns, thread_cpu_ns());
+    return NULL;
+}
+
+FakeGw *fakegw_start(FakeGwConfig *cfg)
+{
+    FakeGw *g = g_malloc0(sizeof(FakeGw));
+    struct sockaddr_in addr = {0};
+    socklen_t len = sizeof(addr);
+    int one = 1;
+
+    g->cfg = *cfg;
+    g->fd = -1;
+    g->mc_fd = -1;
+    g->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (g->listen_fd < 0)
+    {
+        perror("fakegw socket");
+        g_free(g);
+        return NULL;
+    }
+    setsockopt(g->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(cfg->port);
+
+    if (bind(g->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(g->listen_fd, 1) < 0 ||
+        getsockname(g->listen_fd, (struct sockaddr *)&addr, &len) < 0)
+    {
+        perror("fakegw bind");
+        close(g->listen_fd);
+        g_free(g);
+        return NULL;
+    }
+
+    cfg->port = ntohs(addr.sin_port);
+    g->cfg.port = cfg->port;
+    if (g->cfg.batch_ms < 1)
+        g->cfg.batch_ms = 1;
+
+    g->out = g_malloc(RX_BUF_SIZE);
+
+    atomic_store(&g->running, 1);
+    pthread_create(&g->thread, NULL, fakegw_thread, g);
+    return g;
+}
+
+void fakegw_stop(FakeGw *g)
+{
+    if (!g)
+        return;
+
+    atomic_store(&g->running, 0);
+    pthread_join(g->thread, NULL);
+
+    close(g->listen_fd);
+    g_free(g->samples);
+    g_free(g->out);
+    g_free(g);
+}
+
+/* Samples handed to the socket so far, not counting skipped datagrams */
+uint64_t fakegw_sent(FakeGw *g)
+{
+    return atomic_load(&g->sent);
+}
+
+/* Datagrams left out for mc_drop so far */
+uint64_t fakegw_skipped(FakeGw *g)
+{
+    return atomic_load(&g->skipped);
+}
+
+gboolean fakegw_streaming(FakeGw *g)
+{
+    return atomic_load(&g->streaming) != 0;
+}
+
+/* Close the client's connection as if the link dropped; any thread */
+void fakegw_kick(FakeGw *g)
+{
+    atomic_store(&g->kick, 1);
+}
+
+/* CPU time of the gateway thread */
+double fakegw_cpu_s(FakeGw *g)
+{
+    return atomic_load(&g->cpu_ns) / 1e9;
+}
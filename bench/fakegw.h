@@ -0,0 +1,48 @@
+#ifndef FAKEGW_H
+#define FAKEGW_H
+
+#include <stdint.h>
+
+#include "utils.h"
+
+/* ---------- Synthetic gateway ----------
+ *
+ * A TCP server speaking the gateway protocol (see proto.h): CHANNELS
+ * and RATES on connect, then length-prefixed batches after START, in
+ * the legacy layout or packed after "FORMAT PACKED". It understands
+ * START, STOP, CONFIGURE, DECIMATE, FORMAT, PING, SUBSCRIBE, UNSUBSCRIBE
+ * and SHUTDOWN, serves one client at a time and runs on its own thread.
+ *
+ * With mc_group set it also answers MULTICAST (packed clients only) and
+ * then sends the batches as datagrams to mc_group:mc_port instead;
+ * mc_drop > 1 skips every mc_drop-th datagram to exercise loss
+ * accounting (fakegw_skipped() counts them, fakegw_sent() leaves their
+ * samples out). Having one client, it keeps applying that client's
+ * SUBSCRIBE and DECIMATE to the group.
+ *
+ * Timestamps are CLOCK_MONOTONIC microseconds, so on the same machine
+ * the measured clock offset should come out near zero.
+ */
+typedef struct
+{
+    int port;         /* 0 = any free port, filled in by fakegw_start */
+    int sensors;      /* the first N channels stream, up to MAX_CHANNELS;
+                         past the built-ins they are ADC2, ADC3, ... */
+    unsigned rate_hz; /* initial rate of each streaming sensor */
+    int batch_ms;     /* batch period */
+    const char *mc_group; /* NULL = no MULTICAST */
+    int mc_port;
+    int mc_drop;          /* skip every n-th datagram, 0 = none */
+} FakeGwConfig;
+
+typedef struct FakeGw FakeGw;
+
+FakeGw *fakegw_start(FakeGwConfig *cfg);
+void fakegw_stop(FakeGw *g);
+uint64_t fakegw_sent(FakeGw *g);
+uint64_t fakegw_skipped(FakeGw *g);
+gboolean fakegw_streaming(FakeGw *g);
+void fakegw_kick(FakeGw *g);
+double fakegw_cpu_s(FakeGw *g);
+
+#endif
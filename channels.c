@@ -0,0 +1,161 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "channels.h"
+
+/* Plot colors (Matplotlib default palette), then generated hues */
+#define PALETTE_SIZE 10
+
+static const double palette[PALETTE_SIZE][3] = {
+    {0x1F / 255.0, 0x77 / 255.0, 0xB4 / 255.0}, // Blue
+    {0xFF / 255.0, 0x7F / 255.0, 0x0E / 255.0}, // Orange
+    {0x2C / 255.0, 0xA0 / 255.0, 0x2C / 255.0}, // Green
+    {0xD6 / 255.0, 0x27 / 255.0, 0x28 / 255.0}, // Red
+    {0x94 / 255.0, 0x67 / 255.0, 0xBD / 255.0}, // Purple
+    {0x8C / 255.0, 0x56 / 255.0, 0x4B / 255.0}, // Brown
+    {0xE3 / 255.0, 0x77 / 255.0, 0xC2 / 255.0}, // Pink
+    {0x7F / 255.0, 0x7F / 255.0, 0x7F / 255.0}, // Gray
+    {0xBC / 255.0, 0xBD / 255.0, 0x22 / 255.0}, // Olive
+    {0x17 / 255.0, 0xBE / 255.0, 0xCF / 255.0}  // Cyan
+};
+
+static const ChannelType channel_types[] = {
+    [CHANNEL_ANALOG] = {"analog", RING_U16, FALSE, 0},
+    [CHANNEL_WIDE] = {"wide", RING_F64, FALSE, 0},
+    [CHANNEL_SWITCH] = {"switch", RING_BIT, TRUE, 8},
+    [CHANNEL_BUTTON] = {"button", RING_BIT, TRUE, 0},
+};
+
+/* One array per field; the built-in sensors are the first entries */
+static struct
+{
+    atomic_int count;
+    pthread_mutex_t lock; /* writers only */
+
+    char id[MAX_CHANNELS][CHANNEL_ID_LEN];
+    char label[MAX_CHANNELS][CHANNEL_LABEL_LEN];
+    double y_max[MAX_CHANNELS];
+    ChannelKind kind[MAX_CHANNELS];
+    double color[MAX_CHANNELS][3]; /* past the palette only */
+} reg = {
+    .count = SENSOR_COUNT,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .id = {"TEMP", "ADC0", "ADC1", "SW", "PB"},
+    .label = {"Temp", "ADC 0", "ADC 1", "Switches", "Push Buttons"},
+    .y_max = {
+        1024.0, // Temp (raw RTD-ish)
+        4095.0, // ADC 0
+        4095.0, // ADC 1
+        255.0,  // Switches
+        1.0     // Push buttons
+    },
+    .kind = {CHANNEL_ANALOG, CHANNEL_ANALOG, CHANNEL_ANALOG, CHANNEL_SWITCH,
+             CHANNEL_BUTTON},
+};
+
+int channel_count(void)
+{
+    return atomic_load_explicit(&reg.count, memory_order_acquire);
+}
+
+const char *channel_id(int c)
+{
+    return reg.id[c];
+}
+
+const char *channel_label(int c)
+{
+    return reg.label[c];
+}
+
+double channel_y_max(int c)
+{
+    return reg.y_max[c];
+}
+
+const ChannelType *channel_type(int c)
+{
+    return &channel_types[reg.kind[c]];
+}
+
+const double *channel_color(int c)
+{
+    return c < PALETTE_SIZE ? palette[c] : reg.color[c];
+}
+
+/* Index of the channel with this id or label (any case), -1 if none */
+int channel_find(const char *name)
+{
+    int n = channel_count();
+
+    for (int c = 0; c < n; c++)
+    {
+        if (g_ascii_strcasecmp(name, reg.id[c]) == 0 ||
+            g_ascii_strcasecmp(name, reg.label[c]) == 0)
+            return c;
+    }
+    return -1;
+}
+
+/* See channels.h; the built-in sensors come out as in reg */
+static ChannelKind channel_kind(const char *id, double y_max)
+{
+    if (y_max <= 1.0 && g_ascii_strncasecmp(id, "PB", 2) == 0)
+        return CHANNEL_BUTTON;
+    if (y_max <= UINT8_MAX && g_ascii_strncasecmp(id, "SW", 2) == 0)
+        return CHANNEL_SWITCH;
+    if (y_max <= UINT16_MAX)
+        return CHANNEL_ANALOG;
+    return CHANNEL_WIDE;
+}
+
+/* Golden-angle hue steps keep neighbouring channels apart */
+static void generated_color(int c, double out[3])
+{
+    double h = (c * 137508L / 1000 % 360) / 60.0;
+    double s = 0.65, v = 0.80;
+    double f = h - (int)h;
+    double p = v * (1 - s), q = v * (1 - s * f), t = v * (1 - s * (1 - f));
+
+    const double sector[6][3] = {
+        {v, t, p}, {q, v, p}, {p, v, t}, {p, q, v}, {t, p, v}, {v, p, q}};
+
+    memcpy(out, sector[(int)h % 6], 3 * sizeof(double));
+}
+
+/*
+ * Index of the channel with d->id, added if it is new. A known id keeps
+ * its first label and scale. -1 once MAX_CHANNELS are registered.
+ */
+int channel_register(const ChannelDesc *d)
+{
+    int c = -1;
+
+    pthread_mutex_lock(&reg.lock);
+
+    int n = atomic_load_explicit(&reg.count, memory_order_relaxed);
+
+    for (int i = 0; i < n && c < 0; i++)
+        if (g_ascii_strcasecmp(d->id, reg.id[i]) == 0)
+            c = i;
+
+    if (c < 0 && n < MAX_CHANNELS)
+    {
+        c = n;
+        g_strlcpy(reg.id[c], d->id, CHANNEL_ID_LEN);
+        g_strlcpy(reg.label[c], d->label[0] ? d->label : d->id,
+                  CHANNEL_LABEL_LEN);
+        reg.y_max[c] = d->y_max > 0 ? d->y_max : CHANNEL_DEFAULT_Y_MAX;
+        reg.kind[c] = channel_kind(reg.id[c], reg.y_max[c]);
+
+        if (c >= PALETTE_SIZE)
+            generated_color(c, reg.color[c]);
+
+        /* Publish only after the entry is complete */
+        atomic_store_explicit(&reg.count, n + 1, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&reg.lock);
+    return c;
+}
@@ -0,0 +1,69 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+#include "ring.h"
+
+/* ---------- Channel registry ----------
+ *
+ * Every channel the client knows about, across all gateways. It starts
+ * with the SENSOR_COUNT built-in sensors (sensor_id_t values are their
+ * indices) and grows as gateways advertise their channel lists with
+ * CHANNELS (see proto.h). Channels are matched by id, so two gateways
+ * with an "ADC0" share its color and checkbox and are overlaid.
+ *
+ * Entries are append-only and never change once published: any thread
+ * may read the first channel_count() entries without locking. Only
+ * channel_register() takes a lock.
+ */
+#define CHANNEL_ID_LEN 16
+#define CHANNEL_LABEL_LEN 32
+#define CHANNEL_DEFAULT_Y_MAX 4095.0
+
+/* ---------- Channel types ----------
+ *
+ * How a channel's samples are stored and drawn, looked up in a static
+ * table by its kind. The kind follows from the full scale and, for the
+ * digital kinds, the id, so advertised channels get one too:
+ *
+ *   "PB*" with y_max <= 1   button  one bit a sample, drawn as steps
+ *   "SW*" with y_max <= 255 switch  the bank's bitmask, one bit lane and
+ *                                   one step lane per switch
+ *   y_max <= 65535          analog  16-bit samples, polyline
+ *   larger                  wide    doubles, polyline
+ *
+ * A small full scale alone says nothing: a 0..1 channel may well be
+ * analog. Values past a store's range are clamped to it.
+ */
+typedef enum
+{
+    CHANNEL_ANALOG,
+    CHANNEL_WIDE,
+    CHANNEL_SWITCH,
+    CHANNEL_BUTTON
+} ChannelKind;
+
+typedef struct
+{
+    const char *name;
+    RingStore store; /* samples, see history_init() */
+    gboolean steps;  /* digital: hold each value until the next */
+    int bits;        /* > 0: a bitmask, drawn as one lane per bit */
+} ChannelType;
+
+typedef struct
+{
+    char id[CHANNEL_ID_LEN];       /* as used in CONFIGURE */
+    char label[CHANNEL_LABEL_LEN]; /* checkbox / legend text */
+    double y_max;                  /* full-scale raw value */
+} ChannelDesc;
+
+int channel_count(void);
+const char *channel_id(int c);
+const char *channel_label(int c);
+double channel_y_max(int c);
+const ChannelType *channel_type(int c);
+const double *channel_color(int c);
+int channel_find(const char *name);
+int channel_register(const ChannelDesc *d);
+
+#endif
@@ -0,0 +1,66 @@
+#include "decimate.h"
+
+int decimate_minmax(const float *x, const double *lo, const double *hi,
+                    int n, int width, double *out_x, double *out_v)
+{
+    if (n <= 0 || width <= 0)
+        return 0;
+
+    int out = 0;
+    int i = 0;
+
+    /* Skip anything left of the window */
+    while (i < n && x[i] < 0)
+        i++;
+
+    while (i < n)
+    {
+        if (x[i] > width)
+            break;
+
+        int col = (int)x[i];
+        int min_i = i, max_i = i;
+        double min_x = x[i], max_x = x[i];
+
+        /* Collect every sample falling into this pixel column */
+        for (i++; i < n; i++)
+        {
+            if (x[i] > width || (int)x[i] != col)
+                break;
+
+            if (lo[i] < lo[min_i])
+            {
+                min_i = i;
+                min_x = x[i];
+            }
+            if (hi[i] > hi[max_i])
+            {
+                max_i = i;
+                max_x = x[i];
+            }
+        }
+
+        /* A single raw sample: one point */
+        if (min_i == max_i && lo[min_i] == hi[max_i])
+        {
+            out_x[out] = min_x;
+            out_v[out++] = lo[min_i];
+        }
+        else if (min_i <= max_i)
+        {
+            out_x[out] = min_x;
+            out_v[out++] = lo[min_i];
+            out_x[out] = max_x;
+            out_v[out++] = hi[max_i];
+        }
+        else
+        {
+            out_x[out] = max_x;
+            out_v[out++] = hi[max_i];
+            out_x[out] = min_x;
+            out_v[out++] = lo[min_i];
+        }
+    }
+
+    return out;
+}
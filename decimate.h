@@ -0,0 +1,28 @@
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <stdint.h>
+
+/* Worst-case output size of decimate_minmax() for a given plot width */
+#define DECIMATE_MAX_POINTS(width) (2 * ((width) + 1))
+
+/*
+ * Min/max envelope decimation.
+ *
+ * Takes samples already mapped to pixel x (see xform_time_px()) and
+ * keeps, per pixel column of [0, width], only the minimum and the
+ * maximum sample (in the order they occurred). The stroked polyline
+ * looks identical to the full one, but its length is bounded by the
+ * plot width instead of the sample count.
+ *
+ * lo/hi are the per-sample low and high values: pass the same array twice
+ * for raw samples, or the bucket min/max of a downsampled tier.
+ *
+ * x must be ascending; samples left of 0 are skipped. out_x receives the
+ * x offset in pixels (0..width), out_v the value. Both must hold
+ * DECIMATE_MAX_POINTS(width). Returns the number of points written.
+ */
+int decimate_minmax(const float *x, const double *lo, const double *hi,
+                    int n, int width, double *out_x, double *out_v);
+
+#endif
@@ -0,0 +1,274 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "export.h"
+#include "gateway.h"
+#include "recorder.h"
+
+static struct
+{
+    atomic_int busy;
+    atomic_int cancel;
+    gboolean joinable;
+    pthread_t thread;
+
+    ExportJob job;
+    ExportDone done;
+    void *user;
+} ex;
+
+static const char *gateway_label(int g, char *buf, size_t len)
+{
+    if (g < gateway_count && gateways[g].ip[0])
+        return gateways[g].ip;
+
+    snprintf(buf, len, "gateway %d", g + 1);
+    return buf;
+}
+
+/* ---------- From the history rings ---------- */
+
+static long export_history(FILE *fp, uint64_t mask)
+{
+    static uint64_t ts[EXPORT_CHUNK];
+    static double val[EXPORT_CHUNK];
+    double *vals[1] = {val};
+    long rows = 0;
+
+    for (int g = 0; g < gateway_count; g++)
+    {
+        Gateway *gw = &gateways[g];
+        char label[32];
+
+        for (int s = 0; s < MAX_CHANNELS; s++)
+        {
+            SensorHistory *h = gateway_hist(gw, s);
+            uint64_t t_end, t = 0;
+
+            if (!h || !(mask & (1ULL << s)) ||
+                !ring_latest_ts(&h->level[0], &t_end))
+                continue;
+
+            SampleRing *raw = &h->level[0];
+
+            /* Stop at what was buffered when the export started */
+            for (;;)
+            {
+                if (atomic_load(&ex.cancel))
+                    return rows;
+
+                int n = ring_read_since(raw, t, ts, vals, EXPORT_CHUNK);
+                if (n == 0)
+                    break;
+
+                for (int i = 0; i < n && ts[i] <= t_end; i++, rows++)
+                    fprintf(fp, "%s,%s,%.6f,%g\n",
+                            gateway_label(g, label, sizeof(label)),
+                            channel_id(s), ts[i] / 1e6, val[i]);
+
+                if (ts[n - 1] >= t_end)
+                    break;
+                t = ts[n - 1] + 1;
+            }
+        }
+    }
+
+    return rows;
+}
+
+/* ---------- From a recording ---------- */
+
+#define REC_GATEWAYS 256 /* RecRecordHeader.gateway is a byte */
+
+typedef struct
+{
+    FILE *fp;
+    uint64_t mask;
+    long rows;
+    uint64_t t0[REC_GATEWAYS];
+    uint64_t last[REC_GATEWAYS];
+    int64_t last_us[REC_GATEWAYS]; /* when last[] was received */
+    int8_t chan[REC_GATEWAYS][MAX_CHANNELS]; /* as Gateway.chan */
+} RecExport;
+
+/* Like gateway_set_channels(), but only looks channels up */
+static void export_channels(RecExport *rx, int gateway, const Frame *f)
+{
+    ChannelDesc desc[MAX_CHANNELS];
+    int n = frame_channels(f, desc, MAX_CHANNELS);
+
+    for (int i = 0; i < MAX_CHANNELS; i++)
+        rx->chan[gateway][i] =
+            (i < n && desc[i].id[0]) ? channel_find(desc[i].id) : -1;
+}
+
+static gboolean export_frame(int gateway, WireFormat wire, const Frame *f,
+                             int64_t t_us, void *user)
+{
+    RecExport *rx = user;
+    char label[32];
+
+    if (atomic_load(&ex.cancel))
+        return FALSE;
+
+    if (f->type == FRAME_CHANNELS)
+    {
+        export_channels(rx, gateway, f);
+        return TRUE;
+    }
+
+    if (f->type != FRAME_BATCH)
+        return TRUE;
+
+    FrameCursor cur;
+    sensor_data_t pkt;
+
+    frame_cursor_init(&cur, f, wire);
+
+    while (frame_cursor_next(&cur, &pkt))
+    {
+        uint64_t ts = pkt.timestamp;
+
+        /* The time base stays across RATES, as in push_sample(). A clock
+           that went back (a gateway restarted across a reconnect) goes
+           on after the recorded downtime, as in gateway_resume(). */
+        if (rx->t0[gateway] == 0)
+            rx->t0[gateway] = ts;
+        else if (ts < rx->last[gateway])
+        {
+            uint64_t last_rel = rx->last[gateway] - rx->t0[gateway];
+            int64_t down_us = t_us - rx->last_us[gateway];
+
+            rx->t0[gateway] =
+                ts - (last_rel + (uint64_t)(down_us > 0 ? down_us : 0));
+        }
+        rx->last[gateway] = ts;
+        rx->last_us[gateway] = t_us;
+
+        int c = (unsigned)pkt.sensor_id < MAX_CHANNELS
+                    ? rx->chan[gateway][pkt.sensor_id]
+                    : -1;
+
+        if (c < 0 || !(rx->mask & (1ULL << c)))
+            continue;
+
+        fprintf(rx->fp, "%s,%s,%.6f,%u\n",
+                gateway_label(gateway, label, sizeof(label)),
+                channel_id(c),
+                (ts - rx->t0[gateway]) / 1e6, pkt.sensor_value);
+        rx->rows++;
+    }
+
+    return TRUE;
+}
+
+static long export_recording(FILE *fp, const char *path, uint64_t mask,
+                             gboolean *ok)
+{
+    Replay *r = replay_open(path, NULL, NULL);
+    if (!r)
+    {
+        *ok = FALSE;
+        return 0;
+    }
+
+    RecExport *rx = g_new0(RecExport, 1);
+    rx->fp = fp;
+    rx->mask = mask;
+    for (int g = 0; g < REC_GATEWAYS; g++)
+        for (int i = 0; i < MAX_CHANNELS; i++)
+            rx->chan[g][i] = i < SENSOR_COUNT ? i : -1;
+
+    replay_foreach(r, export_frame, rx);
+
+    long rows = rx->rows;
+    g_free(rx);
+    replay_close(r);
+    return rows;
+}
+
+/* ---------- Worker ---------- */
+
+static void *export_thread(void *arg)
+{
+    (void)arg;
+
+    gboolean ok = TRUE;
+    long rows = 0;
+    FILE *fp = fopen(ex.job.out_path, "w");
+
+    if (!fp)
+    {
+        perror("[GUI] export");
+        ok = FALSE;
+    }
+    else
+    {
+        setvbuf(fp, NULL, _IOFBF, EXPORT_IO_BUF);
+        fprintf(fp, "gateway,sensor,time_s,value\n");
+
+        if (ex.job.source == EXPORT_RECORDING)
+            rows = export_recording(fp, ex.job.rec_path, ex.job.sensor_mask, &ok);
+        else
+            rows = export_history(fp, ex.job.sensor_mask);
+
+        if (fclose(fp) != 0)
+        {
+            perror("[GUI] export");
+            ok = FALSE;
+        }
+    }
+
+    if (atomic_load(&ex.cancel))
+        ok = FALSE;
+
+    printf("[GUI] Export to %s %s, %ld rows\n", ex.job.out_path,
+           ok ? "done" : "failed", rows);
+
+    if (ex.done)
+        ex.done(&ex.job, rows, ok, ex.user);
+
+    atomic_store(&ex.busy, 0);
+    return NULL;
+}
+
+gboolean export_start(const ExportJob *job, ExportDone done, void *user)
+{
+    if (atomic_load(&ex.busy))
+        return FALSE;
+
+    if (ex.joinable)
+        pthread_join(ex.thread, NULL);
+
+    ex.job = *job;
+    ex.done = done;
+    ex.user = user;
+    atomic_store(&ex.cancel, 0);
+    atomic_store(&ex.busy, 1);
+
+    if (pthread_create(&ex.thread, NULL, export_thread, NULL) != 0)
+    {
+        atomic_store(&ex.busy, 0);
+        ex.joinable = FALSE;
+        return FALSE;
+    }
+
+    ex.joinable = TRUE;
+    return TRUE;
+}
+
+gboolean export_busy(void)
+{
+    return atomic_load(&ex.busy);
+}
+
+void export_cancel(void)
+{
+    if (!ex.joinable)
+        return;
+
+    atomic_store(&ex.cancel, 1);
+    pthread_join(ex.thread, NULL);
+    ex.joinable = FALSE;
+}
@@ -0,0 +1,41 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "utils.h"
+
+/* ---------- CSV export ----------
+ *
+ * Writes samples as "gateway,sensor,time_s,value" rows on a worker
+ * thread, so the GTK loop keeps running. Data is streamed in chunks of
+ * EXPORT_CHUNK samples: from the raw history rings (readers only, the
+ * I/O threads keep writing) or straight from a mapped recording file,
+ * so nothing is materialized in RAM as a whole.
+ *
+ * Times are seconds since the gateway's time base, as on the plot.
+ */
+#define EXPORT_CHUNK 4096
+#define EXPORT_IO_BUF (1024 * 1024)
+
+typedef enum
+{
+    EXPORT_HISTORY,
+    EXPORT_RECORDING
+} ExportSource;
+
+typedef struct
+{
+    ExportSource source;
+    char out_path[256];
+    char rec_path[256];    /* EXPORT_RECORDING only */
+    uint64_t sensor_mask;  /* bit per channel registry index */
+} ExportJob;
+
+/* Called on the worker thread when the export finished or failed */
+typedef void (*ExportDone)(const ExportJob *job, long rows, gboolean ok,
+                           void *user);
+
+gboolean export_start(const ExportJob *job, ExportDone done, void *user);
+gboolean export_busy(void);
+void export_cancel(void);
+
+#endif
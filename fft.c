@@ -0,0 +1,234 @@
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "fft.h"
+#include "gateway.h"
+
+/* ---------- FFT plan ---------- */
+
+gboolean fft_plan_init(FftPlan *p, int n)
+{
+    if (n < 2 || (n & (n - 1)))
+        return FALSE;
+
+    p->n = n;
+    p->log2n = __builtin_ctz(n);
+    p->rev = g_new(uint32_t, n);
+    p->cos_t = g_new(double, n);
+    p->sin_t = g_new(double, n);
+
+    for (int i = 0; i < n; i++)
+    {
+        uint32_t r = 0;
+
+        for (int b = 0; b < p->log2n; b++)
+            r |= ((i >> b) & 1u) << (p->log2n - 1 - b);
+        p->rev[i] = r;
+
+        p->cos_t[i] = cos(2.0 * G_PI * i / n);
+        p->sin_t[i] = sin(2.0 * G_PI * i / n);
+    }
+    return TRUE;
+}
+
+void fft_plan_free(FftPlan *p)
+{
+    g_free(p->rev);
+    g_free(p->cos_t);
+    g_free(p->sin_t);
+    memset(p, 0, sizeof(*p));
+}
+
+/* In place; n is a power of two no larger than the plan */
+void fft_forward(const FftPlan *p, double *re, double *im, int n)
+{
+    int shift = p->log2n - __builtin_ctz(n);
+
+    /* For i < n the reversal over log2n bits is the one over log2(n)
+     * bits shifted up, so the plan's table serves every size */
+    for (int i = 0; i < n; i++)
+    {
+        int j = (int)(p->rev[i] >> shift);
+
+        if (j > i)
+        {
+            double t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (int len = 2; len <= n; len <<= 1)
+    {
+        int half = len / 2;
+        int step = p->n / len;
+
+        for (int i = 0; i < n; i += len)
+            for (int k = 0; k < half; k++)
+            {
+                double wr = p->cos_t[k * step];
+                double wi = -p->sin_t[k * step];
+                int a = i + k, b = a + half;
+                double tr = re[b] * wr - im[b] * wi;
+                double ti = re[b] * wi + im[b] * wr;
+
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+    }
+}
+
+/* ---------- Spectrum worker ---------- */
+
+static struct
+{
+    atomic_int run;
+    _Atomic int target; /* (gateway << 8) | channel */
+    gboolean joinable;
+    pthread_t thread;
+
+    /* Worker only */
+    FftPlan plan;
+    uint64_t ts[SPECTRUM_SIZE];
+    double re[SPECTRUM_SIZE];
+    double im[SPECTRUM_SIZE];
+
+    TriBuf tb;
+    Spectrum buf[3];
+} sp;
+
+static void spectrum_compute(int target)
+{
+    int g = target >> 8, c = target & 0xff;
+    SensorHistory *h = g < gateway_count ? gateway_hist(&gateways[g], c)
+                                         : NULL;
+    double *vals[1] = {sp.re};
+
+    if (!h)
+        return;
+
+    int got = ring_snapshot_since(&h->level[0], 0, sp.ts, vals,
+                                  SPECTRUM_SIZE);
+    if (got < SPECTRUM_MIN)
+        return;
+
+    /* The newest power of two of them */
+    int n = 1 << (31 - __builtin_clz(got));
+    const uint64_t *ts = sp.ts + (got - n);
+    double *re = sp.re + (got - n);
+
+    if (ts[n - 1] <= ts[0])
+        return;
+
+    double rate = (n - 1) * 1e6 / (double)(ts[n - 1] - ts[0]);
+    double mean = 0;
+    int stride = sp.plan.n / n;
+
+    for (int i = 0; i < n; i++)
+        mean += re[i];
+    mean /= n;
+
+    for (int i = 0; i < n; i++)
+    {
+        re[i] = (re[i] - mean) * (0.5 - 0.5 * sp.plan.cos_t[i * stride]);
+        sp.im[i] = 0;
+    }
+
+    fft_forward(&sp.plan, re, sp.im, n);
+
+    /* A sine with the channel's full scale as amplitude reads 0 dB; the
+     * Hann window sums to n / 2 */
+    Spectrum *out = &sp.buf[sp.tb.back];
+    double scale = 4.0 / (n * channel_y_max(c));
+
+    out->gateway = g;
+    out->channel = c;
+    out->n = n;
+    out->bins = n / 2 + 1;
+    out->bin_hz = rate / n;
+    out->peak = 1;
+
+    for (int k = 0; k < out->bins; k++)
+    {
+        double amp = hypot(re[k], sp.im[k]) * scale;
+        double db = amp > 0 ? 20.0 * log10(amp) : SPECTRUM_FLOOR_DB;
+
+        out->db[k] = (float)(db > SPECTRUM_FLOOR_DB ? db : SPECTRUM_FLOOR_DB);
+        if (k > 0 && out->db[k] > out->db[out->peak])
+            out->peak = k;
+    }
+
+    tribuf_publish(&sp.tb);
+}
+
+static void *spectrum_thread(void *arg)
+{
+    (void)arg;
+
+    while (atomic_load(&sp.run))
+    {
+        spectrum_compute(atomic_load(&sp.target));
+        g_usleep(SPECTRUM_PERIOD_US);
+    }
+    return NULL;
+}
+
+/* GTK thread; switches channels if it is already running */
+gboolean spectrum_start(int gateway, int channel)
+{
+    atomic_store(&sp.target, (gateway << 8) | channel);
+
+    if (sp.joinable)
+        return TRUE;
+
+    if (!sp.plan.n && !fft_plan_init(&sp.plan, SPECTRUM_SIZE))
+        return FALSE;
+
+    memset(sp.buf, 0, sizeof(sp.buf));
+    tribuf_init(&sp.tb);
+    atomic_store(&sp.run, 1);
+
+    if (pthread_create(&sp.thread, NULL, spectrum_thread, NULL) != 0)
+    {
+        atomic_store(&sp.run, 0);
+        return FALSE;
+    }
+
+    sp.joinable = TRUE;
+    return TRUE;
+}
+
+void spectrum_stop(void)
+{
+    if (!sp.joinable)
+        return;
+
+    atomic_store(&sp.run, 0);
+    pthread_join(sp.thread, NULL);
+    sp.joinable = FALSE;
+}
+
+gboolean spectrum_running(void)
+{
+    return sp.joinable;
+}
+
+/* GTK thread: latest spectrum of the current channel, NULL if none yet */
+const Spectrum *spectrum_latest(void)
+{
+    if (!sp.joinable)
+        return NULL;
+
+    const Spectrum *s = &sp.buf[tribuf_front(&sp.tb, NULL)];
+
+    if (s->n == 0 ||
+        ((s->gateway << 8) | s->channel) != atomic_load(&sp.target))
+        return NULL;
+    return s;
+}
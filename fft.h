@@ -0,0 +1,57 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include "stats.h"
+
+/* ---------- FFT plan ----------
+ *
+ * Iterative radix-2 FFT over separate real/imaginary arrays. The plan
+ * holds the twiddle factors and bit-reversal table for its size n, and
+ * any power of two up to n can use it (twiddles are taken with a
+ * stride), so it is built once and reused for every transform.
+ */
+typedef struct
+{
+    int n, log2n;
+    uint32_t *rev;  /* bit reversal over log2n bits */
+    double *cos_t;  /* cos(2 pi k / n), k < n */
+    double *sin_t;
+} FftPlan;
+
+gboolean fft_plan_init(FftPlan *p, int n);
+void fft_plan_free(FftPlan *p);
+void fft_forward(const FftPlan *p, double *re, double *im, int n);
+
+/* ---------- Spectrum view (FFT command) ----------
+ *
+ * A worker thread transforms the newest SPECTRUM_SIZE raw samples of
+ * one channel every SPECTRUM_PERIOD_US: mean removed, Hann window,
+ * amplitude in dB of the channel's full scale. It reads the history
+ * ring like any other consumer and owns its plan and buffers, so the
+ * I/O threads never wait for it. Until the ring holds SPECTRUM_SIZE
+ * samples the largest power of two that it does hold is used (at least
+ * SPECTRUM_MIN). Results reach the GTK thread through a TriBuf.
+ *
+ * The sample rate comes from the timestamps of the transformed block.
+ */
+#define SPECTRUM_SIZE 4096
+#define SPECTRUM_MIN 64
+#define SPECTRUM_PERIOD_US 250000
+#define SPECTRUM_FLOOR_DB -120.0
+
+typedef struct
+{
+    int gateway, channel;
+    int n;         /* samples transformed */
+    int bins;      /* n / 2 + 1, DC to Nyquist */
+    double bin_hz; /* sample rate / n */
+    int peak;      /* strongest bin past DC */
+    float db[SPECTRUM_SIZE / 2 + 1];
+} Spectrum;
+
+gboolean spectrum_start(int gateway, int channel);
+void spectrum_stop(void);
+gboolean spectrum_running(void);
+const Spectrum *spectrum_latest(void);
+
+#endif
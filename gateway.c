@@ -0,0 +1,411 @@
+#include "gateway.h"
+
+Gateway gateways[MAX_GATEWAYS];
+int gateway_count = 0;
+_Atomic int overload_policy = OVERLOAD_DROP;
+
+/* Sets the sizes only; each channel's history is allocated on first use
+ * and then reused for the slot */
+void gateway_init_history(Gateway *gw, int raw_samples, int tier_buckets)
+{
+    if (gw->hist_raw)
+        return;
+
+    gw->hist_raw = raw_samples;
+    gw->hist_buckets = tier_buckets;
+    stats_init(&gw->rolling);
+}
+
+void gateway_reset(Gateway *gw)
+{
+    atomic_store(&gw->server_t0, 0);
+    atomic_store(&gw->gap_count, 0);
+
+    for (int c = 0; c < MAX_CHANNELS; c++)
+    {
+        SensorHistory *h = gateway_hist(gw, c);
+        if (h)
+            history_clear(h);
+    }
+}
+
+/*
+ * A gateway without CHANNELS has the built-in sensors as wire ids. A new
+ * connection streams all of them until it is told otherwise.
+ */
+void gateway_default_channels(Gateway *gw)
+{
+    for (int i = 0; i < MAX_CHANNELS; i++)
+        gw->chan[i] = i < SENSOR_COUNT ? i : -1;
+    gw->chan_adv_len = 0;
+
+    atomic_store(&gw->channels, (1ULL << SENSOR_COUNT) - 1);
+    atomic_store(&gw->active, ~0ULL);
+    gw->subscribed = ~0ULL;
+}
+
+/*
+ * Registers the advertised channels and maps the gateway's wire ids to
+ * them. Returns how many were mapped; ids past a full registry are not.
+ */
+int gateway_set_channels(Gateway *gw, const Frame *f)
+{
+    ChannelDesc desc[MAX_CHANNELS];
+    int n = frame_channels(f, desc, MAX_CHANNELS);
+    int mapped = 0;
+    uint64_t mask = 0;
+
+    for (int i = 0; i < MAX_CHANNELS; i++)
+    {
+        gw->chan[i] = (i < n && desc[i].id[0]) ? channel_register(&desc[i])
+                                               : -1;
+        if (gw->chan[i] >= 0)
+        {
+            mask |= 1ULL << gw->chan[i];
+            mapped++;
+        }
+    }
+    atomic_store(&gw->channels, mask);
+
+    /* Kept to repeat at the start of a recording */
+    if (f->len <= sizeof(gw->chan_adv))
+    {
+        memcpy(gw->chan_adv, f->data, f->len);
+        gw->chan_adv_len = f->len;
+    }
+    return mapped;
+}
+
+static size_t append_ids(char *cmd, size_t len, size_t n, const char *verb,
+                         uint64_t mask)
+{
+    if (!mask || n >= len)
+        return n;
+
+    n += snprintf(cmd + n, len - n, "%s", verb);
+    for (; mask && n < len; mask &= mask - 1)
+        n += snprintf(cmd + n, len - n, " %s",
+                      channel_id(__builtin_ctzll(mask)));
+    if (n < len)
+        n += snprintf(cmd + n, len - n, "\n");
+    return n;
+}
+
+/*
+ * GTK thread: makes want (registry bits) the set of channels buffered
+ * from this gateway, and writes the UNSUBSCRIBE/SUBSCRIBE lines that
+ * bring its stream in line into cmd. Only channels the gateway has are
+ * named, and only those whose state changes. FALSE if there is nothing
+ * to send. A gateway that ignores the commands keeps sending everything
+ * and the unwanted samples are dropped on arrival instead.
+ */
+gboolean gateway_subscription(Gateway *gw, uint64_t want, char *cmd,
+                              size_t len)
+{
+    uint64_t have = atomic_load(&gw->channels);
+    uint64_t on = want & ~gw->subscribed & have;
+    uint64_t off = gw->subscribed & ~want & have;
+    size_t n = 0;
+
+    atomic_store_explicit(&gw->active, want, memory_order_relaxed);
+
+    /* Unsubscribe first so the stream never carries both sets */
+    n = append_ids(cmd, len, n, "UNSUBSCRIBE", off);
+    n = append_ids(cmd, len, n, "SUBSCRIBE", on);
+
+    if (n == 0 || n >= len)
+        return FALSE;
+
+    gw->subscribed = (gw->subscribed | on) & ~off;
+    return TRUE;
+}
+
+/* I/O thread: the only writer of gw->hist[] */
+static SensorHistory *channel_history(Gateway *gw, int c)
+{
+    SensorHistory *h = gateway_hist(gw, c);
+
+    if (!h)
+    {
+        const ChannelType *type = channel_type(c);
+
+        h = g_malloc0(sizeof(SensorHistory));
+        history_init(h, gw->hist_raw, gw->hist_buckets, type->store,
+                     type->bits);
+        atomic_store_explicit(&gw->hist[c], h, memory_order_release);
+    }
+    return h;
+}
+
+/*
+ * I/O thread, when the connection drops and starts reconnecting. The
+ * next session starts in the legacy wire format and its clock offset
+ * has to be measured again.
+ */
+void gateway_link_lost(Gateway *gw)
+{
+    gw->lost_us = g_get_monotonic_time();
+    gw->wire = WIRE_LEGACY;
+    clock_reset(&gw->clock);
+}
+
+/* Any thread: the newest (up to max) gaps, oldest first */
+int gateway_gaps(Gateway *gw, uint64_t *from, uint64_t *to, int max)
+{
+    unsigned count = atomic_load_explicit(&gw->gap_count,
+                                          memory_order_acquire);
+    int n = count < GATEWAY_GAPS ? (int)count : GATEWAY_GAPS;
+
+    if (n > max)
+        n = max;
+
+    for (int i = 0; i < n; i++)
+    {
+        GatewayGap *g = &gw->gaps[(count - n + i) % GATEWAY_GAPS];
+
+        from[i] = atomic_load_explicit(&g->t_from, memory_order_relaxed);
+        to[i] = atomic_load_explicit(&g->t_to, memory_order_relaxed);
+    }
+    return n;
+}
+
+/* First sample after a reconnect: keep the history, note the gap */
+static uint64_t gateway_resume(Gateway *gw, uint64_t ts, uint64_t t0)
+{
+    int64_t down_us = g_get_monotonic_time() - gw->lost_us;
+
+    gw->lost_us = 0;
+    if (t0 == 0 || gw->last_ts == 0)
+        return t0;
+
+    uint64_t last_rel = gw->last_ts - t0;
+
+    /* The gateway restarted: continue the time axis after the downtime.
+       Unsigned wrap-around keeps ts - t0 right even if t0 > ts. */
+    if (ts < gw->last_ts)
+    {
+        printf("[GUI] %s: gateway clock restarted while disconnected\n",
+               gw->ip);
+        t0 = ts - (last_rel + (uint64_t)(down_us > 0 ? down_us : 0));
+        atomic_store(&gw->server_t0, t0);
+    }
+
+    unsigned n = atomic_load_explicit(&gw->gap_count, memory_order_relaxed);
+    GatewayGap *g = &gw->gaps[n % GATEWAY_GAPS];
+
+    atomic_store_explicit(&g->t_from, last_rel, memory_order_relaxed);
+    atomic_store_explicit(&g->t_to, ts - t0, memory_order_relaxed);
+    atomic_store_explicit(&gw->gap_count, n + 1, memory_order_release);
+
+    gw->last_ts = ts;
+    return t0;
+}
+
+void push_sample(Gateway *gw, int c, double value, uint64_t ts)
+{
+    uint64_t t0 = atomic_load_explicit(&gw->server_t0, memory_order_relaxed);
+
+    if (gw->lost_us)
+        t0 = gateway_resume(gw, ts, t0);
+
+    /* Detect timestamp reset or backward jump */
+    if (gw->last_ts != 0 && ts < gw->last_ts)
+    {
+        printf("[GUI] %s: timestamp reset detected → clearing buffers\n",
+               gw->ip);
+        perf_add(&gw->stats.out_of_order, 1);
+
+        for (int s = 0; s < MAX_CHANNELS; s++)
+        {
+            SensorHistory *h = gateway_hist(gw, s);
+            if (h)
+                history_clear(h);
+        }
+
+        t0 = ts;
+        atomic_store(&gw->server_t0, t0);
+    }
+
+    if (t0 == 0)
+    {
+        t0 = ts;
+        atomic_store(&gw->server_t0, t0);
+    }
+
+    uint64_t rel_ts = ts - t0;
+    gw->last_ts = ts;
+
+    history_push(channel_history(gw, c), rel_ts, value);
+    stats_add(&gw->rolling, c, value, ts);
+
+    if (c == trigger_channel())
+        trigger_sample(&gw->trig, (int)(gw - gateways), value, rel_ts);
+}
+
+/*
+ * I/O thread, for a live batch before it is pushed: notes how old its
+ * newest sample is and whether the policy drops it. Without a clock
+ * estimate the age is unknown and nothing is dropped.
+ */
+static gboolean gateway_shed(Gateway *gw, const Frame *f, uint64_t newest,
+                             int64_t t_recv)
+{
+    int64_t sampled;
+
+    if (!newest || !clock_to_local(&gw->clock, newest, &sampled))
+        return FALSE;
+
+    int64_t lag = t_recv - sampled;
+
+    atomic_store_explicit(&gw->lag_us, lag, memory_order_relaxed);
+    if (lag > atomic_load_explicit(&gw->lag_peak, memory_order_relaxed))
+        atomic_store_explicit(&gw->lag_peak, lag, memory_order_relaxed);
+
+    if (lag < OVERLOAD_SHED_LAG_US ||
+        atomic_load_explicit(&overload_policy, memory_order_relaxed) ==
+            OVERLOAD_OFF)
+        return FALSE;
+
+    perf_add(&gw->stats.shed_batches, 1);
+    perf_add(&gw->stats.shed_bytes, f->len);
+    return TRUE;
+}
+
+/* GTK thread: a new session streams undecimated */
+void gateway_overload_reset(Gateway *gw)
+{
+    gw->decimate = 1;
+    gw->behind_ticks = 0;
+    gw->calm_ticks = 0;
+    gw->shed_seen = atomic_load(&gw->stats.shed_batches);
+    atomic_store(&gw->lag_us, 0);
+    atomic_store(&gw->lag_peak, 0);
+}
+
+/*
+ * GTK thread, once a second while connected: steps the decimation asked
+ * of the gateway as described in gateway.h and writes the DECIMATE line
+ * for all its channels into cmd. FALSE if the factor stays.
+ */
+gboolean gateway_overload(Gateway *gw, char *cmd, size_t len)
+{
+    uint64_t shed = atomic_load(&gw->stats.shed_batches);
+    int64_t lag = atomic_exchange(&gw->lag_peak, 0);
+    gboolean behind = lag > OVERLOAD_LAG_US ||
+                      net_backlog(gw->conn) > OVERLOAD_BACKLOG ||
+                      shed != gw->shed_seen;
+    int cur = gw->decimate > 1 ? gw->decimate : 1;
+    int want = cur;
+
+    gw->shed_seen = shed;
+
+    if (atomic_load(&overload_policy) != OVERLOAD_DECIMATE)
+        want = 1;
+    else if (behind)
+    {
+        gw->calm_ticks = 0;
+        if (++gw->behind_ticks >= OVERLOAD_TICKS &&
+            cur < OVERLOAD_MAX_DECIMATE)
+        {
+            want = cur * 2;
+            gw->behind_ticks = 0;
+        }
+    }
+    else
+    {
+        gw->behind_ticks = 0;
+        if (cur > 1 && ++gw->calm_ticks >= OVERLOAD_CALM_TICKS)
+        {
+            want = cur / 2;
+            gw->calm_ticks = 0;
+        }
+    }
+
+    if (want == cur)
+        return FALSE;
+
+    uint64_t have = atomic_load(&gw->channels);
+    size_t n = snprintf(cmd, len, "DECIMATE");
+
+    for (; have && n < len; have &= have - 1)
+        n += snprintf(cmd + n, len - n, " %s %d",
+                      channel_id(__builtin_ctzll(have)), want);
+    if (n < len)
+        n += snprintf(cmd + n, len - n, "\n");
+    if (n >= len)
+        return FALSE;
+
+    gw->decimate = want;
+    return TRUE;
+}
+
+/*
+ * Decodes the batch once into gw->batch, so a live batch (t_recv set)
+ * can be aged by its newest sample and shed before anything is pushed.
+ * Returns the newest gateway timestamp pushed, 0 if none or shed.
+ */
+uint64_t gateway_push_batch(Gateway *gw, const Frame *f, int64_t t_recv)
+{
+    FrameCursor cur;
+    uint64_t n[MAX_CHANNELS] = {0};
+    uint64_t dropped = 0, inactive = 0;
+    uint64_t newest = 0, pushed = 0;
+    uint64_t active = atomic_load_explicit(&gw->active, memory_order_relaxed);
+    int count = 0, c;
+
+    frame_cursor_init(&cur, f, gw->wire);
+
+    for (;;)
+    {
+        if (count == gw->batch_cap)
+        {
+            gw->batch_cap = gw->batch_cap ? 2 * gw->batch_cap : 1024;
+            gw->batch = g_renew(sensor_data_t, gw->batch, gw->batch_cap);
+        }
+        if (!frame_cursor_next(&cur, &gw->batch[count]))
+            break;
+        if (gw->batch[count].timestamp > newest)
+            newest = gw->batch[count].timestamp;
+        count++;
+    }
+
+    /* Too far behind: let it go so the stream catches up */
+    if (t_recv && gateway_shed(gw, f, newest, t_recv))
+        return 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        const sensor_data_t *pkt = &gw->batch[i];
+
+        if ((unsigned)pkt->sensor_id >= MAX_CHANNELS ||
+            (c = gw->chan[pkt->sensor_id]) < 0)
+        {
+            dropped++;
+        }
+        else if (!((active >> c) & 1))
+        {
+            /* Unchecked; still in flight or the gateway can't filter */
+            inactive++;
+        }
+        else
+        {
+            push_sample(gw, c, pkt->sensor_value, pkt->timestamp);
+            n[c]++;
+            if (pkt->timestamp > pushed)
+                pushed = pkt->timestamp;
+        }
+    }
+
+    /* One atomic add per channel and batch, not per sample */
+    perf_add(&gw->stats.batches, 1);
+    for (int s = 0; s < MAX_CHANNELS; s++)
+        if (n[s])
+            perf_add(&gw->stats.samples[s], n[s]);
+    if (dropped)
+        perf_add(&gw->stats.dropped, dropped);
+    if (inactive)
+        perf_add(&gw->stats.inactive, inactive);
+
+    stats_flush(&gw->rolling, g_get_monotonic_time());
+    return pushed;
+}
@@ -0,0 +1,152 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include "history.h"
+#include "net.h"
+#include "perf.h"
+#include "stats.h"
+#include "trigger.h"
+
+#define MAX_GATEWAYS 4
+#define GATEWAY_GAPS 32
+
+/* ---------- Overload policy ----------
+ *
+ * How far behind a gateway's stream is gets measured on arrival: the
+ * age of each live batch's newest sample (through the clock offset, see
+ * perf.h) and the bytes still unread in the socket (net_backlog()).
+ * The newest sample is the one the batch was sent after, so the time a
+ * batch takes to fill (seconds for a slow channel) is not lag.
+ * Without a policy both grow without limit once the client can't keep
+ * up, and the kernel throttles the gateway silently.
+ *
+ *   OVERLOAD_DROP     a batch older than OVERLOAD_SHED_LAG_US is dropped
+ *                     before it is pushed, and counted, so the stream
+ *                     catches up and the plot never lags by more.
+ *   OVERLOAD_DECIMATE the same, and after OVERLOAD_TICKS seconds behind
+ *                     (lag over OVERLOAD_LAG_US, a backlog over
+ *                     OVERLOAD_BACKLOG or batches shed) the gateway is
+ *                     asked to send every 2nd, 4th, ... sample with
+ *                     DECIMATE; after OVERLOAD_CALM_TICKS seconds caught
+ *                     up the factor is stepped back down.
+ *
+ * Recordings are written before any of this and stay complete.
+ */
+#define OVERLOAD_LAG_US 200000
+#define OVERLOAD_SHED_LAG_US 500000
+#define OVERLOAD_BACKLOG (256 * 1024)
+#define OVERLOAD_TICKS 2
+#define OVERLOAD_CALM_TICKS 10
+#define OVERLOAD_MAX_DECIMATE 64
+
+typedef enum
+{
+    OVERLOAD_OFF,
+    OVERLOAD_DROP,
+    OVERLOAD_DECIMATE
+} OverloadPolicy;
+
+extern _Atomic int overload_policy;
+
+/* ---------- Per-gateway context ----------
+ *
+ * Everything that belongs to one gateway connection: its socket/I/O
+ * thread, its sample history and its time base. Each gateway's I/O
+ * thread is the only producer for that gateway's rings, so several
+ * gateways ingest in parallel on separate cores.
+ *
+ * Per-channel arrays are indexed by channel registry index. The wire
+ * ids in the gateway's batches are translated through chan[], which its
+ * CHANNELS frame sets up. A channel's history is allocated by the I/O
+ * thread when its first sample arrives, so memory follows the channels
+ * that actually stream; readers get it with gateway_hist().
+ *
+ * Only the channels in active are buffered; the GTK thread sets it to
+ * the checked channels and asks the gateway to stop sending the others
+ * (see gateway_subscription()).
+ *
+ * When the link drops and the connection reconnects (net.h), the
+ * history is kept: gateway_link_lost() marks the drop and the first
+ * sample afterwards records the gap in gaps[] (the last GATEWAY_GAPS,
+ * for the plot). If the gateway restarted its clock meanwhile, its new
+ * timestamps are rebased to continue after the downtime instead of
+ * clearing the buffers. RATES (every new session sends one, and so does
+ * each CONFIGURE) leave the time base alone, so the history stays in
+ * timestamp order.
+ */
+typedef struct
+{
+    _Atomic uint64_t t_from, t_to; /* gateway-relative, like the history */
+} GatewayGap;
+
+typedef struct
+{
+    NetConn *conn;
+    guint gen;           /* identifies the current connection */
+    gboolean connected;  /* handshake finished (GTK thread) */
+    gboolean reconnecting; /* link dropped, being retried (GTK thread) */
+    char ip[64];
+
+    /* First timestamp, 0 = rebase. Only the I/O thread moves it while a
+     * connection is open; gateway_reset() with none. */
+    _Atomic uint64_t server_t0;
+    uint64_t last_ts;           /* I/O thread only */
+    int64_t lost_us;            /* I/O thread only: link dropped, 0 = up */
+    WireFormat wire;            /* I/O thread only, set by FORMAT reply */
+    sensor_data_t *batch;       /* I/O thread only: decoded batch */
+    int batch_cap;
+
+    /* I/O thread only: wire id -> channel, -1 = not advertised */
+    int8_t chan[MAX_CHANNELS];
+    uint32_t chan_adv_len; /* last CHANNELS payload, 0 = none */
+    unsigned char chan_adv[CHANNELS_MAX_LEN];
+    unsigned rec_session; /* recording that already has chan_adv */
+    _Atomic uint64_t channels; /* mapped channels, bit per registry index */
+
+    _Atomic uint64_t active; /* channels to buffer, set by the GTK thread */
+    uint64_t subscribed;     /* streaming as far as we know (GTK thread) */
+
+    uint32_t rate_hz[MAX_CHANNELS]; /* last RATES (GTK thread) */
+    uint32_t resume_hz[MAX_CHANNELS]; /* rate_hz when the link dropped */
+
+    _Atomic int64_t lag_us;   /* last live batch on arrival (I/O thread) */
+    _Atomic int64_t lag_peak; /* since gateway_overload() last looked */
+    int decimate;             /* factor asked of the gateway (GTK thread) */
+    int behind_ticks, calm_ticks;
+    uint64_t shed_seen;
+
+    IngestStats stats; /* bumped by the I/O thread, never reset */
+    RollingStats rolling; /* fed by the I/O thread, read by the GTK one */
+    TriggerState trig;    /* I/O thread only */
+    ClockSync clock;   /* from PONG replies, reset per connection */
+
+    GatewayGap gaps[GATEWAY_GAPS];
+    _Atomic unsigned gap_count; /* written by the I/O thread */
+
+    int hist_raw, hist_buckets; /* sizes for new histories, 0 = unset */
+    SensorHistory *_Atomic hist[MAX_CHANNELS];
+} Gateway;
+
+extern Gateway gateways[MAX_GATEWAYS];
+extern int gateway_count;
+
+/* NULL until the channel's first sample on this gateway */
+static inline SensorHistory *gateway_hist(Gateway *gw, int c)
+{
+    return atomic_load_explicit(&gw->hist[c], memory_order_acquire);
+}
+
+void gateway_init_history(Gateway *gw, int raw_samples, int tier_buckets);
+void gateway_reset(Gateway *gw);
+void gateway_default_channels(Gateway *gw);
+int gateway_set_channels(Gateway *gw, const Frame *f);
+gboolean gateway_subscription(Gateway *gw, uint64_t want, char *cmd,
+                              size_t len);
+void gateway_link_lost(Gateway *gw);
+int gateway_gaps(Gateway *gw, uint64_t *from, uint64_t *to, int max);
+void gateway_overload_reset(Gateway *gw);
+gboolean gateway_overload(Gateway *gw, char *cmd, size_t len);
+void push_sample(Gateway *gw, int c, double value, uint64_t ts);
+uint64_t gateway_push_batch(Gateway *gw, const Frame *f, int64_t t_recv);
+
+#endif
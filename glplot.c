@@ -0,0 +1,376 @@
+#include <epoxy/gl.h>
+#include <stdio.h>
+
+#include "glplot.h"
+
+#define GL_CHUNK 4096
+
+struct GlSeries
+{
+    GLuint vao;
+    GLuint vbo;
+    uint64_t cap;      /* vertices per copy (raw ring capacity) */
+    uint64_t *ts;      /* CPU copy of the uploaded timestamps */
+    uint64_t written;  /* samples uploaded since the last reset */
+    uint64_t last_ts;
+    uint64_t base_ts;  /* vertex time = (ts - base_ts) in seconds */
+    uint64_t tail_seen; /* detects ring_clear() */
+    gboolean any;
+};
+
+static GLuint program, pts_vao, pts_vbo;
+static GLint u_viewport, u_plot, u_time, u_ymax, u_color, u_dash, u_scale;
+static GlFrame frame;
+
+/*
+ * Times are split into a float and the float of what it misses (time_hi,
+ * time_lo), about 48 bits together. hi - t_hi is exact for samples near
+ * t_min, so the offset into the window stays exact however long the
+ * series has been running, where one float of seconds would be down to
+ * ~0.1 ms steps after a quarter of an hour.
+ */
+static const char *vertex_src =
+    "in vec3 a_pos;\n" /* time hi, time lo, value */
+    "uniform vec2 u_viewport;\n"
+    "uniform vec4 u_plot;\n" /* left, bottom, width, height */
+    "uniform vec3 u_time;\n" /* t_min hi, t_min lo, window; as a_pos */
+    "uniform float u_ymax;\n"
+    "void main()\n"
+    "{\n"
+    "    float dt = (a_pos.x - u_time.x) + (a_pos.y - u_time.y);\n"
+    "    float x = u_plot.x + dt / u_time.z * u_plot.z;\n"
+    "    float y = u_plot.y - clamp(a_pos.z / u_ymax, 0.0, 1.0) * u_plot.w;\n"
+    "    gl_Position = vec4(2.0 * x / u_viewport.x - 1.0,\n"
+    "                       1.0 - 2.0 * y / u_viewport.y, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *fragment_src =
+    "uniform vec3 u_color;\n"
+    "uniform vec2 u_dash;\n" /* on, period in px; period 0 = solid */
+    "uniform float u_scale;\n"
+    "out vec4 frag;\n"
+    "void main()\n"
+    "{\n"
+    "    if (u_dash.y > 0.0 &&\n"
+    "        mod(gl_FragCoord.x / u_scale, u_dash.y) >= u_dash.x)\n"
+    "        discard;\n"
+    "    frag = vec4(u_color, 1.0);\n"
+    "}\n";
+
+static GLuint compile_shader(GLenum type, const char *header, const char *src)
+{
+    GLuint sh = glCreateShader(type);
+    const char *parts[2] = {header, src};
+    GLint ok = 0;
+
+    glShaderSource(sh, 2, parts, NULL);
+    glCompileShader(sh);
+    glGetShaderiv(sh, GL_COMPILE_STATUS, &ok);
+
+    if (!ok)
+    {
+        char log[1024];
+        glGetShaderInfoLog(sh, sizeof(log), NULL, log);
+        printf("[GUI] GL shader compile failed: %s\n", log);
+        glDeleteShader(sh);
+        return 0;
+    }
+    return sh;
+}
+
+static void split_time(double t, float *hi, float *lo)
+{
+    *hi = (float)t;
+    *lo = (float)(t - *hi);
+}
+
+gboolean glplot_init(gboolean use_es)
+{
+    /* GLES 3 vertex shaders always have highp, which the times need */
+    const char *vs_header = use_es ? "#version 300 es\nprecision highp float;\n"
+                                   : "#version 150\n";
+    const char *fs_header = use_es
+                                ? "#version 300 es\nprecision mediump float;\n"
+                                : "#version 150\n";
+
+    GLuint vs = compile_shader(GL_VERTEX_SHADER, vs_header, vertex_src);
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fs_header, fragment_src);
+    if (!vs || !fs)
+        return FALSE;
+
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glBindAttribLocation(program, 0, "a_pos");
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok)
+    {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        printf("[GUI] GL program link failed: %s\n", log);
+        glDeleteProgram(program);
+        program = 0;
+        return FALSE;
+    }
+
+    u_viewport = glGetUniformLocation(program, "u_viewport");
+    u_plot = glGetUniformLocation(program, "u_plot");
+    u_time = glGetUniformLocation(program, "u_time");
+    u_ymax = glGetUniformLocation(program, "u_ymax");
+    u_color = glGetUniformLocation(program, "u_color");
+    u_dash = glGetUniformLocation(program, "u_dash");
+    u_scale = glGetUniformLocation(program, "u_scale");
+
+    glGenVertexArrays(1, &pts_vao);
+    glGenBuffers(1, &pts_vbo);
+    glBindVertexArray(pts_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, pts_vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+    glBindVertexArray(0);
+
+    printf("[GUI] GL renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+    return TRUE;
+}
+
+void glplot_shutdown(void)
+{
+    if (!program)
+        return;
+
+    glDeleteBuffers(1, &pts_vbo);
+    glDeleteVertexArrays(1, &pts_vao);
+    glDeleteProgram(program);
+    program = 0;
+}
+
+void glplot_begin(const GlFrame *fr, const float bg[3])
+{
+    frame = *fr;
+
+    glViewport(0, 0, fr->view_w * fr->scale, fr->view_h * fr->scale);
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(bg[0], bg[1], bg[2], 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    /* Keep traces inside the plot (a couple of px for the 0 line) */
+    glEnable(GL_SCISSOR_TEST);
+    glScissor((GLint)(fr->left * fr->scale),
+              (GLint)((fr->view_h - fr->bottom - 2) * fr->scale),
+              (GLsizei)(fr->width * fr->scale),
+              (GLsizei)((fr->height + 4) * fr->scale));
+
+    glUseProgram(program);
+    glUniform2f(u_viewport, (float)fr->view_w, (float)fr->view_h);
+    glUniform4f(u_plot, fr->left, fr->bottom, fr->width, fr->height);
+    glUniform1f(u_scale, (float)fr->scale);
+}
+
+static void apply_style(const GlStyle *st)
+{
+    glUniform3fv(u_color, 1, st->color);
+    glUniform1f(u_ymax, st->y_max);
+    glUniform2f(u_dash, st->dash_on, st->dash_period);
+}
+
+/* ---------- Incremental raw series ---------- */
+
+GlSeries *glplot_series_new(void)
+{
+    GlSeries *s = g_new0(GlSeries, 1);
+
+    glGenVertexArrays(1, &s->vao);
+    glGenBuffers(1, &s->vbo);
+    glBindVertexArray(s->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, s->vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+    glBindVertexArray(0);
+
+    return s;
+}
+
+void glplot_series_free(GlSeries *s)
+{
+    if (!s)
+        return;
+
+    glDeleteBuffers(1, &s->vbo);
+    glDeleteVertexArrays(1, &s->vao);
+    g_free(s->ts);
+    g_free(s);
+}
+
+/* n vertices at slot (no wrap), written to both copies of the ring */
+static void series_upload(GlSeries *s, uint64_t slot, const float *v, int n)
+{
+    GLsizeiptr vsize = 3 * sizeof(float);
+
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(slot * vsize), n * vsize, v);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)((slot + s->cap) * vsize),
+                    n * vsize, v);
+}
+
+static void series_sync(GlSeries *s, SampleRing *raw)
+{
+    static uint64_t ts[GL_CHUNK];
+    static double val[GL_CHUNK];
+    static float verts[3 * GL_CHUNK];
+    double *vals[1] = {val};
+
+    uint64_t tail = atomic_load_explicit(&raw->tail, memory_order_acquire);
+    uint64_t latest;
+
+    glBindBuffer(GL_ARRAY_BUFFER, s->vbo);
+
+    if (s->cap != raw->capacity)
+    {
+        s->cap = raw->capacity;
+        s->ts = g_renew(uint64_t, s->ts, s->cap);
+        glBufferData(GL_ARRAY_BUFFER,
+                     (GLsizeiptr)(2 * s->cap * 3 * sizeof(float)), NULL,
+                     GL_DYNAMIC_DRAW);
+        s->any = FALSE;
+    }
+
+    /* Cleared or rewound (timestamp reset): start over */
+    if (tail != s->tail_seen || !ring_latest_ts(raw, &latest) ||
+        (s->any && latest < s->last_ts))
+    {
+        s->tail_seen = tail;
+        s->any = FALSE;
+        s->written = 0;
+    }
+
+    for (;;)
+    {
+        int n = ring_read_since(raw, s->any ? s->last_ts + 1 : 0,
+                                ts, vals, GL_CHUNK);
+        if (n == 0)
+            break;
+
+        if (!s->any)
+        {
+            s->base_ts = ts[0];
+            s->any = TRUE;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            split_time((ts[i] - s->base_ts) / 1e6, &verts[3 * i],
+                       &verts[3 * i + 1]);
+            verts[3 * i + 2] = (float)val[i];
+            s->ts[(s->written + i) % s->cap] = ts[i];
+        }
+
+        uint64_t slot = s->written % s->cap;
+        int first = (int)MIN((uint64_t)n, s->cap - slot);
+
+        series_upload(s, slot, verts, first);
+        if (first < n)
+            series_upload(s, 0, verts + 3 * first, n - first);
+
+        s->written += n;
+        s->last_ts = ts[n - 1];
+
+        if (n < GL_CHUNK)
+            break;
+    }
+}
+
+void glplot_draw_raw(GlSeries *s, SampleRing *raw, uint64_t t_min,
+                     uint64_t window, const GlStyle *st)
+{
+    series_sync(s, raw);
+
+    if (!s->any)
+        return;
+
+    uint64_t first = s->written > s->cap ? s->written - s->cap : 0;
+    uint64_t lo = first, hi = s->written;
+
+    /* First uploaded sample at or after t_min */
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (s->ts[mid % s->cap] < t_min)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* One sample left of the window so the line enters from the edge */
+    if (lo > first)
+        lo--;
+
+    /* Up to one sample past the right edge; a frozen view ends early */
+    uint64_t end = lo, top = s->written;
+    uint64_t t_end = t_min + window;
+
+    while (end < top)
+    {
+        uint64_t mid = end + (top - end) / 2;
+        if (s->ts[mid % s->cap] <= t_end)
+            end = mid + 1;
+        else
+            top = mid;
+    }
+    if (end < s->written)
+        end++;
+
+    uint64_t count = end - lo;
+    if (count < 2)
+        return;
+
+    float t_hi, t_lo;
+
+    split_time(((double)t_min - (double)s->base_ts) / 1e6, &t_hi, &t_lo);
+    apply_style(st);
+    glUniform3f(u_time, t_hi, t_lo, (float)(window / 1e6));
+
+    glBindVertexArray(s->vao);
+    glDrawArrays(GL_LINE_STRIP, (GLint)(lo % s->cap), (GLsizei)count);
+    glBindVertexArray(0);
+}
+
+/* ---------- Pre-decimated points ---------- */
+
+void glplot_draw_points(const double *x, const double *v, int n,
+                        const GlStyle *st)
+{
+    static float *verts = NULL;
+    static int cap = 0;
+
+    if (n < 2)
+        return;
+
+    if (n > cap)
+    {
+        cap = n;
+        verts = g_renew(float, verts, 3 * cap);
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        verts[3 * i] = (float)x[i];
+        verts[3 * i + 1] = 0.0f;
+        verts[3 * i + 2] = (float)v[i];
+    }
+
+    apply_style(st);
+
+    /* x is already in px from the plot's left edge */
+    glUniform3f(u_time, 0.0f, 0.0f, frame.width);
+
+    glBindVertexArray(pts_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, pts_vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(3 * n * sizeof(float)), verts,
+                 GL_STREAM_DRAW);
+    glDrawArrays(GL_LINE_STRIP, 0, n);
+    glBindVertexArray(0);
+}
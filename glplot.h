@@ -0,0 +1,56 @@
+#ifndef GLPLOT_H
+#define GLPLOT_H
+
+#include "ring.h"
+
+/* ---------- OpenGL trace renderer (GtkGLArea backend) ----------
+ *
+ * Each (gateway, sensor) series mirrors its raw SampleRing in a VBO:
+ * every frame only the samples that arrived since the last frame are
+ * uploaded (glBufferSubData), and the visible part is drawn as one line
+ * strip. The VBO holds the ring twice (slot i and i + capacity) so any
+ * window of the ring is contiguous and needs a single draw call.
+ *
+ * A vertex holds the seconds since the series' first sample as two
+ * floats (high part and remainder, see glplot.c) and the raw value; the
+ * shader maps both into the plot rectangle.
+ *
+ * Windows longer than the raw ring are drawn from already decimated
+ * points (glplot_draw_points), re-uploaded each frame.
+ *
+ * All calls need the GtkGLArea's context to be current.
+ */
+typedef struct GlSeries GlSeries;
+
+typedef struct
+{
+    float color[3];
+    float y_max;
+    float dash_on;     /* px, 0 = solid */
+    float dash_period; /* px */
+} GlStyle;
+
+/* Plot rectangle in widget (logical) pixels */
+typedef struct
+{
+    int view_w, view_h;
+    int scale;
+    float left, bottom; /* y of the value 0 baseline */
+    float width, height;
+} GlFrame;
+
+gboolean glplot_init(gboolean use_es);
+void glplot_shutdown(void);
+
+void glplot_begin(const GlFrame *fr, const float bg[3]);
+
+GlSeries *glplot_series_new(void);
+void glplot_series_free(GlSeries *s);
+void glplot_draw_raw(GlSeries *s, SampleRing *raw, uint64_t t_min,
+                     uint64_t window, const GlStyle *st);
+
+/* x: px from the plot's left edge, v: raw values (decimate_minmax output) */
+void glplot_draw_points(const double *x, const double *v, int n,
+                        const GlStyle *st);
+
+#endif
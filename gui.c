@@ -3,85 +3,191 @@
 
 /* ---------- Connect with backend ---------- */
 
-#include <arpa/inet.h>
-#include <sys/socket.h>
-#include <sys/select.h>
 #include <errno.h>
-#include <pthread.h>
 #include <inttypes.h>
+#include <stdatomic.h>
+#include <time.h>
 
 /* ---------- Sensor Model ---------- */
 
 #include "utils.h"
+#include "channels.h"
+#include "history.h"
+#include "decimate.h"
+#include "gateway.h"
+#include "recorder.h"
+#include "export.h"
+#include "fft.h"
+#include "glplot.h"
+#include "msgpool.h"
+#include "perf.h"
+#include "trace.h"
+#include "trigger.h"
+#include "xform.h"
 
 #define VISIBLE_CYCLES 5
 #define VISIBLE_SAMPLES 300
 #define MIN_WINDOW_US 50000ULL   // 50 ms
 #define MAX_WINDOW_US 5000000ULL // 5 s
+#define MAX_MANUAL_WINDOW_US (24ULL * 3600 * 1000000) // 24 h, WINDOW cmd
+#define MAX_SENSOR_WINDOW_US 30000000ULL              // 30 s, per-sensor auto
+#define MIN_RATE_HZ 10
+#define MAX_RATE_HZ 1000
 
-void push_sample(int sid, double value, uint64_t ts);
-static void *net_rx_thread(void *arg);
-static int recv_all(int fd, void *buf, size_t len);
 static void set_connect_status(const char *msg, const char *color);
-
-static pthread_mutex_t sample_lock = PTHREAD_MUTEX_INITIALIZER;
-
-static uint64_t sample_ts[SENSOR_COUNT][MAX_SAMPLES];
-
-static uint64_t server_t0 = 0;
+static void update_dropdown();
+static void add_channel_checkboxes(void);
+static void view_set_frozen(gboolean frozen);
+
+/* Set by the WINDOW command; stops rate updates from resizing the window */
+static gboolean window_locked = FALSE;
+
+/*
+ * Each sensor's own auto window (VISIBLE_SAMPLES at its rate), so a slow
+ * TEMP is not squeezed into ADC0's window. 0 = no rate known yet. While
+ * WINDOW is locked every sensor uses time_window_us.
+ */
+static uint64_t sensor_window_us[MAX_CHANNELS];
+
+/*
+ * Live, the plot's right edge follows the newest sample. Frozen (Freeze
+ * button, or by dragging the plot) it stays at view_t_max while ingest
+ * carries on into the histories, and the view can be panned. view_zoom
+ * scales every sensor's window in both modes (mouse wheel).
+ */
+#define VIEW_ZOOM_STEP 1.25
+#define MIN_VIEW_ZOOM 1e-4
+#define MAX_VIEW_ZOOM 1e6
+#define MIN_VIEW_WINDOW_US 1000ULL // 1 ms
+
+static gboolean view_frozen = FALSE;
+static uint64_t view_t_max = 0;
+static double view_zoom = 1.0;
+
+/*
+ * TRIGGER: while capture_shown the plot draws the capture buffer
+ * instead of the live histories, over its own span (trigger.h).
+ */
+#define TRIGGER_POLL_MS 20
+#define TRIGGER_TIMEOUT_US 1000000 // post-trigger data late: copy anyway
+
+static gboolean capture_shown = FALSE;
+static uint64_t trig_pre_us = TRIGGER_DEFAULT_PRE_US;
+static uint64_t trig_post_us = TRIGGER_DEFAULT_POST_US;
+static gboolean trig_single = FALSE; /* stay disarmed after a capture */
+static guint trig_timer = 0;
+
+static double cursor_x = -1; /* pointer over the plot, -1 = not */
+static gboolean view_dragging = FALSE;
+static double drag_x0;
+static uint64_t drag_t_max;
+
+/* ---------- Command-line options ---------- */
+
+static gint opt_raw_samples = DEFAULT_RAW_SAMPLES;
+static gint opt_tier_buckets = DEFAULT_TIER_BUCKETS;
+static gint opt_connect_timeout_ms = DEFAULT_CONNECT_TIMEOUT_MS;
+static gboolean opt_legacy_wire = FALSE;
+static gboolean opt_gl = FALSE;
+static gboolean opt_full_redraw = FALSE;
+static gchar *opt_record = NULL;
+static gchar *opt_replay = NULL;
+static gdouble opt_replay_speed = 1.0;
+static gboolean opt_hud = FALSE;
+static gchar **opt_profiles = NULL;
+static gboolean opt_no_reconnect = FALSE;
+static gboolean opt_startup_profile = FALSE;
+static gboolean opt_multicast = FALSE;
+
+static GOptionEntry option_entries[] = {
+    {"raw-samples", 0, 0, G_OPTION_ARG_INT, &opt_raw_samples,
+     "Full-rate samples kept per sensor", "N"},
+    {"tier-buckets", 0, 0, G_OPTION_ARG_INT, &opt_tier_buckets,
+     "Buckets kept per downsampled (10x, 100x) tier", "N"},
+    {"connect-timeout", 0, 0, G_OPTION_ARG_INT, &opt_connect_timeout_ms,
+     "Gateway connect timeout in milliseconds", "MS"},
+    {"legacy-wire", 0, 0, G_OPTION_ARG_NONE, &opt_legacy_wire,
+     "Do not negotiate the packed batch format", NULL},
+    {"gl", 0, 0, G_OPTION_ARG_NONE, &opt_gl,
+     "Draw the traces with OpenGL (falls back to Cairo)", NULL},
+    {"full-redraw", 0, 0, G_OPTION_ARG_NONE, &opt_full_redraw,
+     "Restroke every visible point each frame (no scrolling cache)", NULL},
+    {"record", 0, 0, G_OPTION_ARG_FILENAME, &opt_record,
+     "Record the stream to FILE once connected", "FILE"},
+    {"replay", 0, 0, G_OPTION_ARG_FILENAME, &opt_replay,
+     "Replay a recording instead of connecting", "FILE"},
+    {"replay-speed", 0, 0, G_OPTION_ARG_DOUBLE, &opt_replay_speed,
+     "Replay speed factor (default 1.0)", "X"},
+    {"hud", 0, 0, G_OPTION_ARG_NONE, &opt_hud,
+     "Show the ingest/render statistics over the graph", NULL},
+    {"profile", 0, 0, G_OPTION_ARG_STRING_ARRAY, &opt_profiles,
+     "Rate profile for PROFILE NAME (repeatable)", "NAME=ID:HZ,..."},
+    {"no-reconnect", 0, 0, G_OPTION_ARG_NONE, &opt_no_reconnect,
+     "Disconnect when a gateway link drops instead of reconnecting", NULL},
+    {"startup-profile", 0, 0, G_OPTION_ARG_NONE, &opt_startup_profile,
+     "Print how long startup took up to the first frame", NULL},
+    {"multicast", 0, 0, G_OPTION_ARG_NONE, &opt_multicast,
+     "Receive batches over the gateway's UDP multicast group", NULL},
+    {NULL}};
+
+/* Traces drawn by the GtkGLArea; cleared if GL setup fails */
+static gboolean gl_active = FALSE;
+
+/* Static layers are rendered from the second frame on (see deferred_init) */
+static gboolean plot_ready = FALSE;
+
+/* CPU time of the last GtkGLArea render, counted into the next frame */
+static int64_t gl_frame_us = 0;
+
+/* Set by the I/O thread when new samples land, consumed once per frame */
+static atomic_int graph_dirty = 0;
 
 static gboolean suppress_checkbox_cb = FALSE;
 
-static int sock_fd = -1;
-static pthread_t net_thread;
-static volatile int net_running = 0;
+/* Bumped on every connect so stale I/O events are ignored */
+static guint next_gen = 0;
+static int last_connect_err = 0;
+
+/* Active replay (STATE_REPLAYING), fed into gateways[] like live data */
+static Replay *replay = NULL;
+#define MIN_REPLAY_SPEED 0.1
+#define MAX_REPLAY_SPEED 100.0
 
-static char connected_ip[64] = {0};
+/* Line styles telling gateways apart when their traces are overlaid */
+static const double gateway_dashes[MAX_GATEWAYS][4] = {
+    {0, 0, 0, 0}, {8, 4, 0, 0}, {2, 3, 0, 0}, {10, 3, 2, 3}};
+static const int gateway_dash_count[MAX_GATEWAYS] = {0, 2, 2, 4};
 
 /* ---------- Store command history ---------- */
 
-static char *cmd_history[CMD_HISTORY_SIZE];
+static char cmd_history[CMD_HISTORY_SIZE][CMD_LINE_MAX];
 static int cmd_hist_count = 0;
 static int cmd_hist_index = -1;
 
-/* ---------- Per-sensor Y scaling ---------- */
-static const double sensor_y_max[SENSOR_COUNT] = {
-    1024.0, // Temp (raw RTD-ish)
-    4095.0, // ADC 0
-    4095.0, // ADC 1
-    255.0,  // Switches
-    1.0     // Push buttons
-};
-
-const char *sensor_ids[SENSOR_COUNT] = {
-    "TEMP", "ADC0", "ADC1", "SW", "PB"};
+/* Oldest entry makes room once the history is full */
+static void cmd_history_add(const char *line)
+{
+    if (cmd_hist_count == CMD_HISTORY_SIZE)
+    {
+        memmove(cmd_history[0], cmd_history[1],
+                (CMD_HISTORY_SIZE - 1) * sizeof(cmd_history[0]));
+        cmd_hist_count--;
+    }
+    g_strlcpy(cmd_history[cmd_hist_count++], line, CMD_LINE_MAX);
+    cmd_hist_index = cmd_hist_count;
+}
 
-const char *sensor_labels[SENSOR_COUNT] = {
-    "Temp", "ADC 0", "ADC 1", "Switches", "Push Buttons"};
+/* There is one command entry, so one context for its feedback timeouts */
+static CmdClearCtx cmd_clear_ctx;
 
-static double sample_data[SENSOR_COUNT][MAX_SAMPLES];
-static int sample_count[SENSOR_COUNT] = {0};
-static int sample_head[SENSOR_COUNT] = {0};
 static guint connect_status_timeout_id = 0;
 
-/* Plot colors (Matplotlib default palette) */
-static const double plot_colors[SENSOR_COUNT][3] = {
-    {0x1F / 255.0, 0x77 / 255.0, 0xB4 / 255.0}, // Blue
-    {0xFF / 255.0, 0x7F / 255.0, 0x0E / 255.0}, // Orange
-    {0x2C / 255.0, 0xA0 / 255.0, 0x2C / 255.0}, // Green
-    {0xD6 / 255.0, 0x27 / 255.0, 0x28 / 255.0}, // Red
-    {0x94 / 255.0, 0x67 / 255.0, 0xBD / 255.0}  // Purple
-};
-
+/* Sensor ids, labels, colors and Y scaling live in the channel registry */
 static const char *canonical_sensor(const char *s)
 {
-    for (int i = 0; i < SENSOR_COUNT; i++)
-    {
-        if (g_ascii_strcasecmp(s, sensor_ids[i]) == 0 ||
-            g_ascii_strcasecmp(s, sensor_labels[i]) == 0)
-            return sensor_ids[i];
-    }
-    return NULL;
+    int c = channel_find(s);
+
+    return c >= 0 ? channel_id(c) : NULL;
 }
 
 /* ---------- State ---------- */
@@ -92,37 +198,46 @@ static AppState state = STATE_DISCONNECTED;
 /* ---------- Widgets ---------- */
 
 GtkWidget *connect_entry, *connect_btn, *disconnect_btn, *shutdown_btn;
-GtkWidget *start_btn, *stop_btn;
+GtkWidget *start_btn, *stop_btn, *freeze_btn;
 GtkWidget *connect_status_label;
 
-GtkWidget *checkboxes[SENSOR_COUNT];
+/* One per registry channel, added as gateways advertise them */
+GtkWidget *checkboxes[MAX_CHANNELS];
+static GtkWidget *sensor_box;
+static int ui_channels = 0;    /* checkboxes built so far */
+static uint64_t selected_mask; /* checked channels, mirrors checkboxes */
 GtkWidget *combo;
 GtkWidget *hz_entry, *config_btn;
 GtkWidget *cmd_entry, *cmd_status;
 
-GHashTable *sensor_freq;
+/* Last rate reported or requested per registry index, 0 = unknown */
+static unsigned sensor_hz[MAX_CHANNELS];
 
 /* ---------- CSS ---------- */
 
 static void reset_plot_state(void)
 {
-    server_t0 = 0;
-
-    for (int s = 0; s < SENSOR_COUNT; s++)
-    {
-        sample_count[s] = 0;
-        sample_head[s] = 0;
-    }
+    for (int g = 0; g < gateway_count; g++)
+        gateway_reset(&gateways[g]);
+
+    /* The frozen span is gone; follow the new data */
+    view_frozen = FALSE;
+    capture_shown = FALSE;
+    if (freeze_btn)
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(freeze_btn), FALSE);
 }
 
 /* ---------- Utilities ---------- */
 static void apply_state()
 {
-    gboolean connected = (state != STATE_DISCONNECTED);
+    gboolean connecting = (state == STATE_CONNECTING);
+    gboolean connected = (state == STATE_CONNECTED || state == STATE_RUNNING);
     gboolean running = (state == STATE_RUNNING);
+    gboolean replaying = (state == STATE_REPLAYING);
 
     const char *ip = gtk_entry_get_text(GTK_ENTRY(connect_entry));
-    gboolean ip_ok = is_valid_ipv4(ip);
+    char ips[MAX_GATEWAYS][64];
+    gboolean ip_ok = parse_ipv4_list(ip, ips, MAX_GATEWAYS) > 0;
 
     GtkStyleContext *ctx =
         gtk_widget_get_style_context(connect_entry);
@@ -132,9 +247,9 @@ static void apply_state()
     if (*ip && !ip_ok)
         gtk_style_context_add_class(ctx, "cmd-error");
 
-    set_enabled(connect_btn, !connected && ip_ok);
+    set_enabled(connect_btn, !connected && !connecting && !replaying && ip_ok);
 
-    set_enabled(connect_entry, !connected);
+    set_enabled(connect_entry, !connected && !connecting && !replaying);
 
     set_enabled(disconnect_btn, connected && !running);
     set_enabled(shutdown_btn, connected && !running);
@@ -143,8 +258,8 @@ static void apply_state()
 
     suppress_checkbox_cb = TRUE;
 
-    for (int i = 0; i < SENSOR_COUNT; i++)
-        set_enabled(checkboxes[i], running);
+    for (int i = 0; i < ui_channels; i++)
+        set_enabled(checkboxes[i], running || replaying);
 
     suppress_checkbox_cb = FALSE;
 
@@ -152,23 +267,105 @@ static void apply_state()
     set_enabled(hz_entry, running);
     set_enabled(config_btn,
                 running && strlen(gtk_entry_get_text(GTK_ENTRY(hz_entry))) > 0);
-    set_enabled(cmd_entry, running);
+    set_enabled(cmd_entry, running || replaying);
 }
 
-static gboolean handle_connection_lost(gpointer data)
+static int live_gateways(void)
 {
-    (void)data;
+    int live = 0;
+    for (int g = 0; g < gateway_count; g++)
+        if (gateways[g].conn && gateways[g].connected)
+            live++;
+    return live;
+}
+
+/* Queue a command for every connected gateway; never blocks the UI */
+static gboolean gateway_send(const char *cmd)
+{
+    gboolean any = FALSE;
+
+    for (int g = 0; g < gateway_count; g++)
+    {
+        Gateway *gw = &gateways[g];
+
+        if (!gw->conn || !gw->connected)
+            continue;
+
+        if (net_send(gw->conn, cmd))
+            any = TRUE;
+        else
+            printf("Failed to queue for %s: %s", gw->ip, cmd);
+    }
+
+    if (any)
+        printf("Sent: %s", cmd);
+    return any;
+}
+
+/*
+ * Brings every live gateway's stream in line with the checkboxes:
+ * unchecked channels are unsubscribed and no longer buffered.
+ */
+static void update_subscriptions(void)
+{
+    char cmd[2 * (16 + MAX_CHANNELS * CHANNEL_ID_LEN)];
+
+    for (int g = 0; g < gateway_count; g++)
+    {
+        Gateway *gw = &gateways[g];
+
+        if (!gw->conn || !gw->connected)
+            continue;
+
+        if (!gateway_subscription(gw, selected_mask, cmd, sizeof(cmd)))
+            continue;
+
+        if (net_send(gw->conn, cmd))
+            printf("[GUI] %s: %s", gw->ip, cmd);
+        else
+            printf("Failed to queue for %s: %s", gw->ip, cmd);
+    }
+}
+
+static void gateway_close(Gateway *gw, gboolean drain)
+{
+    if (!gw->conn)
+        return;
+
+    net_close(gw->conn, drain);
+    gw->conn = NULL;
+    gw->connected = FALSE;
+    gw->reconnecting = FALSE;
+
+    /* Anything still queued for this connection is now stale */
+    gw->gen = ++next_gen;
+}
+
+static void gateway_close_all(gboolean drain)
+{
+    for (int g = 0; g < gateway_count; g++)
+        gateway_close(&gateways[g], drain);
+
+    recorder_stop();
+}
+
+static void handle_connection_lost(Gateway *gw)
+{
+    gateway_close(gw, FALSE);
+    gateway_reset(gw);
 
-    if (net_running)
-        net_running = 0;
+    printf("[GUI] Connection to %s lost\n", gw->ip);
 
-    if (sock_fd >= 0)
+    if (live_gateways() > 0)
     {
-        close(sock_fd);
-        sock_fd = -1;
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Connection to %s lost", gw->ip);
+        set_connect_status(msg, "red");
+        return;
     }
 
     reset_plot_state();
+    recorder_stop();
 
     state = STATE_DISCONNECTED;
 
@@ -176,17 +373,77 @@ static gboolean handle_connection_lost(gpointer data)
     apply_state();
 
     printf("[GUI] Connection lost → auto-disconnected\n");
+}
 
-    return G_SOURCE_REMOVE; // run once
+/*
+ * The link dropped; the I/O thread is reconnecting in the background
+ * and the buffers stay as they are (gateway_link_lost()).
+ */
+static void handle_link_reconnecting(Gateway *gw, int err)
+{
+    char msg[128];
+
+    gw->connected = FALSE;
+    gw->reconnecting = TRUE;
+
+    /* The new session may report its defaults before we restore these */
+    memcpy(gw->resume_hz, gw->rate_hz, sizeof(gw->resume_hz));
+
+    printf("[GUI] Connection to %s lost (%s), reconnecting\n", gw->ip,
+           strerror(err));
+    snprintf(msg, sizeof(msg), "Connection to %s lost, reconnecting...",
+             gw->ip);
+    set_connect_status(msg, "orange");
+}
+
+/*
+ * Back after a drop: the new session knows nothing of ours, so repeat
+ * the rates the gateway reported before it, the subscription and START.
+ */
+static void resume_gateway(Gateway *gw)
+{
+    char cmd[NET_CMD_MAX];
+    uint64_t have = atomic_load(&gw->channels);
+    int n = snprintf(cmd, sizeof(cmd), "CONFIGURE");
+    int pairs = 0;
+
+    gw->reconnecting = FALSE;
+
+    for (uint64_t m = have; m && n < (int)sizeof(cmd); m &= m - 1)
+    {
+        int c = __builtin_ctzll(m);
+
+        if (!gw->resume_hz[c])
+            continue;
+        n += snprintf(cmd + n, sizeof(cmd) - n, " %s %u", channel_id(c),
+                      gw->resume_hz[c]);
+        pairs++;
+    }
+
+    if (pairs && n + 1 < (int)sizeof(cmd))
+    {
+        strcpy(cmd + n, "\n");
+        net_send(gw->conn, cmd);
+    }
+
+    /* A new session streams every channel until told otherwise */
+    gw->subscribed = ~0ULL;
+    update_subscriptions();
+
+    if (state == STATE_RUNNING)
+        net_send(gw->conn, "START\n");
+
+    printf("[GUI] Reconnected to %s, %d rate(s) restored%s\n", gw->ip, pairs,
+           state == STATE_RUNNING ? ", streaming" : "");
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Reconnected to %s", gw->ip);
+    set_connect_status(msg, "green");
 }
 
 static int checked_count()
 {
-    int c = 0;
-    for (int i = 0; i < SENSOR_COUNT; i++)
-        if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(checkboxes[i])))
-            c++;
-    return c;
+    return __builtin_popcountll(selected_mask);
 }
 
 static void shutdown_clicked(GtkButton *b, gpointer d)
@@ -213,219 +470,462 @@ static void shutdown_clicked(GtkButton *b, gpointer d)
     /* -------- User confirmed shutdown -------- */
 
     /* Stop streaming if running */
-    if (state == STATE_RUNNING && sock_fd >= 0)
-    {
-        send(sock_fd, "STOP\n", 5, 0);
-        printf("Sent STOP (before shutdown)\n");
-    }
-
-    if (net_running)
-    {
-        net_running = 0;
-        shutdown(sock_fd, SHUT_RDWR);
-        pthread_join(net_thread, NULL);
-    }
+    if (state == STATE_RUNNING)
+        gateway_send("STOP\n");
 
-    if (sock_fd >= 0)
-    {
-        send(sock_fd, "SHUTDOWN\n", 9, 0);
-        printf("Sent SHUTDOWN\n");
+    gateway_send("SHUTDOWN\n");
 
-        close(sock_fd);
-        sock_fd = -1;
-    }
+    /* Let the I/O threads flush STOP/SHUTDOWN before closing */
+    gateway_close_all(TRUE);
 
     state = STATE_DISCONNECTED;
     apply_state();
     gtk_main_quit();
 }
 
-static gboolean redraw_graph(gpointer data)
+/* Frame clock tick: at most one redraw per vblank, only if data arrived */
+static gboolean graph_tick(GtkWidget *widget, GdkFrameClock *clock,
+                           gpointer data)
 {
-    gtk_widget_queue_draw(graph_area);
+    (void)clock;
+    (void)data;
+
+    if (atomic_exchange_explicit(&graph_dirty, 0, memory_order_acq_rel))
+        gtk_widget_queue_draw(widget);
+
     return G_SOURCE_CONTINUE;
 }
 
-static gboolean handle_rates_update(gpointer data)
+/* VISIBLE_SAMPLES worth of time at rate_hz, clamped */
+static uint64_t auto_window_us(unsigned int rate_hz, uint64_t max_us)
 {
-    RatesMsg *msg = (RatesMsg *)data;
-    server_t0 = 0;
+    double sample_period_us = 1e6 / rate_hz;
+    uint64_t us = (uint64_t)(VISIBLE_SAMPLES * sample_period_us);
+
+    if (us < MIN_WINDOW_US)
+        us = MIN_WINDOW_US;
+    if (us > max_us)
+        us = max_us;
+    return us;
+}
 
-    for (int i = 0; i < SENSOR_COUNT; i++)
-    {
-        char buf[16];
-        snprintf(buf, sizeof(buf), "%u", msg->rates[i].rate_hz);
+/* Derive the shared window (X axis default, replay seek lead) from ADC0 */
+static void set_auto_window(unsigned int rate_hz)
+{
+    if (window_locked || rate_hz == 0)
+        return;
 
-        g_hash_table_replace(sensor_freq,
-                             g_strdup(sensor_ids[msg->rates[i].sensor_id]),
-                             g_strdup(buf));
+    time_window_us = auto_window_us(rate_hz, MAX_WINDOW_US);
 
-        /* Dynamic time window for ADC0 */
-        if (msg->rates[i].sensor_id == adc_zero_sid &&
-            msg->rates[i].rate_hz > 0)
-        {
-            double sample_period_us =
-                1e6 / msg->rates[i].rate_hz;
+    printf("[GUI] Time window set to %.2f ms\n",
+           time_window_us / 1000.0);
+}
 
-            time_window_us =
-                (uint64_t)(VISIBLE_SAMPLES * sample_period_us);
+static void set_sensor_window(int s, unsigned int rate_hz)
+{
+    if (rate_hz == 0)
+        return;
 
-            if (time_window_us < MIN_WINDOW_US)
-                time_window_us = MIN_WINDOW_US;
-            if (time_window_us > MAX_WINDOW_US)
-                time_window_us = MAX_WINDOW_US;
+    sensor_window_us[s] = auto_window_us(rate_hz, MAX_SENSOR_WINDOW_US);
+}
 
-            printf("[GUI] Time window set to %.2f ms\n",
-                   time_window_us / 1000.0);
-        }
-    }
+static uint64_t window_for(int s)
+{
+    uint64_t w = (window_locked || sensor_window_us[s] == 0)
+                     ? time_window_us
+                     : sensor_window_us[s];
+
+    if (capture_shown)
+        w = capture_info()->t_max - capture_info()->t_min;
+
+    if (view_zoom == 1.0)
+        return w;
+
+    double z = w * view_zoom;
+    if (z < MIN_VIEW_WINDOW_US)
+        return MIN_VIEW_WINDOW_US;
+    if (z > MAX_MANUAL_WINDOW_US)
+        return MAX_MANUAL_WINDOW_US;
+    return (uint64_t)z;
+}
+
+/* "300 ms", "30 s", "10 min" */
+static void format_window(uint64_t us, char *buf, size_t len)
+{
+    if (us < 1000000)
+        snprintf(buf, len, "%" PRIu64 " ms", us / 1000);
+    else if (us < 600000000ULL)
+        snprintf(buf, len, "%.3g s", us / 1e6);
+    else
+        snprintf(buf, len, "%.3g min", us / 6e7);
+}
+
+/* Longest window of any sensor, i.e. how much history the plot shows */
+static uint64_t widest_window(void)
+{
+    uint64_t w = 0;
+
+    for (int s = 0; s < ui_channels; s++)
+        if (window_for(s) > w)
+            w = window_for(s);
+    return w;
+}
+
+/* Hz entry shows the known rate of the sensor with this id */
+static void show_rate(const char *id)
+{
+    int c = channel_find(id);
+    char buf[16] = "";
+
+    if (c >= 0 && sensor_hz[c])
+        snprintf(buf, sizeof(buf), "%u", sensor_hz[c]);
+    gtk_entry_set_text(GTK_ENTRY(hz_entry), buf);
+}
 
-    /* Update Hz entry for active sensor */
+/* ... of the sensor picked in the dropdown */
+static void show_active_rate(void)
+{
     const char *active =
         gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo));
 
     if (active)
+        show_rate(active);
+}
+
+static gboolean handle_rates_update(gpointer data)
+{
+    RatesMsg *msg = (RatesMsg *)data;
+    Gateway *gw = &gateways[msg->gateway];
+
+    /* Connection (or replay) went away while this was queued */
+    if (gw->gen != msg->gen)
     {
-        const char *val =
-            g_hash_table_lookup(sensor_freq, active);
-        gtk_entry_set_text(GTK_ENTRY(hz_entry),
-                           val ? val : "");
+        msg_free(msg);
+        return G_SOURCE_REMOVE;
     }
 
-    if (!msg)
-        return G_SOURCE_REMOVE;
+    /* The time base stays: new samples continue the history's axis */
+    for (int i = 0; i < msg->count; i++)
+    {
+        if (msg->rates[i].sensor_id >= (uint32_t)channel_count())
+            continue;
+
+        gw->rate_hz[msg->rates[i].sensor_id] = msg->rates[i].rate_hz;
+        sensor_hz[msg->rates[i].sensor_id] = msg->rates[i].rate_hz;
+
+        set_sensor_window(msg->rates[i].sensor_id, msg->rates[i].rate_hz);
+
+        /* Dynamic time window for ADC0 */
+        if (msg->rates[i].sensor_id == adc_zero_sid)
+            set_auto_window(msg->rates[i].rate_hz);
+    }
+
+    show_active_rate();
+
+    msg_free(msg);
+    return G_SOURCE_REMOVE;
+}
+
+typedef struct
+{
+    gboolean grew; /* the registry has channels we had not seen */
+} ChannelsMsg;
+
+/* A gateway advertised its channels */
+static gboolean handle_channels_update(gpointer data)
+{
+    ChannelsMsg *msg = data;
+
+    if (msg->grew)
+        add_channel_checkboxes();
+    update_subscriptions();
 
-    g_free(msg);
+    msg_free(msg);
     return G_SOURCE_REMOVE;
 }
 
-static void *net_rx_thread(void *arg)
+/* ---------- Gateway I/O (runs on the connection's I/O thread) ---------- */
+
+typedef struct
+{
+    Gateway *gw;
+    NetEvent ev;
+    int err;
+    guint gen;
+} NetEventMsg;
+
+/*
+ * gw->gen is only written before net_open() and after net_close(), while
+ * no I/O thread runs for the slot, so reading it here is safe.
+ */
+static void handle_frame(NetConn *c, const Frame *f, void *user)
 {
-    const size_t batch_size = 1440;
-    sensor_data_t batch[batch_size / sizeof(sensor_data_t)];
+    Gateway *gw = user;
+    int64_t t_recv = g_get_monotonic_time();
 
-    char hdr[6];
+    perf_add(&gw->stats.bytes, f->len);
 
-    while (net_running)
+    /* Replayed frames come in with c == NULL and are not re-recorded */
+    if (c && recorder_active())
     {
-        // Peek first 6 bytes
-        ssize_t n = recv(sock_fd, hdr, 6, MSG_PEEK);
-        if (n <= 0)
-            break;
+        unsigned session = recorder_session();
 
-        if (n == 6 && memcmp(hdr, "RATES\n", 6) == 0)
+        /* A new file needs the channel list to make sense of batches */
+        if (gw->rec_session != session)
         {
-            // Consume header
-            recv_all(sock_fd, hdr, 6);
+            Frame adv = {FRAME_CHANNELS, gw->chan_adv, gw->chan_adv_len};
 
-            sensor_rate_t rates[SENSOR_COUNT];
-            if (recv_all(sock_fd, rates, sizeof(rates)) < 0)
-                break;
+            gw->rec_session = session;
+            if (adv.len && f->type != FRAME_CHANNELS)
+                recorder_append((int)(gw - gateways), gw->wire, &adv);
+        }
+        recorder_append((int)(gw - gateways), gw->wire, f);
+    }
 
-            RatesMsg *msg = g_malloc(sizeof(RatesMsg));
-            memcpy(msg->rates, rates, sizeof(msg->rates));
-            g_idle_add(handle_rates_update, msg);
+    if (f->type == FRAME_CHANNELS)
+    {
+        int known = channel_count();
+        int n = gateway_set_channels(gw, f);
 
-            continue;
-        }
+        printf("[GUI] %s: %d channel(s) advertised\n", gw->ip, n);
 
-        // Otherwise assume streaming batch
-        uint32_t net_size;
-        if (recv_all(sock_fd, &net_size, sizeof(net_size)) < 0)
-            break;
+        /* New checkboxes if the registry grew, and this gateway's
+           subscription now that its channel list is known */
+        ChannelsMsg *msg = msg_alloc(sizeof(ChannelsMsg));
+        msg->grew = channel_count() > known;
+        msg_post(msg, handle_channels_update);
+        return;
+    }
 
-        uint32_t payload_size = ntohl(net_size);
+    if (f->type == FRAME_RATES)
+    {
+        sensor_rate_t wire[MAX_CHANNELS];
+        int n = frame_rates(f, wire, MAX_CHANNELS);
+        RatesMsg *msg = msg_alloc(sizeof(RatesMsg));
+
+        msg->gateway = (int)(gw - gateways);
+        msg->gen = gw->gen;
+        msg->count = 0;
 
-        if (payload_size == 0 || payload_size > sizeof(batch))
+        /* Translate wire ids while the I/O thread owns the mapping */
+        for (int i = 0; i < n; i++)
         {
-            printf("Invalid payload size: %u\n", payload_size);
-            break;
+            int ch = wire[i].sensor_id < MAX_CHANNELS
+                         ? gw->chan[wire[i].sensor_id]
+                         : -1;
+            if (ch < 0)
+                continue;
+
+            msg->rates[msg->count].sensor_id = (uint32_t)ch;
+            msg->rates[msg->count].rate_hz = wire[i].rate_hz;
+            msg->count++;
         }
+        msg_post(msg, handle_rates_update);
+        return;
+    }
 
-        if (recv_all(sock_fd, batch, payload_size) < 0)
-            break;
+    if (f->type == FRAME_FORMAT)
+    {
+        /* Every batch after this line uses the acknowledged format */
+        gw->wire = frame_format(f);
+        printf("[GUI] %s: wire format %s\n", gw->ip,
+               gw->wire == WIRE_PACKED ? "packed" : "legacy");
+
+        /* Datagrams are packed, so only now; gateways that don't know
+         * MULTICAST ignore it and stay on TCP */
+        if (c && opt_multicast && gw->wire == WIRE_PACKED)
+            net_send(c, "MULTICAST\n");
+        return;
+    }
 
-        int samples = payload_size / sizeof(sensor_data_t);
+    if (f->type == FRAME_PONG)
+    {
+        int64_t sent, gw_us;
 
-        for (int i = 0; i < samples; i++)
-        {
-            sensor_data_t *pkt = &batch[i];
+        /* A replayed PONG says nothing about this machine's clock */
+        if (c && frame_pong(f, &sent, &gw_us))
+            clock_pong(&gw->clock, sent, gw_us, t_recv);
+        return;
+    }
 
-            if (pkt->sensor_id < SENSOR_COUNT)
-            {
-                push_sample(pkt->sensor_id,
-                            pkt->sensor_value,
-                            pkt->timestamp);
-            }
-        }
+    /* A live batch too far behind is shed instead of pushed */
+    uint64_t newest = gateway_push_batch(gw, f, c ? t_recv : 0);
+    int64_t sampled;
 
-        g_idle_add(redraw_graph, NULL);
+    if (c && newest && clock_to_local(&gw->clock, newest, &sampled))
+    {
+        latency_note(LAT_NET, t_recv - sampled);
+        latency_note(LAT_RING, g_get_monotonic_time() - sampled);
     }
 
-    g_idle_add(handle_connection_lost, NULL);
-    return NULL;
+    atomic_store_explicit(&graph_dirty, 1, memory_order_release);
 }
 
-/* ---------- Focus handling ---------- */
+static gboolean handle_net_event(gpointer data);
 
-static gboolean entry_focus_out(GtkWidget *w, GdkEvent *e, gpointer d)
+static void net_event_cb(NetConn *c, NetEvent ev, int err, void *user)
 {
-    gtk_editable_select_region(GTK_EDITABLE(w), -1, -1);
-    gtk_editable_set_position(GTK_EDITABLE(w), -1);
-    return FALSE;
+    Gateway *gw = user;
+    (void)c;
+
+    /* On the I/O thread, before any sample of the next session */
+    if (ev == NET_EV_RECONNECTING)
+        gateway_link_lost(gw);
+
+    NetEventMsg *msg = msg_alloc(sizeof(NetEventMsg));
+    msg->gw = gw;
+    msg->ev = ev;
+    msg->err = err;
+    msg->gen = gw->gen;
+    msg_post(msg, handle_net_event);
 }
 
-/* ---------- Dropdown ---------- */
+static const NetHandlers net_handlers = {
+    .on_frame = handle_frame,
+    .on_event = net_event_cb,
+};
 
-static void update_dropdown()
+/* ---------- Replay (runs on the replay thread) ---------- */
+
+static gboolean handle_replay_end(gpointer data)
 {
-    gtk_combo_box_text_remove_all(GTK_COMBO_BOX_TEXT(combo));
-    for (int i = 0; i < SENSOR_COUNT; i++)
+    (void)data;
+
+    if (state == STATE_REPLAYING)
+        set_connect_status("Replay finished", "green");
+    return G_SOURCE_REMOVE;
+}
+
+static void replay_frame_cb(int gateway, WireFormat wire, const Frame *f,
+                            void *user)
+{
+    (void)user;
+
+    if (gateway >= gateway_count)
+        return;
+
+    Gateway *gw = &gateways[gateway];
+    gw->wire = wire;
+    handle_frame(NULL, f, gw);
+}
+
+static void replay_seek_cb(void *user)
+{
+    (void)user;
+
+    /* The replay thread is the only producer, so clearing here is safe */
+    for (int g = 0; g < gateway_count; g++)
     {
-        if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(checkboxes[i])))
-            gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(combo),
-                                      sensor_ids[i], sensor_labels[i]);
+        gateway_reset(&gateways[g]);
+        gateways[g].last_ts = 0;
     }
-    gtk_combo_box_set_active(GTK_COMBO_BOX(combo), 0);
+    atomic_store_explicit(&graph_dirty, 1, memory_order_release);
+}
+
+static void replay_end_cb(void *user)
+{
+    (void)user;
+    g_idle_add(handle_replay_end, NULL);
 }
 
-void push_sample(int sid, double value, uint64_t ts)
+static const ReplayHandlers replay_handlers = {
+    .on_frame = replay_frame_cb,
+    .on_seek = replay_seek_cb,
+    .on_end = replay_end_cb,
+};
+
+/* Replay stands in for the gateways: one slot per recorded gateway */
+static gboolean start_replay(const char *path, double speed)
 {
-    static uint64_t last_ts = 0;
+    if (state != STATE_DISCONNECTED)
+        return FALSE;
 
-    /* Detect timestamp reset or backward jump */
-    if (last_ts != 0 && ts < last_ts)
+    replay = replay_open(path, &replay_handlers, NULL);
+    if (!replay)
     {
-        printf("[GUI] Timestamp reset detected → clearing buffers\n");
+        set_connect_status("Cannot open recording", "red");
+        return FALSE;
+    }
 
-        pthread_mutex_lock(&sample_lock);
-        for (int s = 0; s < SENSOR_COUNT; s++)
-        {
-            sample_count[s] = 0;
-            sample_head[s] = 0;
-        }
-        pthread_mutex_unlock(&sample_lock);
+    gateway_count = replay_gateways(replay);
+    if (gateway_count > MAX_GATEWAYS)
+        gateway_count = MAX_GATEWAYS;
 
-        server_t0 = ts;
+    for (int g = 0; g < gateway_count; g++)
+    {
+        Gateway *gw = &gateways[g];
+
+        snprintf(gw->ip, sizeof(gw->ip), "replay %d", g + 1);
+        gw->conn = NULL;
+        gw->connected = FALSE;
+        gw->last_ts = 0;
+        gw->wire = WIRE_LEGACY;
+        gateway_default_channels(gw);
+        memset(gw->rate_hz, 0, sizeof(gw->rate_hz));
+        gw->gen = ++next_gen;
+
+        gateway_init_history(gw, opt_raw_samples, opt_tier_buckets);
+        gateway_reset(gw);
     }
 
-    if (server_t0 == 0)
-        server_t0 = ts;
+    if (speed < MIN_REPLAY_SPEED || speed > MAX_REPLAY_SPEED)
+        speed = 1.0;
+    replay_start(replay, speed);
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Replaying %.1f s at %.1fx",
+             replay_duration_us(replay) / 1e6, speed);
+    set_connect_status(msg, "green");
+
+    state = STATE_REPLAYING;
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(checkboxes[0]), TRUE);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(checkboxes[2]), TRUE);
+    update_dropdown();
+    apply_state();
+    return TRUE;
+}
+
+static void stop_replay(void)
+{
+    if (!replay)
+        return;
+
+    replay_close(replay);
+    replay = NULL;
 
-    uint64_t rel_ts = ts - server_t0;
-    last_ts = ts;
+    /* Drop RATES updates still queued from the replay thread */
+    for (int g = 0; g < gateway_count; g++)
+        gateways[g].gen = ++next_gen;
 
-    pthread_mutex_lock(&sample_lock);
+    reset_plot_state();
+
+    state = STATE_DISCONNECTED;
+    set_connect_status("Replay stopped", "black");
+    apply_state();
+    gtk_widget_queue_draw(graph_area);
+}
 
-    sample_data[sid][sample_head[sid]] = value;
-    sample_ts[sid][sample_head[sid]] = rel_ts;
+/* ---------- Focus handling ---------- */
 
-    sample_head[sid] = (sample_head[sid] + 1) % MAX_SAMPLES;
+static gboolean entry_focus_out(GtkWidget *w, GdkEvent *e, gpointer d)
+{
+    gtk_editable_select_region(GTK_EDITABLE(w), -1, -1);
+    gtk_editable_set_position(GTK_EDITABLE(w), -1);
+    return FALSE;
+}
 
-    if (sample_count[sid] < MAX_SAMPLES)
-        sample_count[sid]++;
+/* ---------- Dropdown ---------- */
 
-    pthread_mutex_unlock(&sample_lock);
+static void update_dropdown()
+{
+    gtk_combo_box_text_remove_all(GTK_COMBO_BOX_TEXT(combo));
+    for (int i = 0; i < ui_channels; i++)
+    {
+        if (selected_mask & (1ULL << i))
+            gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(combo),
+                                      channel_id(i), channel_label(i));
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(combo), 0);
 }
 
 static void combo_changed(GtkComboBox *box, gpointer d)
@@ -434,14 +934,17 @@ static void combo_changed(GtkComboBox *box, gpointer d)
     if (!id)
         return;
 
-    const char *val = g_hash_table_lookup(sensor_freq, id);
-    gtk_entry_set_text(GTK_ENTRY(hz_entry), val ? val : "");
+    show_rate(id);
+
+    /* The X axis labels follow the picked sensor */
+    if (graph_area)
+        gtk_widget_queue_draw(graph_area);
 }
 
+/* Cheap enough for the per-frame loops over every channel */
 static gboolean is_sensor_selected(int idx)
 {
-    return gtk_toggle_button_get_active(
-        GTK_TOGGLE_BUTTON(checkboxes[idx]));
+    return (selected_mask >> idx) & 1;
 }
 
 static gboolean cmd_key_press(GtkWidget *w, GdkEventKey *e, gpointer d)
@@ -480,6 +983,13 @@ static gboolean cmd_key_press(GtkWidget *w, GdkEventKey *e, gpointer d)
 
 static void checkbox_changed(GtkToggleButton *btn, gpointer d)
 {
+    int idx = GPOINTER_TO_INT(d);
+
+    if (gtk_toggle_button_get_active(btn))
+        selected_mask |= 1ULL << idx;
+    else
+        selected_mask &= ~(1ULL << idx);
+
     if (suppress_checkbox_cb)
         return;
 
@@ -493,18 +1003,41 @@ static void checkbox_changed(GtkToggleButton *btn, gpointer d)
     }
 
     update_dropdown();
+    update_subscriptions();
 
     if (graph_area)
         gtk_widget_queue_draw(graph_area);
 }
 
-/* ---------- Hz ---------- */
-
-static void hz_changed(GtkEditable *e, gpointer d)
+/* One checkbox per registry channel that does not have one yet */
+static void add_channel_checkboxes(void)
 {
-    const char *txt = gtk_entry_get_text(GTK_ENTRY(hz_entry));
+    int n = channel_count();
 
-    gboolean valid = TRUE;
+    if (n <= ui_channels)
+        return;
+
+    for (int i = ui_channels; i < n; i++)
+    {
+        checkboxes[i] = gtk_check_button_new_with_label(channel_label(i));
+        gtk_widget_set_tooltip_text(checkboxes[i], channel_id(i));
+        gtk_container_add(GTK_CONTAINER(sensor_box), checkboxes[i]);
+        g_signal_connect(checkboxes[i], "toggled",
+                         G_CALLBACK(checkbox_changed), GINT_TO_POINTER(i));
+        gtk_widget_show(checkboxes[i]);
+    }
+
+    ui_channels = n;
+    apply_state();
+}
+
+/* ---------- Hz ---------- */
+
+static void hz_changed(GtkEditable *e, gpointer d)
+{
+    const char *txt = gtk_entry_get_text(GTK_ENTRY(hz_entry));
+
+    gboolean valid = TRUE;
 
     if (!txt || !*txt)
         valid = FALSE;
@@ -523,7 +1056,7 @@ static void hz_changed(GtkEditable *e, gpointer d)
         if (valid)
         {
             int val = atoi(txt);
-            if (val < 10 || val > 1000)
+            if (val < MIN_RATE_HZ || val > MAX_RATE_HZ)
                 valid = FALSE;
         }
     }
@@ -539,54 +1072,94 @@ static void hz_changed(GtkEditable *e, gpointer d)
     set_enabled(config_btn, valid);
 }
 
-static void configure_clicked(GtkButton *b, gpointer d)
+/* 10..1000 Hz as a plain decimal number, -1 otherwise */
+static int parse_rate(const char *txt)
 {
-    if (sock_fd < 0)
-        return;
+    if (!txt || !*txt)
+        return -1;
 
-    const char *id =
-        gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo));
-    const char *freq =
-        gtk_entry_get_text(GTK_ENTRY(hz_entry));
+    for (int i = 0; txt[i]; i++)
+    {
+        if (!isdigit((unsigned char)txt[i]))
+            return -1;
+    }
 
-    if (!id || !*freq)
-        return;
+    int rate = atoi(txt);
+    return (rate < MIN_RATE_HZ || rate > MAX_RATE_HZ) ? -1 : rate;
+}
+
+/*
+ * Sends every rate change in one "CONFIGURE <id> <hz> [<id> <hz> ...]",
+ * so each gateway answers with a single RATES and the plot keeps running
+ * without a reset. Each gateway only gets the channels it advertises
+ * that its last RATES has at another rate; sensor_hz follows once the
+ * RATES come back. Returns how many channels changed on at least one
+ * gateway.
+ */
+static int configure_rates(const sensor_rate_t *r, int n)
+{
+    char net_cmd[16 + MAX_CHANNELS * (CHANNEL_ID_LEN + 12)];
+    uint64_t changed = 0;
 
-    /* validate numeric rate */
-    for (int i = 0; freq[i]; i++)
+    for (int g = 0; g < gateway_count; g++)
     {
-        if (!isdigit((unsigned char)freq[i]))
-            return;
+        Gateway *gw = &gateways[g];
+        uint64_t have = atomic_load(&gw->channels);
+        int len = snprintf(net_cmd, sizeof(net_cmd), "CONFIGURE");
+        int count = 0;
+
+        if (!gw->conn || !gw->connected)
+            continue;
+
+        for (int i = 0; i < n; i++)
+        {
+            if (!((have >> r[i].sensor_id) & 1) ||
+                gw->rate_hz[r[i].sensor_id] == r[i].rate_hz)
+                continue;
+
+            len += snprintf(net_cmd + len, sizeof(net_cmd) - len, " %s %u",
+                            channel_id(r[i].sensor_id), r[i].rate_hz);
+            changed |= 1ULL << r[i].sensor_id;
+            count++;
+        }
+
+        if (count == 0)
+            continue;
+
+        snprintf(net_cmd + len, sizeof(net_cmd) - len, "\n");
+        if (net_send(gw->conn, net_cmd))
+            printf("[GUI] %s: %s", gw->ip, net_cmd);
+        else
+            printf("Failed to queue for %s: %s", gw->ip, net_cmd);
     }
 
-    int rate = atoi(freq);
-    if (rate < 10 || rate > 1000)
+    return __builtin_popcountll(changed);
+}
+
+static void configure_clicked(GtkButton *b, gpointer d)
+{
+    if (live_gateways() == 0)
         return;
 
-    /* send to server */
-    char net_cmd[64];
-    snprintf(net_cmd, sizeof(net_cmd),
-             "CONFIGURE %s %d\n", id, rate);
-    send(sock_fd, net_cmd, strlen(net_cmd), 0);
+    const char *id =
+        gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo));
+    int rate = parse_rate(gtk_entry_get_text(GTK_ENTRY(hz_entry)));
 
-    printf("Sent: %s", net_cmd);
+    if (!id || rate < 0)
+        return;
 
-    /* update local model */
-    g_hash_table_replace(sensor_freq,
-                         g_strdup(id),
-                         g_strdup(freq));
+    sensor_rate_t r = {(uint32_t)channel_find(id), (uint32_t)rate};
+    configure_rates(&r, 1);
 }
 
 /* ---------- Command Line ---------- */
 
 static void open_help_terminal(void)
 {
-    char cmd[4096];
-    snprintf(cmd, sizeof(cmd),
-             "cat << 'EOF'\n%s\nEOF\n"
-             "echo\n"
-             "read -p 'Press Enter to close...'\n",
-             HELP_TEXT);
+    char *cmd = g_strdup_printf("cat << 'EOF'\n%s\nEOF\n"
+                                "echo\n"
+                                "read -p 'Press Enter to close...'\n",
+                                help_text());
 
     char *argv[] = {
         "x-terminal-emulator",
@@ -599,920 +1172,2843 @@ static void open_help_terminal(void)
     g_spawn_async(NULL, argv, NULL,
                   G_SPAWN_SEARCH_PATH,
                   NULL, NULL, NULL, NULL);
+    g_free(cmd);
 }
 
-static void cmd_enter(GtkEntry *e, gpointer d)
+/* WINDOW <seconds> | WINDOW AUTO */
+static CmdError cmd_window(const char *arg)
 {
-    char buf[128];
-    strncpy(buf, gtk_entry_get_text(e), sizeof(buf) - 1);
-    buf[sizeof(buf) - 1] = 0;
+    if (g_ascii_strcasecmp(arg, "AUTO") == 0)
+    {
+        window_locked = FALSE;
 
-    char *raw = g_strdup(gtk_entry_get_text(e));
-    g_strstrip(raw);
+        for (int i = 0; i < ui_channels; i++)
+            set_sensor_window(i, sensor_hz[i]);
 
-    if (g_ascii_strcasecmp(raw, "HELP") == 0)
+        set_auto_window(sensor_hz[adc_zero_sid]);
+    }
+    else
     {
-        open_help_terminal();
-
-        /* ---- ADD THIS BLOCK ---- */
-        if (cmd_hist_count < CMD_HISTORY_SIZE)
-        {
-            cmd_history[cmd_hist_count++] = g_strdup("HELP");
-        }
-        else
-        {
-            g_free(cmd_history[0]);
-            memmove(&cmd_history[0], &cmd_history[1],
-                    (CMD_HISTORY_SIZE - 1) * sizeof(char *));
-            cmd_history[CMD_HISTORY_SIZE - 1] = g_strdup("HELP");
-        }
-        cmd_hist_index = cmd_hist_count;
+        char *end = NULL;
+        double sec = g_ascii_strtod(arg, &end);
 
-        gtk_entry_set_icon_from_icon_name(
-            GTK_ENTRY(e),
-            GTK_ENTRY_ICON_PRIMARY,
-            "help-browser-symbolic");
+        if (!end || *end || end == arg)
+            return CMD_ERR_SYNTAX;
 
-        gtk_label_set_text(GTK_LABEL(cmd_status),
-                           "Help opened in terminal");
+        uint64_t us = (uint64_t)(sec * 1e6);
+        if (sec <= 0.0 || us < MIN_WINDOW_US || us > MAX_MANUAL_WINDOW_US)
+            return CMD_ERR_WINDOW_RANGE;
 
-        gtk_widget_set_sensitive(GTK_WIDGET(e), FALSE);
+        window_locked = TRUE;
+        time_window_us = us;
 
-        g_free(raw);
+        printf("[GUI] Time window locked to %.2f s\n", sec);
+    }
 
-        CmdClearCtx *ctx = g_malloc(sizeof(CmdClearCtx));
-        ctx->entry = GTK_WIDGET(e);
-        ctx->label = cmd_status;
-        g_timeout_add(3000, clear_cmd_feedback, ctx);
+    gtk_widget_queue_draw(graph_area);
+    return CMD_OK;
+}
 
-        return;
+/* RECORD <file> | RECORD STOP */
+static CmdError cmd_record(const char *arg)
+{
+    if (g_ascii_strcasecmp(arg, "STOP") == 0)
+    {
+        if (!recorder_active())
+            return CMD_ERR_STATE;
+        recorder_stop();
+        return CMD_OK;
     }
 
-    g_free(raw);
-
-    char *tok1 = strtok(buf, " ");
-    char *tok2 = strtok(NULL, " ");
-    char *tok3 = strtok(NULL, " ");
-    char *extra = strtok(NULL, " ");
+    if (state != STATE_RUNNING || recorder_active())
+        return CMD_ERR_STATE;
 
-    gboolean valid = FALSE;
-    CmdError err = CMD_ERR_SYNTAX;
-    const char *id = NULL;
+    return recorder_start(arg) ? CMD_OK : CMD_ERR_FILE;
+}
 
-    if (!tok1 || !tok2 || !tok3 || extra ||
-        g_ascii_strcasecmp(tok1, "CONFIGURE") != 0)
-    {
-        err = CMD_ERR_SYNTAX;
-        goto done;
-    }
+/* REPLAY SPEED <x> | REPLAY STOP */
+static CmdError cmd_replay(const char *arg, const char *val)
+{
+    if (!replay)
+        return CMD_ERR_STATE;
 
-    id = canonical_sensor(tok2);
-    if (!id)
+    if (g_ascii_strcasecmp(arg, "STOP") == 0 && !val)
     {
-        err = CMD_ERR_SENSOR;
-        goto done;
+        stop_replay();
+        return CMD_OK;
     }
 
-    /* numeric check */
-    for (int i = 0; tok3[i]; i++)
-    {
-        if (!isdigit((unsigned char)tok3[i]))
-        {
-            err = CMD_ERR_FREQ_RANGE;
-            goto done;
-        }
-    }
+    if (g_ascii_strcasecmp(arg, "SPEED") != 0 || !val)
+        return CMD_ERR_SYNTAX;
 
-    int rate = atoi(tok3);
-    if (rate < 10 || rate > 1000)
-    {
-        err = CMD_ERR_FREQ_RANGE;
-        goto done;
-    }
+    char *end = NULL;
+    double speed = g_ascii_strtod(val, &end);
 
-    /* ---- SUCCESS ---- */
-    valid = TRUE;
-    err = CMD_OK;
+    if (!end || *end || end == val ||
+        speed < MIN_REPLAY_SPEED || speed > MAX_REPLAY_SPEED)
+        return CMD_ERR_SYNTAX;
 
-    // if (!tok1 || !tok2 || !tok3 || extra ||
-    // g_ascii_strcasecmp(tok1, "CONFIGURE") != 0)
-    // {
-    //     /* validate numeric rate */
-    //     for (int i = 0; tok3[i]; i++)
-    //     {
-    //         if (!isdigit((unsigned char)tok3[i]))
-    //             goto done;
-    //     }
+    replay_set_speed(replay, speed);
+    printf("[GUI] Replay speed %.1fx\n", speed);
+    return CMD_OK;
+}
 
-    //     int rate = atoi(tok3);
-    //     if (rate >= 10 && rate <= 1000)
-    //     {
-    //         valid = TRUE;
+typedef struct
+{
+    gboolean ok;
+    char text[256];
+} ExportDoneMsg;
 
-    /* update local model */
-    g_hash_table_replace(sensor_freq,
-                         g_strdup(id),
-                         g_strdup(tok3));
+static gboolean handle_export_done(gpointer data)
+{
+    ExportDoneMsg *msg = data;
 
-    /* update Hz entry if same sensor selected */
-    const char *active =
-        gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo));
-    if (active && strcmp(active, id) == 0)
-        gtk_entry_set_text(GTK_ENTRY(hz_entry), tok3);
+    set_connect_status(msg->text, msg->ok ? "green" : "red");
+    msg_free(msg);
+    return G_SOURCE_REMOVE;
+}
 
-    /* send to server */
-    if (sock_fd >= 0)
-    {
-        char net_cmd[64];
-        snprintf(net_cmd, sizeof(net_cmd),
-                 "CONFIGURE %s %d\n", id, rate);
-        send(sock_fd, net_cmd, strlen(net_cmd), 0);
-        printf("Sent: %s", net_cmd);
-    }
-    //     }
-    // }
+/* Export worker thread */
+static void export_done_cb(const ExportJob *job, long rows, gboolean ok,
+                           void *user)
+{
+    (void)user;
 
-done:;
-    GtkStyleContext *ec = gtk_widget_get_style_context(GTK_WIDGET(e));
-    GtkStyleContext *lc = gtk_widget_get_style_context(cmd_status);
+    ExportDoneMsg *msg = msg_alloc(sizeof(ExportDoneMsg));
 
-    gtk_style_context_remove_class(ec, "cmd-success");
-    gtk_style_context_remove_class(ec, "cmd-error");
-    gtk_style_context_remove_class(lc, "text-green");
-    gtk_style_context_remove_class(lc, "text-red");
+    msg->ok = ok;
+    if (ok)
+        snprintf(msg->text, sizeof(msg->text), "Exported %ld rows to %s",
+                 rows, job->out_path);
+    else
+        snprintf(msg->text, sizeof(msg->text), "Export to %s failed",
+                 job->out_path);
+    msg_post(msg, handle_export_done);
+}
 
-    if (valid)
-    {
-        gtk_style_context_add_class(ec, "cmd-success");
-        gtk_style_context_add_class(lc, "text-green");
-        gtk_label_set_text(GTK_LABEL(cmd_status), "Command executed");
+/* EXPORT <file> [RECORDING] */
+static CmdError cmd_export(const char *path, const char *what)
+{
+    ExportJob job = {0};
 
-        /* Success icon */
-        gtk_entry_set_icon_from_icon_name(
-            GTK_ENTRY(e),
-            GTK_ENTRY_ICON_PRIMARY,
-            "emblem-ok-symbolic");
+    if (export_busy())
+        return CMD_ERR_BUSY;
 
-        gtk_widget_set_sensitive(GTK_WIDGET(e), FALSE);
+    if (what)
+    {
+        if (g_ascii_strcasecmp(what, "RECORDING") != 0)
+            return CMD_ERR_SYNTAX;
+        if (!replay || !opt_replay)
+            return CMD_ERR_STATE;
 
-        if (cmd_hist_count < CMD_HISTORY_SIZE)
-        {
-            cmd_history[cmd_hist_count++] = g_strdup(gtk_entry_get_text(e));
-        }
-        else
-        {
-            g_free(cmd_history[0]);
-            memmove(&cmd_history[0], &cmd_history[1],
-                    (CMD_HISTORY_SIZE - 1) * sizeof(char *));
-            cmd_history[CMD_HISTORY_SIZE - 1] =
-                g_strdup(gtk_entry_get_text(e));
-        }
-        cmd_hist_index = cmd_hist_count;
+        job.source = EXPORT_RECORDING;
+        g_strlcpy(job.rec_path, opt_replay, sizeof(job.rec_path));
     }
     else
-    {
-        gtk_style_context_add_class(ec, "cmd-error");
-        gtk_style_context_add_class(lc, "text-red");
-        switch (err)
-        {
-        case CMD_ERR_FREQ_RANGE:
-            gtk_label_set_text(GTK_LABEL(cmd_status),
-                               "Command execution failed. Valid frequency is between 10 and 1000 Hz. Use help command for info.");
-            break;
+        job.source = EXPORT_HISTORY;
 
-        default:
-            gtk_label_set_text(GTK_LABEL(cmd_status),
-                               "Command execution failed. Use help command for info");
-            break;
-        }
+    g_strlcpy(job.out_path, path, sizeof(job.out_path));
 
-        /* Error icon */
-        gtk_entry_set_icon_from_icon_name(
-            GTK_ENTRY(e),
-            GTK_ENTRY_ICON_PRIMARY,
-            "dialog-error-symbolic");
-        gtk_widget_set_sensitive(GTK_WIDGET(e), FALSE);
-    }
+    job.sensor_mask = selected_mask;
 
-    CmdClearCtx *ctx = g_malloc(sizeof(CmdClearCtx));
-    ctx->entry = GTK_WIDGET(e);
-    ctx->label = cmd_status;
+    if (!export_start(&job, export_done_cb, NULL))
+        return CMD_ERR_BUSY;
 
-    g_timeout_add(5000, clear_cmd_feedback, ctx);
+    set_connect_status("Exporting...", "orange");
+    return CMD_OK;
 }
 
-/* ---------- State Machine ---------- */
+/* SEEK <seconds from the start of the recording> */
+static CmdError cmd_seek(const char *arg)
+{
+    if (!replay)
+        return CMD_ERR_STATE;
 
-/* ---------- Buttons ---------- */
-static gboolean clear_connect_status(gpointer data)
+    char *end = NULL;
+    double sec = g_ascii_strtod(arg, &end);
+
+    if (!end || *end || end == arg || sec < 0.0)
+        return CMD_ERR_SYNTAX;
+
+    /* Feed one window ahead of the target so the plot starts full */
+    replay_seek(replay, (int64_t)(sec * 1e6), (int64_t)widest_window());
+    set_connect_status("", "black");
+    printf("[GUI] Replay seek to %.1f s\n", sec);
+    return CMD_OK;
+}
+
+/* Feedback shown instead of "Command executed", set by the command */
+static char cmd_reply[256];
+
+static CmdError cmd_status_report(void)
 {
-    GtkWidget *label = GTK_WIDGET(data);
-    gtk_label_set_text(GTK_LABEL(label), "");
-    connect_status_timeout_id = 0;
-    return G_SOURCE_REMOVE; // run once
+    char report[PERF_REPORT_MAX];
+
+    perf_update();
+    perf_report(report, sizeof(report));
+    printf("[GUI] Status:\n%s\n", report);
+
+    perf_summary(cmd_reply, sizeof(cmd_reply));
+    gtk_widget_set_tooltip_text(cmd_status, report);
+    return CMD_OK;
 }
 
-static void set_connect_status(const char *msg, const char *color)
+static CmdError cmd_hud(const char *arg)
 {
-    if (!msg || !*msg)
+    if (g_ascii_strcasecmp(arg, "ON") == 0)
+        opt_hud = TRUE;
+    else if (g_ascii_strcasecmp(arg, "OFF") == 0)
+        opt_hud = FALSE;
+    else
+        return CMD_ERR_SYNTAX;
+
+    gtk_widget_queue_draw(graph_area);
+    return CMD_OK;
+}
+
+/* FFT <SENSOR> [GATEWAY] | FFT OFF; gateways count from 1 */
+static CmdError cmd_fft(const char *arg, const char *gw_arg)
+{
+    if (g_ascii_strcasecmp(arg, "OFF") == 0 && !gw_arg)
     {
-        gtk_label_set_text(GTK_LABEL(connect_status_label), "");
-        return;
+        spectrum_stop();
+        gtk_widget_queue_draw(graph_area);
+        return CMD_OK;
     }
-    char markup[256];
 
-    /* Cancel previous timeout if any */
-    if (connect_status_timeout_id)
+    int c = channel_find(arg);
+    int g = 0;
+
+    if (c < 0)
+        return CMD_ERR_SENSOR;
+
+    if (gw_arg)
     {
-        g_source_remove(connect_status_timeout_id);
-        connect_status_timeout_id = 0;
+        char *end;
+        long v = strtol(gw_arg, &end, 10);
+
+        if (*end || v < 1 || v > MAX_GATEWAYS)
+            return CMD_ERR_SYNTAX;
+        g = (int)v - 1;
     }
 
-    /* Set text */
-    snprintf(markup, sizeof(markup),
-             "<span foreground=\"%s\"><b>%s</b></span>",
-             color, msg);
-    gtk_label_set_markup(GTK_LABEL(connect_status_label), markup);
+    if (!spectrum_start(g, c))
+        return CMD_ERR_STATE;
 
-    /* Arm auto-clear (only if non-empty message) */
-    if (msg && *msg)
+    snprintf(cmd_reply, sizeof(cmd_reply), "Spectrum of %s, gateway %d",
+             channel_id(c), g + 1);
+    gtk_widget_queue_draw(graph_area);
+    return CMD_OK;
+}
+
+/*
+ * OVERLOAD OFF|DROP|DECIMATE: how gateways that fall behind are handled
+ * (gateway.h). Leaving DECIMATE undoes the decimation on the next tick.
+ */
+static CmdError cmd_overload(const char *arg)
+{
+    static const char *names[] = {"OFF", "DROP", "DECIMATE"};
+
+    for (int p = OVERLOAD_OFF; p <= OVERLOAD_DECIMATE; p++)
     {
-        connect_status_timeout_id =
-            g_timeout_add(5000, clear_connect_status,
-                          connect_status_label);
+        if (g_ascii_strcasecmp(arg, names[p]) != 0)
+            continue;
+
+        atomic_store(&overload_policy, p);
+        snprintf(cmd_reply, sizeof(cmd_reply), "Overload policy: %s",
+                 names[p]);
+        return CMD_OK;
     }
+    return CMD_ERR_SYNTAX;
 }
 
-static void connect_clicked(GtkButton *b, gpointer d)
+/*
+ * Trigger poll: once the trigger fired, wait for the post-trigger part
+ * (or TRIGGER_TIMEOUT_US past it if the stream is late), then copy the
+ * capture and show it. Armed again right away unless SINGLE.
+ */
+static gboolean trigger_tick(gpointer data)
 {
-    const char *ip = gtk_entry_get_text(GTK_ENTRY(connect_entry));
-    if (!ip || !*ip)
-        return;
+    static gboolean pending = FALSE;
+    static int gw;
+    static uint64_t t_trig;
+    static int64_t t_fired;
+    int64_t now = g_get_monotonic_time();
 
-    set_connect_status("", "black");
+    (void)data;
 
-    sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock_fd < 0)
+    if (trigger_channel() < 0)
     {
-        perror("socket");
-        set_connect_status("Socket creation failed!", "red");
-        return;
+        pending = FALSE;
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (!pending && trigger_take(&gw, &t_trig))
+    {
+        pending = TRUE;
+        t_fired = now;
     }
+    if (!pending)
+        return G_SOURCE_CONTINUE;
+
+    SensorHistory *h = gateway_hist(&gateways[gw], trigger_channel());
+    uint64_t ts;
+    gboolean complete = h && history_latest_ts(h, &ts) &&
+                        ts >= t_trig + trig_post_us;
+
+    if (!complete &&
+        now - t_fired < (int64_t)trig_post_us + TRIGGER_TIMEOUT_US)
+        return G_SOURCE_CONTINUE;
+
+    pending = FALSE;
+    capture_copy(t_trig, gw, trigger_channel(), trig_pre_us, trig_post_us,
+                 selected_mask);
+    if (!trig_single)
+        trigger_arm();
+
+    printf("[GUI] Trigger on %s (%s) at %.3f s, capture %u\n",
+           channel_id(trigger_channel()), gateways[gw].ip, t_trig / 1e6,
+           capture_info()->count);
+
+    capture_shown = TRUE;
+    view_set_frozen(FALSE);
+    return G_SOURCE_CONTINUE;
+}
 
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(PORT);
+/*
+ * TRIGGER <SENSOR> RISING|FALLING <LEVEL> [SINGLE]
+ * TRIGGER WINDOW <PRE_S> <POST_S> | TRIGGER ARM | TRIGGER OFF
+ */
+static CmdError cmd_trigger(const char *a, const char *b, const char *c,
+                            const char *d)
+{
+    if (g_ascii_strcasecmp(a, "OFF") == 0 && !b)
+    {
+        trigger_off();
+        if (trig_timer)
+            g_source_remove(trig_timer);
+        trig_timer = 0;
+        capture_shown = FALSE;
+        gtk_widget_queue_draw(graph_area);
+        return CMD_OK;
+    }
 
-    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1)
+    if (g_ascii_strcasecmp(a, "ARM") == 0 && !b)
     {
-        perror("inet_pton");
-        set_connect_status("IP not found!", "red");
-        close(sock_fd);
-        sock_fd = -1;
-        return;
+        if (trigger_channel() < 0)
+            return CMD_ERR_STATE;
+        trigger_arm();
+        return CMD_OK;
     }
 
-    if (connect(sock_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    if (g_ascii_strcasecmp(a, "WINDOW") == 0)
     {
-        perror("connect");
-        set_connect_status(
-            "Connect failed, check if server is running",
-            "red");
-        close(sock_fd);
-        sock_fd = -1;
-        return;
+        char *end_pre, *end_post;
+        double pre = b ? g_ascii_strtod(b, &end_pre) : -1;
+        double post = c ? g_ascii_strtod(c, &end_post) : -1;
+
+        if (!b || !c || d || *end_pre || *end_post)
+            return CMD_ERR_SYNTAX;
+        if (pre < 0 || post <= 0 || (pre + post) * 1e6 > TRIGGER_MAX_SPAN_US)
+            return CMD_ERR_TRIGGER_RANGE;
+
+        trig_pre_us = (uint64_t)(pre * 1e6);
+        trig_post_us = (uint64_t)(post * 1e6);
+        return CMD_OK;
     }
 
-    printf("Connected to server %s\n", ip);
-    set_connect_status("Connection successful", "green");
+    int ch = channel_find(a);
+    TriggerEdge edge;
+    char *end;
 
-    net_running = 1;
-    pthread_create(&net_thread, NULL, net_rx_thread, NULL);
+    if (ch < 0)
+        return CMD_ERR_SENSOR;
+    if (!b || !c || (d && g_ascii_strcasecmp(d, "SINGLE") != 0))
+        return CMD_ERR_SYNTAX;
 
-    reset_plot_state();
+    if (g_ascii_strcasecmp(b, "RISING") == 0)
+        edge = TRIGGER_RISING;
+    else if (g_ascii_strcasecmp(b, "FALLING") == 0)
+        edge = TRIGGER_FALLING;
+    else
+        return CMD_ERR_SYNTAX;
 
-    strncpy(connected_ip, ip, sizeof(connected_ip) - 1);
-    connected_ip[sizeof(connected_ip) - 1] = '\0';
+    double level = g_ascii_strtod(c, &end);
+    if (*end)
+        return CMD_ERR_SYNTAX;
 
-    state = STATE_CONNECTED;
-    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(checkboxes[0]), TRUE);
-    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(checkboxes[2]), TRUE);
-    apply_state();
+    trig_single = (d != NULL);
+    trigger_set(ch, edge, level);
+    if (!trig_timer)
+        trig_timer = g_timeout_add(TRIGGER_POLL_MS, trigger_tick, NULL);
+
+    snprintf(cmd_reply, sizeof(cmd_reply), "Trigger armed: %s %s %g%s",
+             channel_id(ch), edge == TRIGGER_RISING ? "rising" : "falling",
+             level, trig_single ? " (single)" : "");
+    return CMD_OK;
 }
 
-static gboolean on_window_delete(GtkWidget *widget, GdkEvent *event, gpointer user_data)
+/* CONFIGURE with one or more <id> <hz> pairs, sent as one message */
+static CmdError cmd_configure(char **args, int nargs)
 {
-    /* If not connected, allow close immediately */
-    if (state == STATE_DISCONNECTED)
+    sensor_rate_t r[MAX_CHANNELS];
+    int n = 0;
+
+    if (nargs < 2 || nargs % 2 || nargs > 2 * MAX_CHANNELS)
+        return CMD_ERR_SYNTAX;
+
+    for (int i = 0; i < nargs; i += 2)
     {
-        gtk_main_quit();
-        return TRUE;
+        int c = channel_find(args[i]);
+        int rate = parse_rate(args[i + 1]);
+        int k = 0;
+
+        if (c < 0)
+            return CMD_ERR_SENSOR;
+        if (rate < 0)
+            return CMD_ERR_FREQ_RANGE;
+
+        /* A repeated sensor takes the last rate */
+        while (k < n && r[k].sensor_id != (uint32_t)c)
+            k++;
+        r[k].sensor_id = c;
+        r[k].rate_hz = rate;
+        if (k == n)
+            n++;
     }
 
-    /* Build message */
-    char msg[256];
-    snprintf(msg, sizeof(msg),
-             "Client connected to IP %s.\n\nAre you sure you want to close?",
-             connected_ip[0] ? connected_ip : "unknown");
+    if (configure_rates(r, n) == 0)
+        snprintf(cmd_reply, sizeof(cmd_reply), "Rates unchanged");
+    return CMD_OK;
+}
 
-    GtkWidget *dialog = gtk_message_dialog_new(
-        GTK_WINDOW(widget),
-        GTK_DIALOG_MODAL,
-        GTK_MESSAGE_WARNING,
-        GTK_BUTTONS_YES_NO,
-        "%s",
-        msg);
+/* ---------- Rate profiles ----------
+ *
+ * Named sets of sensor rates, from --profile NAME=ID:HZ,... or PROFILE
+ * SAVE. Ids are kept as text since a profile may name channels that no
+ * gateway has advertised yet; they are looked up when it is applied.
+ */
+#define MAX_PROFILES 16
+#define PROFILE_NAME_LEN 32
 
-    gtk_window_set_title(GTK_WINDOW(dialog), "Confirm Exit");
+typedef struct
+{
+    char name[PROFILE_NAME_LEN];
+    int count;
+    char id[MAX_CHANNELS][CHANNEL_ID_LEN];
+    unsigned rate_hz[MAX_CHANNELS];
+} RateProfile;
 
-    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
-    gtk_widget_destroy(dialog);
+static RateProfile profiles[MAX_PROFILES];
+static int profile_count = 0;
 
-    if (response != GTK_RESPONSE_YES)
-    {
-        /* User cancelled close */
-        return TRUE;
-    }
+/* The profile called name, a new empty one if there is none; NULL if full */
+static RateProfile *profile_slot(const char *name, gboolean create)
+{
+    for (int i = 0; i < profile_count; i++)
+        if (g_ascii_strcasecmp(profiles[i].name, name) == 0)
+            return &profiles[i];
+
+    if (!create || profile_count == MAX_PROFILES)
+        return NULL;
+
+    RateProfile *p = &profiles[profile_count++];
+    memset(p, 0, sizeof(*p));
+    g_strlcpy(p->name, name, sizeof(p->name));
+    return p;
+}
+
+/* NAME=ID:HZ,ID:HZ,... */
+static gboolean profile_parse(const char *spec)
+{
+    char buf[1024];
+    char *save = NULL;
+
+    g_strlcpy(buf, spec, sizeof(buf));
+
+    char *eq = strchr(buf, '=');
+    if (!eq || eq == buf || eq - buf >= PROFILE_NAME_LEN)
+        return FALSE;
+    *eq = 0;
+
+    RateProfile p = {0};
+    g_strlcpy(p.name, buf, sizeof(p.name));
+
+    for (char *e = strtok_r(eq + 1, ",", &save); e;
+         e = strtok_r(NULL, ",", &save))
+    {
+        char *colon = strchr(e, ':');
+        if (!colon || colon == e || colon - e >= CHANNEL_ID_LEN ||
+            p.count == MAX_CHANNELS)
+            return FALSE;
+        *colon = 0;
+
+        int rate = parse_rate(colon + 1);
+        if (rate < 0)
+            return FALSE;
+
+        g_strlcpy(p.id[p.count], e, CHANNEL_ID_LEN);
+        p.rate_hz[p.count++] = rate;
+    }
+
+    RateProfile *slot = profile_slot(p.name, TRUE);
+    if (!p.count || !slot)
+        return FALSE;
+
+    *slot = p;
+    return TRUE;
+}
+
+/* PROFILE <NAME> | PROFILE SAVE <NAME> | PROFILE LIST */
+static CmdError cmd_profile(const char *arg, const char *name)
+{
+    if (g_ascii_strcasecmp(arg, "LIST") == 0 && !name)
+    {
+        int n = snprintf(cmd_reply, sizeof(cmd_reply), "Profiles:");
+
+        for (int i = 0; i < profile_count && n < (int)sizeof(cmd_reply); i++)
+            n += snprintf(cmd_reply + n, sizeof(cmd_reply) - n, " %s",
+                          profiles[i].name);
+        if (profile_count == 0)
+            snprintf(cmd_reply, sizeof(cmd_reply), "No profiles");
+        return CMD_OK;
+    }
+
+    if (g_ascii_strcasecmp(arg, "SAVE") == 0 && name)
+    {
+        if (strlen(name) >= PROFILE_NAME_LEN)
+            return CMD_ERR_SYNTAX;
+
+        RateProfile p = {0};
+        g_strlcpy(p.name, name, sizeof(p.name));
+
+        /* Every sensor whose rate we know */
+        for (int c = 0; c < ui_channels; c++)
+        {
+            if (sensor_hz[c] < MIN_RATE_HZ || sensor_hz[c] > MAX_RATE_HZ)
+                continue;
+            g_strlcpy(p.id[p.count], channel_id(c), CHANNEL_ID_LEN);
+            p.rate_hz[p.count++] = sensor_hz[c];
+        }
+
+        RateProfile *slot = profile_slot(name, TRUE);
+        if (!p.count || !slot)
+            return CMD_ERR_STATE;
+
+        *slot = p;
+        snprintf(cmd_reply, sizeof(cmd_reply), "Profile %s saved (%d sensors)",
+                 p.name, p.count);
+        return CMD_OK;
+    }
+
+    if (name)
+        return CMD_ERR_SYNTAX;
+
+    RateProfile *p = profile_slot(arg, FALSE);
+    if (!p)
+        return CMD_ERR_PROFILE;
+    if (state != STATE_RUNNING)
+        return CMD_ERR_STATE;
+
+    sensor_rate_t r[MAX_CHANNELS];
+    int n = 0;
+
+    for (int i = 0; i < p->count; i++)
+    {
+        int c = channel_find(p->id[i]);
+
+        if (c < 0)
+            continue; /* not advertised by any gateway */
+        r[n].sensor_id = c;
+        r[n].rate_hz = p->rate_hz[i];
+        n++;
+    }
+
+    if (n == 0)
+        return CMD_ERR_SENSOR;
+
+    int changed = configure_rates(r, n);
+    snprintf(cmd_reply, sizeof(cmd_reply), "Profile %s: %d rate(s) changed",
+             p->name, changed);
+    return CMD_OK;
+}
+
+static void cmd_enter(GtkEntry *e, gpointer d)
+{
+    char buf[CMD_LINE_MAX];
+    char raw[CMD_LINE_MAX];
+
+    g_strlcpy(buf, gtk_entry_get_text(e), sizeof(buf));
+    g_strlcpy(raw, buf, sizeof(raw));
+    g_strstrip(raw);
+
+    if (g_ascii_strcasecmp(raw, "HELP") == 0)
+    {
+        open_help_terminal();
+        cmd_history_add("HELP");
+
+        gtk_entry_set_icon_from_icon_name(
+            GTK_ENTRY(e),
+            GTK_ENTRY_ICON_PRIMARY,
+            "help-browser-symbolic");
+
+        gtk_label_set_text(GTK_LABEL(cmd_status),
+                           "Help opened in terminal");
+
+        gtk_widget_set_sensitive(GTK_WIDGET(e), FALSE);
+
+        cmd_clear_ctx.entry = GTK_WIDGET(e);
+        cmd_clear_ctx.label = cmd_status;
+        g_timeout_add(3000, clear_cmd_feedback, &cmd_clear_ctx);
+
+        return;
+    }
+
+    char *tok1 = strtok(buf, " ");
+    char *tok2 = strtok(NULL, " ");
+    char *tok3 = strtok(NULL, " ");
+    char *extra = strtok(NULL, " ");
+
+    gboolean valid = FALSE;
+    CmdError err = CMD_ERR_SYNTAX;
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "WINDOW") == 0)
+    {
+        err = (tok2 && !tok3) ? cmd_window(tok2) : CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "RECORD") == 0)
+    {
+        err = (tok2 && !tok3) ? cmd_record(tok2) : CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "REPLAY") == 0)
+    {
+        err = (tok2 && !extra) ? cmd_replay(tok2, tok3) : CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "EXPORT") == 0)
+    {
+        err = (tok2 && !extra) ? cmd_export(tok2, tok3) : CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "STATUS") == 0)
+    {
+        if (!tok2)
+            err = cmd_status_report();
+        else if (!tok3 && g_ascii_strcasecmp(tok2, "RESET") == 0)
+        {
+            latency_clear();
+            err = CMD_OK;
+        }
+        else
+            err = CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "HUD") == 0)
+    {
+        err = (tok2 && !tok3) ? cmd_hud(tok2) : CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "TRIGGER") == 0)
+    {
+        char *tok5 = extra ? strtok(NULL, " ") : NULL;
+
+        err = (tok2 && !(tok5 && strtok(NULL, " ")))
+                  ? cmd_trigger(tok2, tok3, extra, tok5)
+                  : CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "OVERLOAD") == 0)
+    {
+        err = (tok2 && !tok3) ? cmd_overload(tok2) : CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "FFT") == 0)
+    {
+        err = (tok2 && !extra) ? cmd_fft(tok2, tok3) : CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "SEEK") == 0)
+    {
+        err = (tok2 && !tok3) ? cmd_seek(tok2) : CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    if (tok1 && g_ascii_strcasecmp(tok1, "PROFILE") == 0)
+    {
+        err = (tok2 && !extra) ? cmd_profile(tok2, tok3) : CMD_ERR_SYNTAX;
+        valid = (err == CMD_OK);
+        goto done;
+    }
+
+    /* Configuration goes to the gateways, there are none while replaying */
+    if (state != STATE_RUNNING)
+    {
+        err = CMD_ERR_STATE;
+        goto done;
+    }
+
+    if (!tok1 || g_ascii_strcasecmp(tok1, "CONFIGURE") != 0)
+    {
+        err = CMD_ERR_SYNTAX;
+        goto done;
+    }
+
+    /* CONFIGURE <id> <hz> [<id> <hz> ...] */
+    char *args[2 * MAX_CHANNELS + 1] = {tok2, tok3, extra};
+    int nargs = tok2 ? (tok3 ? (extra ? 3 : 2) : 1) : 0;
+
+    if (nargs == 3)
+        while (nargs < (int)G_N_ELEMENTS(args) &&
+               (args[nargs] = strtok(NULL, " ")))
+            nargs++;
+
+    err = cmd_configure(args, nargs);
+    valid = (err == CMD_OK);
+
+done:;
+    GtkStyleContext *ec = gtk_widget_get_style_context(GTK_WIDGET(e));
+    GtkStyleContext *lc = gtk_widget_get_style_context(cmd_status);
+
+    gtk_style_context_remove_class(ec, "cmd-success");
+    gtk_style_context_remove_class(ec, "cmd-error");
+    gtk_style_context_remove_class(lc, "text-green");
+    gtk_style_context_remove_class(lc, "text-red");
+
+    if (valid)
+    {
+        gtk_style_context_add_class(ec, "cmd-success");
+        gtk_style_context_add_class(lc, "text-green");
+        gtk_label_set_text(GTK_LABEL(cmd_status),
+                           cmd_reply[0] ? cmd_reply : "Command executed");
+        cmd_reply[0] = 0;
+
+        /* Success icon */
+        gtk_entry_set_icon_from_icon_name(
+            GTK_ENTRY(e),
+            GTK_ENTRY_ICON_PRIMARY,
+            "emblem-ok-symbolic");
+
+        gtk_widget_set_sensitive(GTK_WIDGET(e), FALSE);
+
+        cmd_history_add(gtk_entry_get_text(e));
+    }
+    else
+    {
+        gtk_style_context_add_class(ec, "cmd-error");
+        gtk_style_context_add_class(lc, "text-red");
+        switch (err)
+        {
+        case CMD_ERR_FREQ_RANGE:
+            gtk_label_set_text(GTK_LABEL(cmd_status),
+                               "Command execution failed. Valid frequency is between 10 and 1000 Hz. Use help command for info.");
+            break;
+
+        case CMD_ERR_WINDOW_RANGE:
+            gtk_label_set_text(GTK_LABEL(cmd_status),
+                               "Command execution failed. Valid window is between 0.05 s and 24 h. Use help command for info.");
+            break;
+
+        case CMD_ERR_STATE:
+            gtk_label_set_text(GTK_LABEL(cmd_status),
+                               "Command not available in the current state. Use help command for info.");
+            break;
+
+        case CMD_ERR_FILE:
+            gtk_label_set_text(GTK_LABEL(cmd_status),
+                               "Command execution failed. Cannot open file.");
+            break;
+
+        case CMD_ERR_BUSY:
+            gtk_label_set_text(GTK_LABEL(cmd_status),
+                               "Command execution failed. An export is already running.");
+            break;
+
+        case CMD_ERR_PROFILE:
+            gtk_label_set_text(GTK_LABEL(cmd_status),
+                               "Command execution failed. No such profile, see PROFILE LIST.");
+            break;
+
+        case CMD_ERR_TRIGGER_RANGE:
+            gtk_label_set_text(GTK_LABEL(cmd_status),
+                               "Command execution failed. The trigger window is at most 60 s in total.");
+            break;
+
+        default:
+            gtk_label_set_text(GTK_LABEL(cmd_status),
+                               "Command execution failed. Use help command for info");
+            break;
+        }
+
+        /* Error icon */
+        gtk_entry_set_icon_from_icon_name(
+            GTK_ENTRY(e),
+            GTK_ENTRY_ICON_PRIMARY,
+            "dialog-error-symbolic");
+        gtk_widget_set_sensitive(GTK_WIDGET(e), FALSE);
+    }
+
+    cmd_clear_ctx.entry = GTK_WIDGET(e);
+    cmd_clear_ctx.label = cmd_status;
+    g_timeout_add(5000, clear_cmd_feedback, &cmd_clear_ctx);
+}
+
+/* ---------- State Machine ---------- */
+
+/* ---------- Buttons ---------- */
+static gboolean clear_connect_status(gpointer data)
+{
+    GtkWidget *label = GTK_WIDGET(data);
+    gtk_label_set_text(GTK_LABEL(label), "");
+    connect_status_timeout_id = 0;
+    return G_SOURCE_REMOVE; // run once
+}
+
+static void set_connect_status(const char *msg, const char *color)
+{
+    if (!msg || !*msg)
+    {
+        gtk_label_set_text(GTK_LABEL(connect_status_label), "");
+        return;
+    }
+    char markup[256];
+
+    /* Cancel previous timeout if any */
+    if (connect_status_timeout_id)
+    {
+        g_source_remove(connect_status_timeout_id);
+        connect_status_timeout_id = 0;
+    }
+
+    /* Set text */
+    snprintf(markup, sizeof(markup),
+             "<span foreground=\"%s\"><b>%s</b></span>",
+             color, msg);
+    gtk_label_set_markup(GTK_LABEL(connect_status_label), markup);
+
+    /* Arm auto-clear (only if non-empty message) */
+    if (msg && *msg)
+    {
+        connect_status_timeout_id =
+            g_timeout_add(5000, clear_connect_status,
+                          connect_status_label);
+    }
+}
+
+static void connect_clicked(GtkButton *b, gpointer d)
+{
+    const char *text = gtk_entry_get_text(GTK_ENTRY(connect_entry));
+    char ips[MAX_GATEWAYS][64];
+
+    if (state != STATE_DISCONNECTED)
+        return;
+
+    int n = parse_ipv4_list(text, ips, MAX_GATEWAYS);
+    if (n <= 0)
+        return;
+
+    set_connect_status("", "black");
+
+    gateway_count = n;
+    last_connect_err = 0;
+
+    /* Non-blocking: results arrive later through handle_net_event() */
+    int opened = 0;
+    for (int g = 0; g < n; g++)
+    {
+        Gateway *gw = &gateways[g];
+
+        strncpy(gw->ip, ips[g], sizeof(gw->ip) - 1);
+        gw->ip[sizeof(gw->ip) - 1] = '\0';
+        gw->connected = FALSE;
+        gw->last_ts = 0;
+        gw->wire = WIRE_LEGACY;
+        gateway_default_channels(gw);
+        memset(gw->rate_hz, 0, sizeof(gw->rate_hz));
+        gw->gen = ++next_gen;
+
+        gateway_init_history(gw, opt_raw_samples, opt_tier_buckets);
+        gateway_reset(gw);
+        clock_reset(&gw->clock);
+
+        gw->conn = net_open(gw->ip, PORT, opt_connect_timeout_ms,
+                            &net_handlers, gw);
+        if (!gw->conn)
+        {
+            printf("Cannot open connection to %s\n", gw->ip);
+            continue;
+        }
+
+        net_set_reconnect(gw->conn, !opt_no_reconnect);
+        printf("Connecting to server %s\n", gw->ip);
+        opened++;
+    }
+
+    if (opened == 0)
+    {
+        set_connect_status("IP not found!", "red");
+        return;
+    }
+
+    set_connect_status("Connecting...", "orange");
+
+    state = STATE_CONNECTING;
+    apply_state();
+}
+
+/* Re-evaluate the app state once every pending connect has resolved */
+static void gateway_state_changed(void)
+{
+    int live = 0, pending = 0;
+
+    for (int g = 0; g < gateway_count; g++)
+    {
+        if (!gateways[g].conn)
+            continue;
+        if (gateways[g].connected)
+            live++;
+        else
+            pending++;
+    }
+
+    if (state != STATE_CONNECTING || pending > 0)
+        return;
+
+    if (live == 0)
+    {
+        if (last_connect_err == ETIMEDOUT)
+            set_connect_status("Connect timed out, check the gateway IP", "red");
+        else
+            set_connect_status(
+                "Connect failed, check if server is running",
+                "red");
+
+        state = STATE_DISCONNECTED;
+        apply_state();
+        return;
+    }
+
+    if (live == gateway_count)
+        set_connect_status("Connection successful", "green");
+    else
+    {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Connected to %d of %d gateways",
+                 live, gateway_count);
+        set_connect_status(msg, "orange");
+    }
+
+    reset_plot_state();
+
+    if (opt_record && !recorder_active())
+        recorder_start(opt_record);
+
+    state = STATE_CONNECTED;
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(checkboxes[0]), TRUE);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(checkboxes[2]), TRUE);
+    apply_state();
+}
+
+/* I/O thread events, delivered on the GTK main loop */
+static gboolean handle_net_event(gpointer data)
+{
+    NetEventMsg *msg = data;
+    Gateway *gw = msg->gw;
+
+    /* Ignore events from a connection that has since been closed */
+    if (gw->conn && msg->gen == gw->gen)
+    {
+        switch (msg->ev)
+        {
+        case NET_EV_CONNECTED:
+            printf("Connected to server %s\n", gw->ip);
+            gw->connected = TRUE;
+            gateway_overload_reset(gw);
+
+            /* Gateways that don't know FORMAT keep sending legacy batches */
+            if (!opt_legacy_wire)
+                net_send(gw->conn, "FORMAT PACKED\n");
+
+            /* MULTICAST follows once FORMAT PACKED is acknowledged,
+             * see handle_frame() */
+
+            if (gw->reconnecting)
+            {
+                resume_gateway(gw);
+                break;
+            }
+            gateway_state_changed();
+            update_subscriptions();
+            break;
+        case NET_EV_CONNECT_FAILED:
+            printf("connect %s: %s\n", gw->ip, strerror(msg->err));
+            last_connect_err = msg->err;
+            gateway_close(gw, FALSE);
+            gateway_state_changed();
+            break;
+        case NET_EV_CLOSED:
+            handle_connection_lost(gw);
+            break;
+        case NET_EV_RECONNECTING:
+            handle_link_reconnecting(gw, msg->err);
+            break;
+        case NET_EV_MULTICAST:
+            if (msg->err)
+                printf("[GUI] %s: cannot join multicast group (%s), "
+                       "staying on TCP\n",
+                       gw->ip, strerror(msg->err));
+            else
+                printf("[GUI] %s: receiving batches over multicast\n",
+                       gw->ip);
+            break;
+        }
+    }
+
+    msg_free(msg);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean on_window_delete(GtkWidget *widget, GdkEvent *event, gpointer user_data)
+{
+    /* If not connected, allow close immediately */
+    if (state == STATE_DISCONNECTED || state == STATE_CONNECTING ||
+        state == STATE_REPLAYING)
+    {
+        replay_close(replay);
+        replay = NULL;
+        gateway_close_all(FALSE);
+        gtk_main_quit();
+        return TRUE;
+    }
+
+    /* Build message */
+    char ip_list[MAX_GATEWAYS * 66] = {0};
+    for (int g = 0; g < gateway_count; g++)
+    {
+        if (!gateways[g].connected)
+            continue;
+        if (ip_list[0])
+            g_strlcat(ip_list, ", ", sizeof(ip_list));
+        g_strlcat(ip_list, gateways[g].ip, sizeof(ip_list));
+    }
+
+    char msg[512];
+    snprintf(msg, sizeof(msg),
+             "Client connected to IP %s.\n\nAre you sure you want to close?",
+             ip_list[0] ? ip_list : "unknown");
+
+    GtkWidget *dialog = gtk_message_dialog_new(
+        GTK_WINDOW(widget),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_WARNING,
+        GTK_BUTTONS_YES_NO,
+        "%s",
+        msg);
+
+    gtk_window_set_title(GTK_WINDOW(dialog), "Confirm Exit");
+
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+
+    if (response != GTK_RESPONSE_YES)
+    {
+        /* User cancelled close */
+        return TRUE;
+    }
+
+    /* User confirmed close */
+
+    if (state == STATE_RUNNING)
+    {
+        /* Stop streaming first */
+        gateway_send("STOP\n");
+    }
+
+    if (live_gateways() > 0)
+        printf("Client socket closed (on exit)\n");
+    gateway_close_all(TRUE);
+    reset_plot_state();
+
+    gtk_main_quit();
+
+    /* Allow GTK to close window */
+    return TRUE;
+}
+
+static void disconnect_clicked(GtkButton *b, gpointer d)
+{
+    if (live_gateways() > 0)
+        printf("Disconnected from server\n");
+
+    /* Also stops the ones still reconnecting */
+    gateway_close_all(FALSE);
+    reset_plot_state();
+
+    state = STATE_DISCONNECTED;
+    set_connect_status("", "black");
+    apply_state();
+}
+
+static void start_clicked(GtkButton *b, gpointer d)
+{
+    if (live_gateways() == 0)
+        return;
+
+    if (state == STATE_RUNNING)
+        return;
+
+    if (!gateway_send("START\n"))
+        return;
+
+    state = STATE_RUNNING;
+
+    update_dropdown();
+    apply_state();
+}
+
+static void stop_clicked(GtkButton *b, gpointer d)
+{
+    if (state != STATE_RUNNING)
+        return;
+
+    /* Gateways still reconnecting just aren't restarted */
+    gateway_send("STOP\n");
+
+    state = STATE_CONNECTED;
+    apply_state();
+}
+
+static GdkRGBA
+adjust_bg_for_legend(GdkRGBA bg)
+{
+    GdkRGBA out = bg;
+
+    /* Perceived luminance (sRGB) */
+    double lum = 0.2126 * bg.red +
+                 0.7152 * bg.green +
+                 0.0722 * bg.blue;
+
+    if (lum < 0.5)
+    {
+        /* Dark theme → lighten */
+        out.red = bg.red + (1.0 - bg.red) * 0.15;
+        out.green = bg.green + (1.0 - bg.green) * 0.15;
+        out.blue = bg.blue + (1.0 - bg.blue) * 0.15;
+    }
+    else
+    {
+        /* Light theme → darken */
+        out.red = bg.red * 0.92;
+        out.green = bg.green * 0.92;
+        out.blue = bg.blue * 0.92;
+    }
+
+    out.alpha = 1.0;
+    return out;
+}
+
+/* ---------- Plot layout ---------- */
+
+static const int grid_spacing = 70;        // bigger grid
+static const int bottom_margin = 60;       // ticks ↔ x-axis label
+static const int left_margin = 60;         // ticks ↔ y-axis line
+static const int outer_bottom_margin = 12; // space below x-axis label
+static const int outer_left_margin = 15;   // space left of y-axis label
+static const int arrow_size = 10;          // axis arrow size
+
+typedef struct
+{
+    int width, height;
+    int plot_w, plot_h;
+} PlotLayout;
+
+static void plot_layout(GtkWidget *widget, PlotLayout *l)
+{
+    GtkAllocation alloc;
+    gtk_widget_get_allocation(widget, &alloc);
+
+    l->width = alloc.width;
+    l->height = alloc.height;
+    l->plot_w = l->width - left_margin - 10;
+    l->plot_h = l->height - bottom_margin - 10;
+}
+
+static void theme_colors(GtkWidget *widget, GdkRGBA *fg, GdkRGBA *bg)
+{
+    GtkWidget *toplevel = gtk_widget_get_toplevel(widget);
+    GtkStyleContext *context =
+        gtk_widget_get_style_context(toplevel);
+
+    GtkStateFlags state = gtk_style_context_get_state(context);
+
+    gtk_style_context_get_color(context, state, fg);
+    gtk_style_context_get_background_color(context, state, bg);
+}
+
+/* ---------- Static layers ----------
+ *
+ * Grid, axes, labels and legend only change with the widget size, the
+ * theme, the checked sensors or the set of gateways. They are rendered
+ * into two cached surfaces (below and above the traces) and blitted, so
+ * a frame only strokes the data and the moving X tick labels.
+ */
+typedef struct
+{
+    int width, height;
+    uint64_t sensor_mask;
+    int legend_gateways;
+    guint gateway_names; /* hash of the legend's gateway labels */
+    uint64_t windows[MAX_CHANNELS]; /* per-sensor spans shown in the legend */
+    guint serial;
+    GdkRGBA fg, bg;
+} StaticKey;
+
+static cairo_surface_t *layer_under = NULL; /* grid, Y tick labels */
+static cairo_surface_t *layer_over = NULL;  /* legend, axes, titles */
+static StaticKey layer_key;
+
+/* Bumped on theme changes that the colors alone may not reflect (fonts) */
+static guint layer_serial = 1;
+
+static void invalidate_static_layers(void)
+{
+    layer_serial++;
+    if (graph_area)
+        gtk_widget_queue_draw(graph_area);
+}
+
+static void style_updated(GtkWidget *w, gpointer d)
+{
+    invalidate_static_layers();
+}
+
+static void draw_static_under(cairo_t *cr, const PlotLayout *l,
+                              const GdkRGBA *fg)
+{
+    int height = l->height;
+    int plot_w = l->plot_w, plot_h = l->plot_h;
+
+    /* ================== Faint Grid ================== */
+    cairo_set_source_rgba(cr, 0.7, 0.7, 0.7, 0.1);
+    cairo_set_line_width(cr, 1.0);
+
+    /* Vertical grid lines */
+    for (int x = left_margin; x <= left_margin + plot_w; x += grid_spacing)
+    {
+        cairo_move_to(cr, x + 0.5, 0);
+        cairo_line_to(cr, x + 0.5, height - bottom_margin);
+    }
+
+    /* Horizontal grid lines */
+    /* Horizontal grid lines + Y labels */
+    int grid_count = plot_h / grid_spacing;
+
+    for (int i = 0; i <= grid_count; i++)
+    {
+        double y = (height - bottom_margin) - i * grid_spacing;
+
+        cairo_move_to(cr, left_margin, y + 0.5);
+        cairo_line_to(cr, left_margin + plot_w, y + 0.5);
+    }
+    cairo_stroke(cr);
+
+    cairo_set_source_rgba(cr, fg->red, fg->green, fg->blue, fg->alpha);
+
+    /* ================== Normalized Y-axis ticks (0.0 – 1.0) ================== */
+    cairo_set_font_size(cr, 11);
+
+    for (int i = 0; i <= grid_count; i++)
+    {
+        double y = (height - bottom_margin) - i * grid_spacing;
+        double value = Y_AXIS_MAX * (double)i / grid_count;
+
+        char label[16];
+        snprintf(label, sizeof(label), "%.1f", value);
+
+        cairo_text_extents_t ext;
+        cairo_text_extents(cr, label, &ext);
+
+        cairo_move_to(cr,
+                      left_margin - ext.width - 6,
+                      y + ext.height / 2);
+        cairo_show_text(cr, label);
+    }
+}
+
+static void draw_static_over(cairo_t *cr, const PlotLayout *l,
+                             const GdkRGBA *fg, const GdkRGBA *bg)
+{
+    int width = l->width, height = l->height;
+    int plot_w = l->plot_w, plot_h = l->plot_h;
+
+    GdkRGBA legend_bg = adjust_bg_for_legend(*bg);
+
+    /* ================== Dynamic Legend ================== */
+
+    /* Count active legend items */
+    int legend_items = checked_count();
+
+    /* One extra row per gateway showing its line style */
+    int legend_gateways = gateway_count > 1 ? gateway_count : 0;
+    int legend_w = legend_gateways ? 170 : 130;
+
+    /* Sensors with their own window get its span next to the name */
+    if (!window_locked)
+        legend_w = 190;
+
+    const int legend_x = left_margin + plot_w - MAX(legend_w, 170) - 20;
+
+    int legend_y = 24;
+    const int box_size = 12;
+    const int row_spacing = 20;
+
+    const int legend_padding = 10;
+
+    /* Legend height = padding + title + rows */
+    int legend_height =
+        legend_padding * 2 +
+        row_spacing * (1 + legend_items + legend_gateways); // 1 = "Legend:" title
+
+    cairo_set_font_size(cr, 12);
+
+    /* Legend title */
+    /* Clip legend to plot area */
+    cairo_save(cr);
+    cairo_rectangle(cr,
+                    left_margin,
+                    0,
+                    plot_w,
+                    plot_h);
+    cairo_clip(cr);
+
+    /* Legend background box (auto-sized) */
+    /* Legend background (theme-aware) */
+    cairo_set_source_rgba(cr,
+                          legend_bg.red,
+                          legend_bg.green,
+                          legend_bg.blue,
+                          1.0);
+
+    cairo_rectangle(cr,
+                    legend_x - legend_padding,
+                    legend_y - row_spacing + 4,
+                    legend_w,
+                    legend_height);
+    cairo_fill(cr);
+
+    cairo_set_source_rgba(cr,
+                          fg->red,
+                          fg->green,
+                          fg->blue,
+                          1.0);
+
+    cairo_move_to(cr, legend_x, legend_y);
+    cairo_show_text(cr, "Legend:");
+    legend_y += row_spacing;
+
+    for (int i = 0; i < ui_channels; i++)
+    {
+        if (!is_sensor_selected(i))
+            continue;
+
+        /* --- Color square --- */
+        const double *color = channel_color(i);
+        cairo_set_source_rgb(cr, color[0], color[1], color[2]);
+
+        cairo_rectangle(cr,
+                        legend_x,
+                        legend_y - box_size + 2,
+                        box_size,
+                        box_size);
+        cairo_fill(cr);
+
+        /* Legend text (theme foreground color) */
+        cairo_set_source_rgba(cr,
+                              fg->red,
+                              fg->green,
+                              fg->blue,
+                              fg->alpha);
+
+        cairo_move_to(cr,
+                      legend_x + box_size + 8,
+                      legend_y + 2);
+
+        if (window_locked)
+        {
+            cairo_show_text(cr, channel_label(i));
+        }
+        else
+        {
+            char label[48];
+            char span[16];
+
+            format_window(window_for(i), span, sizeof(span));
+            snprintf(label, sizeof(label), "%s (%s)", channel_label(i), span);
+            cairo_show_text(cr, label);
+        }
+
+        legend_y += row_spacing;
+    }
+
+    for (int g = 0; g < legend_gateways; g++)
+    {
+        /* --- Line style sample --- */
+        cairo_set_line_width(cr, 2.0);
+        cairo_set_dash(cr, gateway_dashes[g], gateway_dash_count[g], 0);
+        cairo_move_to(cr, legend_x, legend_y - box_size / 2 + 2);
+        cairo_line_to(cr, legend_x + 24, legend_y - box_size / 2 + 2);
+        cairo_stroke(cr);
+        cairo_set_dash(cr, NULL, 0, 0);
+
+        cairo_move_to(cr, legend_x + 32, legend_y + 2);
+        cairo_show_text(cr, gateways[g].ip);
+
+        legend_y += row_spacing;
+    }
+    cairo_restore(cr);
+
+    /* Reset color for axes (theme foreground) */
+    cairo_set_source_rgba(cr,
+                          fg->red,
+                          fg->green,
+                          fg->blue,
+                          fg->alpha);
+
+    cairo_set_line_width(cr, 2.5);
+
+    /* Y-axis */
+    cairo_move_to(cr, left_margin + 0.5, arrow_size);
+    cairo_line_to(cr, left_margin + 0.5, height - bottom_margin);
+
+    /* X-axis */
+    cairo_move_to(cr, left_margin, height - bottom_margin + 0.5);
+    cairo_line_to(cr,
+                  left_margin + plot_w,
+                  height - bottom_margin + 0.5);
+
+    cairo_stroke(cr);
+
+    /* ================== Axis Arrows ================== */
+    cairo_set_line_width(cr, 2.5);
+
+    /* X-axis arrow (right) */
+    cairo_move_to(cr, left_margin + plot_w, height - bottom_margin);
+    cairo_line_to(cr, left_margin + plot_w + arrow_size, height - bottom_margin + 0.5);
+    cairo_line_to(cr, left_margin + plot_w, height - bottom_margin + arrow_size);
+
+    cairo_stroke(cr);
+
+    /* Y-axis arrow (up) */
+    cairo_move_to(cr, left_margin - arrow_size, arrow_size);
+    cairo_line_to(cr, left_margin + 0.5, 0);
+    cairo_line_to(cr, left_margin + arrow_size, arrow_size);
+    cairo_stroke(cr);
+
+    /* ================== X-axis Ticks ================== */
+
+    int tick_count = plot_w / grid_spacing;
+    if (tick_count < 1)
+        tick_count = 1;
+
+    for (int i = 0; i <= tick_count; i++)
+    {
+        double x = left_margin + i * grid_spacing;
+
+        /* Tick mark; the label moves with time and is drawn per frame */
+        cairo_move_to(cr, x + 0.5, height - bottom_margin);
+        cairo_line_to(cr, x + 0.5, height - bottom_margin + 6);
+        cairo_stroke(cr);
+    }
+
+    /* ================== X-axis Label ================== */
+    const char *xlabel = "Time (absolute monotonic, ms)";
+
+    cairo_select_font_face(cr, "Sans",
+                           CAIRO_FONT_SLANT_NORMAL,
+                           CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(cr, 14);
+    cairo_set_source_rgba(cr,
+                          fg->red,
+                          fg->green,
+                          fg->blue,
+                          fg->alpha);
+
+    cairo_text_extents_t ext;
+    cairo_text_extents(cr, xlabel, &ext);
+
+    double x = (width - ext.width) / 2.0 - ext.x_bearing;
+    double y = height - outer_bottom_margin;
+
+    cairo_move_to(cr, x, y);
+    cairo_show_text(cr, xlabel);
+
+    /* ================== Y-axis Label ================== */
+    const char *ylabel = "Value";
+
+    cairo_save(cr);
+    cairo_translate(cr, outer_left_margin + 2, height / 2);
+
+    cairo_rotate(cr, -G_PI / 2);
+
+    cairo_set_font_size(cr, 14);
+    cairo_set_source_rgba(cr,
+                          fg->red,
+                          fg->green,
+                          fg->blue,
+                          fg->alpha);
+
+    cairo_text_extents_t yext;
+    cairo_text_extents(cr, ylabel, &yext);
+
+    cairo_move_to(cr, -yext.width / 2, 0);
+    cairo_show_text(cr, ylabel);
+
+    cairo_restore(cr);
+}
+
+static cairo_surface_t *render_layer(GtkWidget *widget, cairo_surface_t *old,
+                                     const PlotLayout *l, const GdkRGBA *fg,
+                                     const GdkRGBA *bg, gboolean over)
+{
+    if (old)
+        cairo_surface_destroy(old);
+
+    cairo_surface_t *s = gdk_window_create_similar_surface(
+        gtk_widget_get_window(widget), CAIRO_CONTENT_COLOR_ALPHA,
+        l->width, l->height);
+
+    cairo_t *lcr = cairo_create(s);
+    if (over)
+        draw_static_over(lcr, l, fg, bg);
+    else
+        draw_static_under(lcr, l, fg);
+    cairo_destroy(lcr);
+
+    return s;
+}
+
+static void update_static_layers(GtkWidget *widget, const PlotLayout *l,
+                                 const GdkRGBA *fg, const GdkRGBA *bg)
+{
+    StaticKey key;
+
+    memset(&key, 0, sizeof(key));
+    key.width = l->width;
+    key.height = l->height;
+    key.legend_gateways = gateway_count > 1 ? gateway_count : 0;
+    key.serial = layer_serial;
+    key.fg = *fg;
+    key.bg = *bg;
+
+    key.sensor_mask = selected_mask;
+    for (int i = 0; i < ui_channels && !window_locked; i++)
+        key.windows[i] = window_for(i);
+
+    for (int g = 0; g < key.legend_gateways; g++)
+        key.gateway_names = key.gateway_names * 31 + g_str_hash(gateways[g].ip);
+
+    if (layer_under && memcmp(&key, &layer_key, sizeof(key)) == 0)
+        return;
+
+    layer_under = render_layer(widget, layer_under, l, fg, bg, FALSE);
+    layer_over = render_layer(widget, layer_over, l, fg, bg, TRUE);
+    layer_key = key;
+}
+
+/* ---------- Per-frame drawing ---------- */
+
+/* What the plot shows for a channel: the capture while it is displayed */
+static SensorHistory *plot_hist(int g, int s)
+{
+    return capture_shown ? capture_hist(g, s) : gateway_hist(&gateways[g], s);
+}
+
+/* Newest sample of any gateway, or the end of the displayed capture */
+static uint64_t newest_ts(void)
+{
+    uint64_t t_max = 0;
+
+    if (capture_shown)
+        return capture_info()->t_max;
+
+    for (int g = 0; g < gateway_count; g++)
+    {
+        for (int s = 0; s < ui_channels; s++)
+        {
+            SensorHistory *h = gateway_hist(&gateways[g], s);
+            uint64_t ts;
+
+            if (h && history_latest_ts(h, &ts) && ts > t_max)
+                t_max = ts;
+        }
+    }
+
+    return t_max;
+}
+
+/* Right edge of the plot: the newest sample unless the view is frozen */
+static uint64_t visible_t_max(void)
+{
+    return view_frozen ? view_t_max : newest_ts();
+}
+
+static uint64_t window_start(uint64_t t_max, uint64_t window)
+{
+    return (t_max > window) ? (t_max - window) : 0;
+}
+
+/* The X axis follows the sensor picked in the dropdown */
+static int axis_sensor(void)
+{
+    const char *id = gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo));
+
+    int s = id ? channel_find(id) : -1;
+
+    if (s >= 0 && is_sensor_selected(s))
+        return s;
+
+    if (selected_mask)
+        return __builtin_ctzll(selected_mask);
+
+    return adc_zero_sid;
+}
+
+/* Points from trace_points(); a bit mask strokes its lanes instead */
+static void stroke_points(cairo_t *cr, int g, int s, double x0, double y0,
+                          int plot_h, const double *dec_x,
+                          const double *dec_v, int n)
+{
+    const double *color = channel_color(s);
+    const ChannelType *type = channel_type(s);
+    TraceStyle st = {
+        .color = {color[0], color[1], color[2]},
+        .y_max = channel_y_max(s),
+        .dash = gateway_dashes[g],
+        .dash_count = gateway_dash_count[g],
+        .steps = type->steps,
+    };
+
+    if (type->bits)
+        trace_stroke_bits(cr, &st, type->bits, x0, y0, plot_h);
+    else
+        trace_stroke(cr, &st, x0, y0, plot_h, dec_x, dec_v, n);
+}
+
+/* Every sensor spans the plot width with its own window, right-aligned */
+static void draw_traces(cairo_t *cr, const PlotLayout *l, uint64_t t_max)
+{
+    int plot_w = l->plot_w, plot_h = l->plot_h;
+
+    if (plot_w <= 0)
+        return;
+
+    /* Gateways are overlaid: same color per sensor, one dash style each */
+    for (int g = 0; g < gateway_count; g++)
+    {
+        /* Only the checked channels, however many are registered */
+        for (uint64_t m = selected_mask; m; m &= m - 1)
+        {
+            int s = __builtin_ctzll(m);
+            SensorHistory *h = plot_hist(g, s);
+
+            if (!h)
+                continue;
+
+            uint64_t window = window_for(s);
+            const double *dec_x, *dec_v;
+            int n = trace_points(h,
+                                 window_start(t_max, window), window,
+                                 plot_w, &dec_x, &dec_v);
+            if (n < 2)
+                continue;
+
+            stroke_points(cr, g, s, left_margin, l->height - bottom_margin,
+                          plot_h, dec_x, dec_v, n);
+        }
+    }
+}
+
+/* ---------- Scrolling trace layer ----------
+ *
+ * Instead of restroking the whole window every frame, the traces are
+ * kept in an offscreen pixmap used as a ring of pixel columns: absolute
+ * column c = t / us_per_px lives at x = c mod plot_w. A frame clears and
+ * rasterizes only the columns that got new samples and blits the ring
+ * in (at most) two pieces, so the cost follows the ingest rate rather
+ * than the window length.
+ *
+ * Each sensor has its own window and so its own column width; it gets
+ * its own ring, composited in sensor order.
+ *
+ * A column is settled once every gateway has data for the sensor past
+ * it, or SCROLL_MAX_LAG_US after the newest sample, so a gateway that
+ * lags behind still lands in columns that were already drawn.
+ */
+#define SCROLL_MAX_LAG_US 500000
+#define SCROLL_PAD 2 /* px above/below the plot for the line width */
+
+typedef struct
+{
+    int width, height;
+    uint64_t window;
+    int gateways;
+} ScrollKey;
+
+static struct
+{
+    cairo_surface_t *pix;
+    ScrollKey key;
+    gboolean valid;
+    int64_t c_settled; /* first column that may still change */
+    uint64_t t_max;
+} scroll[MAX_CHANNELS];
+
+static int64_t ring_mod(int64_t c, int w)
+{
+    int64_t m = c % w;
+    return m < 0 ? m + w : m;
+}
+
+/* Clear and redraw absolute columns [a, b), b - a <= plot_w, no seam */
+static void scroll_render_piece(cairo_t *pcr, const PlotLayout *l, int s,
+                                int64_t a, int64_t b, double us_per_px)
+{
+    int px = (int)ring_mod(a, l->plot_w);
+
+    cairo_save(pcr);
+    cairo_rectangle(pcr, px, 0, (double)(b - a), l->plot_h + 2 * SCROLL_PAD);
+    cairo_clip(pcr);
+
+    cairo_set_operator(pcr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(pcr);
+    cairo_set_operator(pcr, CAIRO_OPERATOR_OVER);
+
+    /* Start one column early so the line joins the settled part */
+    int64_t c0 = a > 0 ? a - 1 : 0;
+    uint64_t t_from = (uint64_t)(c0 * us_per_px);
+    int cols = (int)(b - c0);
+    uint64_t window = (uint64_t)(cols * us_per_px);
+
+    /* Columns before t = 0 stay empty */
+    for (int g = 0; cols > 0 && g < gateway_count; g++)
+    {
+        SensorHistory *h = gateway_hist(&gateways[g], s);
+
+        if (!h)
+            continue;
+
+        const double *dec_x, *dec_v;
+        int n = trace_points(h, t_from, window, cols, &dec_x, &dec_v);
+        if (n < 2)
+            continue;
+
+        stroke_points(pcr, g, s, px - (a - c0),
+                      l->plot_h + SCROLL_PAD, l->plot_h,
+                      dec_x, dec_v, n);
+    }
+
+    cairo_restore(pcr);
+}
+
+static void scroll_render(const PlotLayout *l, int s, int64_t from,
+                          int64_t to, double us_per_px)
+{
+    cairo_t *pcr = cairo_create(scroll[s].pix);
+
+    while (from < to)
+    {
+        /* Split at the ring seam */
+        int64_t seam = from - ring_mod(from, l->plot_w) + l->plot_w;
+        int64_t end = to < seam ? to : seam;
+
+        scroll_render_piece(pcr, l, s, from, end, us_per_px);
+        from = end;
+    }
+
+    cairo_destroy(pcr);
+}
+
+/* Oldest "newest sample" of sensor s over the gateways, capped by the lag */
+static uint64_t scroll_settled_ts(int s, uint64_t t_max)
+{
+    uint64_t t_set = t_max;
+
+    for (int g = 0; g < gateway_count; g++)
+    {
+        SensorHistory *h = gateway_hist(&gateways[g], s);
+        uint64_t ts;
+
+        if (h && history_latest_ts(h, &ts) && ts < t_set)
+            t_set = ts;
+    }
+
+    if (t_max > SCROLL_MAX_LAG_US && t_set < t_max - SCROLL_MAX_LAG_US)
+        t_set = t_max - SCROLL_MAX_LAG_US;
+    return t_set;
+}
+
+static void scroll_sensor(GtkWidget *widget, cairo_t *cr,
+                          const PlotLayout *l, int s, uint64_t t_max)
+{
+    int w = l->plot_w;
+
+    ScrollKey key;
+    memset(&key, 0, sizeof(key));
+    key.width = w;
+    key.height = l->plot_h;
+    key.window = window_for(s);
+    key.gateways = gateway_count;
+
+    if (!scroll[s].pix || key.width != scroll[s].key.width ||
+        key.height != scroll[s].key.height)
+    {
+        if (scroll[s].pix)
+            cairo_surface_destroy(scroll[s].pix);
+        scroll[s].pix = gdk_window_create_similar_surface(
+            gtk_widget_get_window(widget), CAIRO_CONTENT_COLOR_ALPHA,
+            w, l->plot_h + 2 * SCROLL_PAD);
+        scroll[s].valid = FALSE;
+    }
 
-    /* User confirmed close */
+    double us_per_px = (double)key.window / w;
+    int64_t c_now = (int64_t)(t_max / us_per_px);
+    int64_t c_first = c_now - w + 1;
 
-    if (state == STATE_RUNNING)
+    /* Anything that moves already drawn columns means a full redraw;
+     * a history reset shows up as time going backwards */
+    if (memcmp(&key, &scroll[s].key, sizeof(key)) != 0 ||
+        t_max < scroll[s].t_max)
+        scroll[s].valid = FALSE;
+
+    int64_t from = scroll[s].valid ? scroll[s].c_settled : c_first;
+    if (from < c_first)
+        from = c_first;
+
+    if (from <= c_now)
+        scroll_render(l, s, from, c_now + 1, us_per_px);
+
+    scroll[s].key = key;
+    scroll[s].valid = TRUE;
+    scroll[s].t_max = t_max;
+    scroll[s].c_settled =
+        (int64_t)(scroll_settled_ts(s, t_max) / us_per_px);
+
+    /* Blit: oldest visible column at the plot's left edge */
+    double top = l->height - bottom_margin - l->plot_h - SCROLL_PAD;
+    int first = (int)ring_mod(c_first, w);
+    int len1 = w - first;
+
+    cairo_save(cr);
+    cairo_rectangle(cr, left_margin, top, len1, l->plot_h + 2 * SCROLL_PAD);
+    cairo_clip(cr);
+    cairo_set_source_surface(cr, scroll[s].pix, left_margin - first, top);
+    cairo_paint(cr);
+    cairo_restore(cr);
+
+    if (first > 0)
     {
-        /* Stop streaming first */
-        send(sock_fd, "STOP\n", 5, 0);
-        printf("Sent STOP (on exit)\n");
+        cairo_save(cr);
+        cairo_rectangle(cr, left_margin + len1, top, first,
+                        l->plot_h + 2 * SCROLL_PAD);
+        cairo_clip(cr);
+        cairo_set_source_surface(cr, scroll[s].pix, left_margin + len1, top);
+        cairo_paint(cr);
+        cairo_restore(cr);
     }
+}
+
+static void draw_traces_scrolling(GtkWidget *widget, cairo_t *cr,
+                                  const PlotLayout *l, uint64_t t_max)
+{
+    if (l->plot_w <= 0 || l->plot_h <= 0)
+        return;
 
-    if (net_running)
+    for (int s = 0; s < ui_channels; s++)
     {
-        net_running = 0;
-        // shutdown(sock_fd, SHUT_RDWR);   // unblock recv
-        pthread_join(net_thread, NULL); // wait for thread to exit
+        /* An unchecked sensor's ring goes stale; redraw it when it's back */
+        if (!is_sensor_selected(s))
+        {
+            scroll[s].valid = FALSE;
+            continue;
+        }
+
+        scroll_sensor(widget, cr, l, s, t_max);
     }
+}
 
-    if (sock_fd >= 0)
+/* Tick times of `window` ending at t_max (the axis sensor's window) */
+static void draw_x_labels(cairo_t *cr, const PlotLayout *l,
+                          const GdkRGBA *fg, uint64_t t_max, uint64_t window)
+{
+    uint64_t t_min = window_start(t_max, window);
+    int height = l->height;
+
+    cairo_set_source_rgba(cr, fg->red, fg->green, fg->blue, fg->alpha);
+    cairo_set_font_size(cr, 11);
+
+    int tick_count = l->plot_w / grid_spacing;
+    if (tick_count < 1)
+        tick_count = 1;
+
+    for (int i = 0; i <= tick_count; i++)
     {
-        close(sock_fd);
-        sock_fd = -1;
-        printf("Client socket closed (on exit)\n");
+        double x = left_margin + i * grid_spacing;
+        uint64_t t = t_min + (window * i) / tick_count;
+
+        /* Label */
+        char label[32];
+
+        /* Absolute monotonic time in milliseconds (reduced magnitude) */
+        uint64_t abs_ms = t / 1000;
+
+        /* Drop high digits to avoid clutter (keep last 5 digits) */
+        abs_ms %= 100000;
+
+        snprintf(label, sizeof(label), "%" PRIu64, abs_ms);
+
+        cairo_text_extents_t ext;
+        cairo_text_extents(cr, label, &ext);
+
+        cairo_move_to(cr,
+                      x - ext.width / 2,
+                      height - bottom_margin + 20);
+        cairo_show_text(cr, label);
     }
-    reset_plot_state();
+}
 
-    gtk_main_quit();
+/* ---------- Freeze / zoom / pan ----------
+ *
+ * Wheel: zoom around the pointer. Drag: pan (freezes the view). Right
+ * click: back to live at the normal zoom. All sensors move together; the
+ * pointer position maps to time through the axis sensor's window.
+ */
 
-    /* Allow GTK to close window */
+static void view_set_frozen(gboolean frozen)
+{
+    if (frozen && !view_frozen)
+        view_t_max = newest_ts();
+    view_frozen = frozen;
+
+    if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(freeze_btn)) != frozen)
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(freeze_btn), frozen);
+
+    gtk_widget_queue_draw(graph_area);
+}
+
+static void freeze_toggled(GtkToggleButton *b, gpointer d)
+{
+    view_set_frozen(gtk_toggle_button_get_active(b));
+}
+
+/* Right edge at t (may be negative while panning), kept within the data */
+static void view_pan_to(double t)
+{
+    uint64_t newest = newest_ts();
+
+    if (t < 0)
+        t = 0;
+    view_t_max = t > newest ? newest : (uint64_t)t;
+}
+
+/* Pointer x as a fraction of the plot width */
+static double view_fraction(const PlotLayout *l, double x)
+{
+    double fx = (x - left_margin) / l->plot_w;
+    return fx < 0 ? 0 : fx > 1 ? 1 : fx;
+}
+
+static gboolean plot_scroll(GtkWidget *w, GdkEventScroll *e, gpointer d)
+{
+    PlotLayout l;
+    double factor;
+
+    if (e->direction == GDK_SCROLL_UP)
+        factor = 1.0 / VIEW_ZOOM_STEP;
+    else if (e->direction == GDK_SCROLL_DOWN)
+        factor = VIEW_ZOOM_STEP;
+    else
+        return FALSE;
+
+    plot_layout(w, &l);
+    if (l.plot_w <= 0)
+        return FALSE;
+
+    /* Keep the time under the pointer where it is */
+    double fx = view_fraction(&l, e->x);
+    double t_at = visible_t_max() - window_for(axis_sensor()) * (1 - fx);
+
+    view_zoom *= factor;
+    if (view_zoom < MIN_VIEW_ZOOM)
+        view_zoom = MIN_VIEW_ZOOM;
+    if (view_zoom > MAX_VIEW_ZOOM)
+        view_zoom = MAX_VIEW_ZOOM;
+
+    /* Live, the right edge stays on the newest sample */
+    if (view_frozen)
+        view_pan_to(t_at + window_for(axis_sensor()) * (1 - fx));
+
+    gtk_widget_queue_draw(graph_area);
     return TRUE;
 }
 
-static void disconnect_clicked(GtkButton *b, gpointer d)
+static gboolean plot_button(GtkWidget *w, GdkEventButton *e, gpointer d)
 {
-    if (net_running)
+    if (e->type == GDK_BUTTON_PRESS && e->button == 1)
     {
-        net_running = 0;
-        shutdown(sock_fd, SHUT_RDWR);
-        pthread_join(net_thread, NULL);
+        view_set_frozen(TRUE);
+        view_dragging = TRUE;
+        drag_x0 = e->x;
+        drag_t_max = view_t_max;
+        return TRUE;
     }
 
-    if (sock_fd >= 0)
+    if (e->type == GDK_BUTTON_RELEASE && e->button == 1)
     {
-        close(sock_fd);
-        sock_fd = -1;
-        printf("Disconnected from server\n");
+        view_dragging = FALSE;
+        return TRUE;
     }
-    reset_plot_state();
 
-    state = STATE_DISCONNECTED;
-    set_connect_status("", "black");
-    apply_state();
+    if (e->type == GDK_BUTTON_PRESS && e->button == 3)
+    {
+        capture_shown = FALSE;
+        view_zoom = 1.0;
+        view_set_frozen(FALSE);
+        return TRUE;
+    }
+    return FALSE;
 }
 
-static void start_clicked(GtkButton *b, gpointer d)
+static gboolean plot_motion(GtkWidget *w, GdkEventMotion *e, gpointer d)
 {
-    if (sock_fd < 0)
-        return;
-
-    if (state == STATE_RUNNING)
-        return;
+    cursor_x = e->x;
 
-    ssize_t n = send(sock_fd, "START\n", 6, 0);
-    if (n <= 0)
+    if (view_dragging)
     {
-        printf("Failed to send START\n");
-        return;
-    }
+        PlotLayout l;
 
-    printf("Sent START\n");
+        plot_layout(w, &l);
+        if (l.plot_w > 0)
+        {
+            double us_per_px = (double)window_for(axis_sensor()) / l.plot_w;
+            view_pan_to(drag_t_max - (e->x - drag_x0) * us_per_px);
+        }
+    }
 
-    state = STATE_RUNNING;
+    gtk_widget_queue_draw(graph_area);
+    return FALSE;
+}
 
-    update_dropdown();
-    apply_state();
+static gboolean plot_leave(GtkWidget *w, GdkEventCrossing *e, gpointer d)
+{
+    cursor_x = -1;
+    gtk_widget_queue_draw(graph_area);
+    return FALSE;
 }
 
-static int recv_all(int fd, void *buf, size_t len)
+/* ---------- Reconnect gaps ---------- */
+
+/* Shade the spans a gateway was away for and label their length */
+static void draw_gaps(cairo_t *cr, const PlotLayout *l, const GdkRGBA *fg,
+                      uint64_t t_max)
 {
-    size_t off = 0;
-    char *p = buf;
+    uint64_t window = window_for(axis_sensor());
+    uint64_t t_min = window_start(t_max, window);
+    int top = l->height - bottom_margin - l->plot_h;
+
+    if (capture_shown || l->plot_w <= 0 || window == 0)
+        return;
+
+    cairo_save(cr);
+    cairo_set_font_size(cr, 10);
 
-    while (off < len)
+    for (int g = 0; g < gateway_count; g++)
     {
-        ssize_t n = recv(fd, p + off, len - off, 0);
-        if (n <= 0)
-            return -1;
-        off += n;
+        uint64_t from[GATEWAY_GAPS], to[GATEWAY_GAPS];
+        int n = gateway_gaps(&gateways[g], from, to, GATEWAY_GAPS);
+
+        for (int i = 0; i < n; i++)
+        {
+            if (to[i] <= t_min || from[i] >= t_max)
+                continue;
+
+            uint64_t a = from[i] > t_min ? from[i] : t_min;
+            uint64_t b = to[i] < t_max ? to[i] : t_max;
+            double x0 = left_margin + (double)(a - t_min) * l->plot_w / window;
+            double x1 = left_margin + (double)(b - t_min) * l->plot_w / window;
+            char label[32];
+
+            cairo_set_source_rgba(cr, fg->red, fg->green, fg->blue, 0.12);
+            cairo_rectangle(cr, x0, top, MAX(x1 - x0, 1.0), l->plot_h);
+            cairo_fill(cr);
+
+            snprintf(label, sizeof(label), "gap %.1f s",
+                     (to[i] - from[i]) / 1e6);
+            cairo_set_source_rgba(cr, fg->red, fg->green, fg->blue, 0.7);
+            cairo_move_to(cr, x0 + 2, top + l->plot_h - 4 - 12 * g);
+            cairo_show_text(cr, label);
+        }
     }
-    return 0;
+
+    cairo_restore(cr);
 }
 
-static void stop_clicked(GtkButton *b, gpointer d)
+/* ---------- Trigger capture ---------- */
+
+/* The trigger point and what is being shown; the capture doesn't move */
+static void draw_capture(cairo_t *cr, const PlotLayout *l, const GdkRGBA *fg,
+                         uint64_t t_max)
 {
-    if (sock_fd < 0)
+    const CaptureInfo *ci = capture_info();
+    int top = l->height - bottom_margin - l->plot_h;
+    int bottom = l->height - bottom_margin;
+    char label[128];
+
+    if (!capture_shown || l->plot_w <= 0)
         return;
 
-    send(sock_fd, "STOP\n", 5, 0);
-    printf("Sent STOP\n");
+    uint64_t window = window_for(axis_sensor());
+    uint64_t t_min = window_start(t_max, window);
 
-    state = STATE_CONNECTED;
-    apply_state();
+    cairo_save(cr);
+    cairo_set_source_rgba(cr, fg->red, fg->green, fg->blue, 0.8);
+
+    if (ci->t_trigger >= t_min && ci->t_trigger <= t_max)
+    {
+        double x = left_margin +
+                   (double)(ci->t_trigger - t_min) * l->plot_w / window;
+
+        cairo_set_line_width(cr, 1.0);
+        cairo_move_to(cr, (int)x + 0.5, top);
+        cairo_line_to(cr, (int)x + 0.5, bottom);
+        cairo_stroke(cr);
+    }
+
+    cairo_set_font_size(cr, 11);
+    snprintf(label, sizeof(label),
+             "TRIGGERED %s at %.3f s, capture %u (%s; right click: live)",
+             channel_id(ci->channel), ci->t_trigger / 1e6, ci->count,
+             atomic_load(&trigger.armed) ? "armed" : "TRIGGER ARM to re-arm");
+    cairo_move_to(cr, left_margin + 8, top + 30);
+    cairo_show_text(cr, label);
+    cairo_restore(cr);
 }
 
-static GdkRGBA
-adjust_bg_for_legend(GdkRGBA bg)
+#define CURSOR_ROWS 16
+
+/*
+ * Vertical cursor line plus the value of every checked sensor under it:
+ * the newest sample at or before the pointer's time in that sensor's
+ * window, from whichever history level still has it.
+ */
+static void draw_cursor(cairo_t *cr, const PlotLayout *l, const GdkRGBA *fg,
+                        const GdkRGBA *bg, uint64_t t_max)
 {
-    GdkRGBA out = bg;
+    int top = l->height - bottom_margin - l->plot_h;
+    int bottom = l->height - bottom_margin;
 
-    /* Perceived luminance (sRGB) */
-    double lum = 0.2126 * bg.red +
-                 0.7152 * bg.green +
-                 0.0722 * bg.blue;
+    cairo_save(cr);
+    cairo_set_font_size(cr, 11);
 
-    if (lum < 0.5)
+    if (view_frozen)
     {
-        /* Dark theme → lighten */
-        out.red = bg.red + (1.0 - bg.red) * 0.15;
-        out.green = bg.green + (1.0 - bg.green) * 0.15;
-        out.blue = bg.blue + (1.0 - bg.blue) * 0.15;
+        cairo_set_source_rgba(cr, fg->red, fg->green, fg->blue, 0.8);
+        cairo_move_to(cr, left_margin + 8, top + 16);
+        cairo_show_text(cr, "FROZEN (drag: pan, wheel: zoom, right click: live)");
     }
-    else
+
+    if (cursor_x < left_margin || cursor_x > left_margin + l->plot_w ||
+        l->plot_w <= 0)
     {
-        /* Light theme → darken */
-        out.red = bg.red * 0.92;
-        out.green = bg.green * 0.92;
-        out.blue = bg.blue * 0.92;
+        cairo_restore(cr);
+        return;
     }
 
-    out.alpha = 1.0;
-    return out;
-}
-
-static gboolean draw_grid(GtkWidget *widget, cairo_t *cr, gpointer data)
-{
-    uint64_t t_max = 0;
-
-    static uint64_t visible_ts[MAX_SAMPLES];
-    static double visible_val[SENSOR_COUNT][MAX_SAMPLES];
-    static int visible_count[SENSOR_COUNT];
+    double fx = view_fraction(l, cursor_x);
+    char rows[CURSOR_ROWS][64];
+    const double *colors[CURSOR_ROWS];
+    int n = 0;
 
-    pthread_mutex_lock(&sample_lock);
+    /* Pointer time on the X axis, in the axis labels' reduced ms */
+    uint64_t w_axis = window_for(axis_sensor());
+    uint64_t t_axis = window_start(t_max, w_axis) + (uint64_t)(w_axis * fx);
+    snprintf(rows[n], sizeof(rows[n]), "t = %.3f ms",
+             (t_axis % 100000000ULL) / 1000.0);
+    colors[n++] = NULL;
 
-    for (int s = 0; s < SENSOR_COUNT; s++)
+    for (int g = 0; g < gateway_count; g++)
     {
-        if (sample_count[s] > 0)
+        for (uint64_t m = selected_mask; m && n < CURSOR_ROWS; m &= m - 1)
         {
-            int last = (sample_head[s] - 1 + MAX_SAMPLES) % MAX_SAMPLES;
-            uint64_t ts = sample_ts[s][last];
-            if (ts > t_max)
-                t_max = ts;
+            int s = __builtin_ctzll(m);
+            SensorHistory *h = plot_hist(g, s);
+            uint64_t w = window_for(s);
+            uint64_t t = window_start(t_max, w) + (uint64_t)(w * fx);
+            uint64_t ts;
+            double v;
+
+            /* Nothing in this window at or before the pointer */
+            if (!h || !history_value_at(h, t, &ts, &v) || t - ts > w)
+                continue;
+
+            if (gateway_count > 1)
+                snprintf(rows[n], sizeof(rows[n]), "%s @%s: %.6g",
+                         channel_label(s), gateways[g].ip, v);
+            else
+                snprintf(rows[n], sizeof(rows[n]), "%s: %.6g",
+                         channel_label(s), v);
+            colors[n++] = channel_color(s);
         }
     }
 
-    pthread_mutex_unlock(&sample_lock);
+    /* Cursor line */
+    cairo_set_source_rgba(cr, fg->red, fg->green, fg->blue, 0.5);
+    cairo_set_line_width(cr, 1.0);
+    cairo_set_dash(cr, (const double[]){4, 3}, 2, 0);
+    cairo_move_to(cr, (int)cursor_x + 0.5, top);
+    cairo_line_to(cr, (int)cursor_x + 0.5, bottom);
+    cairo_stroke(cr);
+    cairo_set_dash(cr, NULL, 0, 0);
+
+    /* Readout box beside the pointer, flipped left near the edge */
+    const int pad = 6, line_h = 15;
+    double box_w = 0;
 
-    uint64_t t_min =
-        (t_max > time_window_us) ? (t_max - time_window_us) : 0;
+    for (int i = 0; i < n; i++)
+    {
+        cairo_text_extents_t ext;
+        cairo_text_extents(cr, rows[i], &ext);
+        if (ext.x_advance > box_w)
+            box_w = ext.x_advance;
+    }
+    box_w += 2 * pad;
 
-    for (int s = 0; s < SENSOR_COUNT; s++)
-        visible_count[s] = 0;
+    double box_h = n * line_h + 2 * pad;
+    double x = cursor_x + 12;
+    if (x + box_w > left_margin + l->plot_w)
+        x = cursor_x - 12 - box_w;
+    double y = top + 28;
 
-    GtkAllocation alloc;
-    gtk_widget_get_allocation(widget, &alloc);
-    int plot_w, plot_h;
-    const int legend_margin = 120;
+    GdkRGBA box_bg = adjust_bg_for_legend(*bg);
+    cairo_set_source_rgba(cr, box_bg.red, box_bg.green, box_bg.blue, 0.9);
+    cairo_rectangle(cr, x, y, box_w, box_h);
+    cairo_fill(cr);
 
-    int width = alloc.width;
-    int height = alloc.height;
+    for (int i = 0; i < n; i++)
+    {
+        if (colors[i])
+            cairo_set_source_rgb(cr, colors[i][0], colors[i][1], colors[i][2]);
+        else
+            cairo_set_source_rgba(cr, fg->red, fg->green, fg->blue, fg->alpha);
 
-    const int grid_spacing = 70;        // bigger grid
-    const int bottom_margin = 60;       // ticks ↔ x-axis label
-    const int left_margin = 60;         // ticks ↔ y-axis line
-    const int outer_bottom_margin = 12; // space below x-axis label
-    const int outer_left_margin = 15;   // space left of y-axis label
-    const int arrow_size = 10;          // axis arrow size
+        cairo_move_to(cr, x + pad, y + pad + (i + 1) * line_h - 3);
+        cairo_show_text(cr, rows[i]);
+    }
 
-    plot_w = width - left_margin - 10;
-    plot_h = height - bottom_margin - 10;
+    cairo_restore(cr);
+}
 
-    if (t_max <= t_min)
-        t_max = t_min + 1;
+/* ---------- Overload policy (OVERLOAD) ---------- */
 
-    /* ================== Faint Grid ================== */
-    cairo_set_source_rgba(cr, 0.7, 0.7, 0.7, 0.1);
-    cairo_set_line_width(cr, 1.0);
+/*
+ * Once a second from perf_tick(): asks gateways that fall behind to
+ * decimate, and steps the factor back down once they have caught up
+ * (gateway_overload()).
+ */
+static void overload_tick(void)
+{
+    char cmd[16 + MAX_CHANNELS * (CHANNEL_ID_LEN + 4)];
 
-    /* Vertical grid lines */
-    for (int x = left_margin; x <= left_margin + plot_w; x += grid_spacing)
+    for (int g = 0; g < gateway_count; g++)
     {
-        cairo_move_to(cr, x + 0.5, 0);
-        cairo_line_to(cr, x + 0.5, height - bottom_margin);
-    }
+        Gateway *gw = &gateways[g];
 
-    /* Horizontal grid lines */
-    /* Horizontal grid lines + Y labels */
-    int grid_count = plot_h / grid_spacing;
+        if (!gw->conn || !gw->connected)
+            continue;
 
-    for (int i = 0; i <= grid_count; i++)
-    {
-        double y = (height - bottom_margin) - i * grid_spacing;
+        if (!gateway_overload(gw, cmd, sizeof(cmd)))
+            continue;
 
-        cairo_move_to(cr, left_margin, y + 0.5);
-        cairo_line_to(cr, left_margin + plot_w, y + 0.5);
+        if (net_send(gw->conn, cmd))
+            printf("[GUI] %s: overload, %s", gw->ip, cmd);
+        else
+            printf("Failed to queue for %s: %s", gw->ip, cmd);
     }
-    cairo_stroke(cr);
+}
 
-    /* ================== Theme-aware axis color ================== */
-    GtkWidget *toplevel = gtk_widget_get_toplevel(widget);
-    GtkStyleContext *context =
-        gtk_widget_get_style_context(toplevel);
+/* ---------- Statistics overlay (--hud, HUD ON) ---------- */
 
-    GtkStateFlags state = gtk_style_context_get_state(context);
+static gboolean perf_tick(gpointer data)
+{
+    (void)data;
+
+    perf_update();
+    overload_tick();
+    if ((opt_hud || spectrum_running()) && graph_area)
+        gtk_widget_queue_draw(graph_area);
 
-    GdkRGBA fg;
-    GdkRGBA bg;
+    /* Clock offset probe; gateways that don't know PING ignore it.
+       Queued quietly: gateway_send() would log it every second. */
+    if (state == STATE_CONNECTED || state == STATE_RUNNING)
+    {
+        char ping[32];
+        snprintf(ping, sizeof(ping), "PING %" PRId64 "\n",
+                 g_get_monotonic_time());
 
-    gtk_style_context_get_color(context, state, &fg);
-    gtk_style_context_get_background_color(context, state, &bg);
+        for (int g = 0; g < gateway_count; g++)
+            if (gateways[g].conn && gateways[g].connected)
+                net_send(gateways[g].conn, ping);
+    }
+    return G_SOURCE_CONTINUE;
+}
 
-    cairo_set_source_rgba(cr, fg.red, fg.green, fg.blue, fg.alpha);
+/*
+ * Age of the newest sample on screen. The frame is presented at the
+ * frame clock's predicted time, or right away if it has no prediction.
+ */
+static void note_screen_latency(GtkWidget *widget)
+{
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(widget);
+    GdkFrameTimings *ft = clock ? gdk_frame_clock_get_current_timings(clock)
+                                : NULL;
+    int64_t shown = ft ? gdk_frame_timings_get_predicted_presentation_time(ft)
+                       : 0;
 
-    /* ================== Normalized Y-axis ticks (0.0 – 1.0) ================== */
-    cairo_set_font_size(cr, 11);
+    if (shown == 0)
+        shown = g_get_monotonic_time();
 
-    for (int i = 0; i <= grid_count; i++)
+    /* A frozen frame doesn't show the newest samples */
+    if (view_frozen)
+        return;
+
+    for (int g = 0; g < gateway_count; g++)
     {
-        double y = (height - bottom_margin) - i * grid_spacing;
-        double value = Y_AXIS_MAX * (double)i / grid_count;
+        Gateway *gw = &gateways[g];
+        uint64_t t0 = atomic_load(&gw->server_t0);
+        uint64_t newest = 0;
+        int64_t sampled;
 
-        char label[16];
-        snprintf(label, sizeof(label), "%.1f", value);
+        if (!gw->connected || t0 == 0)
+            continue;
 
-        cairo_text_extents_t ext;
-        cairo_text_extents(cr, label, &ext);
+        for (uint64_t m = selected_mask; m; m &= m - 1)
+        {
+            SensorHistory *h = gateway_hist(gw, __builtin_ctzll(m));
+            uint64_t ts;
 
-        cairo_move_to(cr,
-                      left_margin - ext.width - 6,
-                      y + ext.height / 2);
-        cairo_show_text(cr, label);
-    }
+            if (h && history_latest_ts(h, &ts) && ts > newest)
+                newest = ts;
+        }
 
-    /* Y-axis labels */
+        if (!clock_to_local(&gw->clock, t0 + newest, &sampled))
+            continue;
 
-    cairo_stroke(cr);
+        latency_note(LAT_SCREEN, shown - sampled);
+    }
+}
 
-    GdkRGBA legend_bg = adjust_bg_for_legend(bg);
+static void draw_hud(cairo_t *cr, const PlotLayout *l)
+{
+    char text[PERF_REPORT_MAX];
 
-    cairo_set_source_rgba(cr,
-                          fg.red,
-                          fg.green,
-                          fg.blue,
-                          fg.alpha);
+    if (perf_report(text, sizeof(text)) == 0)
+        return;
+
+    const int line_h = 13;
+    const int pad = 6;
+    double x = left_margin + 8;
+    double y = l->height - bottom_margin - l->plot_h + 8;
 
-    /* ================== Axes ================== */
+    cairo_save(cr);
+    cairo_select_font_face(cr, "monospace", CAIRO_FONT_SLANT_NORMAL,
+                           CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(cr, 11);
 
-    /* ================== Legend Placeholder ================== */
+    /* Size the backdrop to the widest line */
+    int lines = 0;
+    double w = 0;
+    for (char *line = strtok(text, "\n"); line; line = strtok(NULL, "\n"))
+    {
+        cairo_text_extents_t ext;
+        cairo_text_extents(cr, line, &ext);
+        if (ext.x_advance > w)
+            w = ext.x_advance;
+        lines++;
+    }
 
-    /* ================== Signal Plot ================== */
+    cairo_set_source_rgba(cr, 0, 0, 0, 0.55);
+    cairo_rectangle(cr, x, y, w + 2 * pad, lines * line_h + 2 * pad);
+    cairo_fill(cr);
 
-    for (int s = 0; s < SENSOR_COUNT; s++)
+    /* strtok left a NUL after every line; walk them again */
+    cairo_set_source_rgba(cr, 1, 1, 1, 0.9);
+    const char *line = text;
+    for (int i = 0; i < lines; i++)
     {
-        if (!is_sensor_selected(s))
-            continue;
+        cairo_move_to(cr, x + pad, y + pad + (i + 1) * line_h - 3);
+        cairo_show_text(cr, line);
+        line += strlen(line) + 1;
+    }
 
-        if (sample_count[s] < 2)
-            continue;
+    cairo_restore(cr);
+}
 
-        int head = sample_head[s];
-        int count = sample_count[s];
-        int start = (head - count + MAX_SAMPLES) % MAX_SAMPLES;
+/* ---------- Spectrum inset (FFT command) ---------- */
 
-        visible_count[s] = 0;
+#define SPECTRUM_TOP_DB 0.0
 
-        for (int i = 0; i < count; i++)
-        {
-            int idx = (start + i) % MAX_SAMPLES;
-            uint64_t ts = sample_ts[s][idx];
+/* Top right of the plot: dB of full scale against frequency, 0..Nyquist */
+static void draw_spectrum(cairo_t *cr, const PlotLayout *l)
+{
+    const Spectrum *sp = spectrum_latest();
+    const int pad = 6;
+    char label[96];
 
-            if (ts < t_min)
-                continue;
+    if (!spectrum_running())
+        return;
 
-            visible_ts[visible_count[s]] = ts;
-            visible_val[s][visible_count[s]] = sample_data[s][idx];
-            visible_count[s]++;
-        }
+    double w = MAX(l->plot_w * 0.4, 200);
+    double h = MAX(l->plot_h * 0.35, 100);
+    double x = left_margin + l->plot_w - w - 8;
+    double y = l->height - bottom_margin - l->plot_h + 8;
 
-        if (visible_count[s] < 2)
-            continue;
+    cairo_save(cr);
+    cairo_set_source_rgba(cr, 0, 0, 0, 0.55);
+    cairo_rectangle(cr, x, y, w, h);
+    cairo_fill(cr);
 
-        cairo_set_source_rgb(cr,
-                             plot_colors[s][0],
-                             plot_colors[s][1],
-                             plot_colors[s][2]);
+    cairo_select_font_face(cr, "monospace", CAIRO_FONT_SLANT_NORMAL,
+                           CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(cr, 11);
+    cairo_set_source_rgba(cr, 1, 1, 1, 0.9);
+    cairo_move_to(cr, x + pad, y + pad + 10);
 
-        cairo_set_line_width(cr, 2.0);
+    if (!sp)
+    {
+        cairo_show_text(cr, "FFT: waiting for samples");
+        cairo_restore(cr);
+        return;
+    }
 
-        gboolean started = FALSE;
-        int n = visible_count[s];
+    snprintf(label, sizeof(label),
+             "%s FFT %d pt, %.0f Hz span, peak %.1f Hz %.0f dB",
+             channel_id(sp->channel), sp->n, sp->bin_hz * (sp->bins - 1),
+             sp->peak * sp->bin_hz, sp->db[sp->peak]);
+    cairo_show_text(cr, label);
+
+    /* Curve area below the label */
+    double cx = x + pad, cw = w - 2 * pad;
+    double cy = y + pad + 16, ch = h - 2 * pad - 16;
+    double db_span = SPECTRUM_TOP_DB - SPECTRUM_FLOOR_DB;
+    const double *rgb = channel_color(sp->channel);
+
+    cairo_set_source_rgb(cr, rgb[0], rgb[1], rgb[2]);
+    cairo_set_line_width(cr, 1);
+
+    /* More bins than columns: keep the highest of each column */
+    int cols = (int)cw;
+    int k = 0;
+    for (int col = 0; col < cols && k < sp->bins; col++)
+    {
+        int end = (int)((int64_t)(col + 1) * sp->bins / cols);
+        float top = sp->db[k];
 
-        for (int i = 0; i < n; i++)
-        {
-            double x = left_margin +
-                       plot_w *
-                           (double)(visible_ts[i] - t_min) /
-                           (double)(time_window_us);
+        for (; k < end && k < sp->bins; k++)
+            if (sp->db[k] > top)
+                top = sp->db[k];
 
-            if (x < left_margin)
-                continue;
-            if (x > left_margin + plot_w)
-                break;
+        double py = cy + ch * (SPECTRUM_TOP_DB - top) / db_span;
 
-            double v = visible_val[s][i];
+        if (col == 0)
+            cairo_move_to(cr, cx, py);
+        else
+            cairo_line_to(cr, cx + col, py);
+    }
+    cairo_stroke(cr);
 
-            /* ADC-style scaling (0–4095) */
-            double norm = v / sensor_y_max[s];
+    cairo_restore(cr);
+}
 
-            /* Clamp to [0, 1] to avoid visual artifacts */
-            if (norm < 0.0)
-                norm = 0.0;
-            else if (norm > 1.0)
-                norm = 1.0;
+static gboolean draw_grid(GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+    int64_t t_start = g_get_monotonic_time();
+    uint64_t t_max = visible_t_max();
+    PlotLayout l;
+    GdkRGBA fg, bg;
 
-            double y = (height - bottom_margin) -
-                       (plot_h * norm);
+    plot_layout(widget, &l);
+    theme_colors(widget, &fg, &bg);
 
-            if (!started)
-            {
-                cairo_move_to(cr, x, y);
-                started = TRUE;
-            }
-            else
-            {
-                cairo_line_to(cr, x, y);
-            }
-        }
+    if (l.width <= 0 || l.height <= 0)
+        return FALSE;
 
-        cairo_stroke(cr);
+    /* First frame: just the background, the connect bar matters more */
+    if (!plot_ready)
+    {
+        gdk_cairo_set_source_rgba(cr, &bg);
+        cairo_paint(cr);
+        return FALSE;
     }
 
-    /* ================== Dynamic Legend ================== */
+    update_static_layers(widget, &l, &fg, &bg);
 
-    /* Count active legend items */
-    int legend_items = 0;
-    for (int i = 0; i < SENSOR_COUNT; i++)
+    cairo_set_source_surface(cr, layer_under, 0, 0);
+    cairo_paint(cr);
+
+    /* With the GL backend the traces are already on the GtkGLArea below */
+    if (!gl_active)
     {
-        if (is_sensor_selected(i))
-            legend_items++;
+        if (opt_full_redraw || capture_shown)
+            draw_traces(cr, &l, t_max);
+        else
+            draw_traces_scrolling(widget, cr, &l, t_max);
     }
 
-    const int legend_x = left_margin + plot_w - 190;
+    cairo_set_source_surface(cr, layer_over, 0, 0);
+    cairo_paint(cr);
 
-    int legend_y = 24;
-    const int box_size = 12;
-    const int row_spacing = 20;
+    draw_x_labels(cr, &l, &fg, t_max, window_for(axis_sensor()));
+    draw_gaps(cr, &l, &fg, t_max);
+    draw_capture(cr, &l, &fg, t_max);
+    draw_cursor(cr, &l, &fg, &bg, t_max);
 
-    const int legend_padding = 10;
+    if (opt_hud)
+        draw_hud(cr, &l);
 
-    /* Legend height = padding + title + rows */
-    int legend_height =
-        legend_padding * 2 +
-        row_spacing * (1 + legend_items); // 1 = "Legend:" title
+    draw_spectrum(cr, &l);
 
-    cairo_set_font_size(cr, 12);
+    note_screen_latency(widget);
 
-    /* Legend title */
-    /* Clip legend to plot area */
-    cairo_save(cr);
-    cairo_rectangle(cr,
-                    left_margin,
-                    0,
-                    plot_w,
-                    plot_h);
-    cairo_clip(cr);
+    perf_frame(g_get_monotonic_time() - t_start + gl_frame_us);
+    gl_frame_us = 0;
 
-    /* Legend background box (auto-sized) */
-    /* Legend background (theme-aware) */
-    cairo_set_source_rgba(cr,
-                          legend_bg.red,
-                          legend_bg.green,
-                          legend_bg.blue,
-                          1.0);
+    return FALSE;
+}
 
-    cairo_rectangle(cr,
-                    legend_x - legend_padding,
-                    legend_y - row_spacing + 4,
-                    130,
-                    legend_height);
-    cairo_fill(cr);
+/* ---------- OpenGL backend (--gl) ---------- */
 
-    cairo_set_source_rgba(cr,
-                          fg.red,
-                          fg.green,
-                          fg.blue,
-                          1.0);
+static GlSeries *gl_series[MAX_GATEWAYS][MAX_CHANNELS];
 
-    cairo_move_to(cr, legend_x, legend_y);
-    cairo_show_text(cr, "Legend:");
-    legend_y += row_spacing;
+static void gl_realize(GtkGLArea *area, gpointer d)
+{
+    gtk_gl_area_make_current(area);
 
-    for (int i = 0; i < SENSOR_COUNT; i++)
+    GError *err = gtk_gl_area_get_error(area);
+    if (err || !glplot_init(gdk_gl_context_get_use_es(
+                   gtk_gl_area_get_context(area))))
     {
-        if (!is_sensor_selected(i))
-            continue;
+        printf("[GUI] OpenGL unavailable (%s), using Cairo\n",
+               err ? err->message : "shader setup failed");
+        gl_active = FALSE;
+
+        /* Off the overlay, so it neither covers the Cairo plot nor takes
+           its input */
+        gtk_widget_hide(GTK_WIDGET(area));
+        if (graph_area)
+            gtk_widget_queue_draw(graph_area);
+    }
+}
 
-        /* --- Color square --- */
-        cairo_set_source_rgb(cr,
-                             plot_colors[i][0],
-                             plot_colors[i][1],
-                             plot_colors[i][2]);
+static void gl_unrealize(GtkGLArea *area, gpointer d)
+{
+    if (!gl_active)
+        return;
 
-        cairo_rectangle(cr,
-                        legend_x,
-                        legend_y - box_size + 2,
-                        box_size,
-                        box_size);
-        cairo_fill(cr);
+    gtk_gl_area_make_current(area);
+    if (gtk_gl_area_get_error(area))
+        return;
 
-        /* Legend text (theme foreground color) */
-        cairo_set_source_rgba(cr,
-                              fg.red,
-                              fg.green,
-                              fg.blue,
-                              fg.alpha);
+    for (int g = 0; g < MAX_GATEWAYS; g++)
+    {
+        for (int s = 0; s < MAX_CHANNELS; s++)
+        {
+            glplot_series_free(gl_series[g][s]);
+            gl_series[g][s] = NULL;
+        }
+    }
+    glplot_shutdown();
+}
 
-        cairo_move_to(cr,
-                      legend_x + box_size + 8,
-                      legend_y + 2);
+static gboolean gl_render_traces(GtkGLArea *area)
+{
+    GtkWidget *widget = GTK_WIDGET(area);
+    uint64_t t_max = visible_t_max();
+    PlotLayout l;
+    GdkRGBA fg, bg;
+
+    plot_layout(widget, &l);
+    theme_colors(widget, &fg, &bg);
+
+    GlFrame fr = {
+        .view_w = l.width,
+        .view_h = l.height,
+        .scale = gtk_widget_get_scale_factor(widget),
+        .left = left_margin,
+        .bottom = l.height - bottom_margin,
+        .width = l.plot_w,
+        .height = l.plot_h,
+    };
+    const float bgc[3] = {bg.red, bg.green, bg.blue};
+
+    glplot_begin(&fr, bgc);
+
+    if (l.plot_w <= 0)
+        return TRUE;
 
-        cairo_show_text(cr, sensor_labels[i]);
+    for (int g = 0; g < gateway_count; g++)
+    {
+        for (uint64_t m = selected_mask; m; m &= m - 1)
+        {
+            int s = __builtin_ctzll(m);
+            SensorHistory *h = plot_hist(g, s);
 
-        legend_y += row_spacing;
-    }
-    cairo_restore(cr);
+            if (!h)
+                continue;
 
-    /* Reset color for axes (theme foreground) */
-    cairo_set_source_rgba(cr,
-                          fg.red,
-                          fg.green,
-                          fg.blue,
-                          fg.alpha);
+            const double *color = channel_color(s);
+            GlStyle st = {
+                .color = {color[0], color[1], color[2]},
+                .y_max = channel_y_max(s),
+                .dash_on = gateway_dashes[g][0],
+            };
 
-    cairo_set_line_width(cr, 2.5);
+            for (int k = 0; k < gateway_dash_count[g]; k++)
+                st.dash_period += gateway_dashes[g][k];
 
-    /* Y-axis */
-    cairo_move_to(cr, left_margin + 0.5, arrow_size);
-    cairo_line_to(cr, left_margin + 0.5, height - bottom_margin);
+            uint64_t window = window_for(s);
+            uint64_t t_min = window_start(t_max, window);
 
-    /* X-axis */
-    cairo_move_to(cr, left_margin, height - bottom_margin + 0.5);
-    cairo_line_to(cr,
-                  left_margin + plot_w,
-                  height - bottom_margin + 0.5);
+            /* Raw ring covers the window: incremental VBO upload. A
+             * capture goes through points so the live series stays, and
+             * digital channels are drawn as steps from their points */
+            const ChannelType *type = channel_type(s);
+            gboolean steps = type->steps;
 
-    cairo_stroke(cr);
+            if (!capture_shown && !steps && ring_covers(&h->level[0], t_min))
+            {
+                if (!gl_series[g][s])
+                    gl_series[g][s] = glplot_series_new();
 
-    /* ================== Axis Arrows ================== */
-    cairo_set_line_width(cr, 2.5);
+                glplot_draw_raw(gl_series[g][s], &h->level[0], t_min,
+                                window, &st);
+                continue;
+            }
 
-    /* X-axis arrow (right) */
-    cairo_move_to(cr, left_margin + plot_w, height - bottom_margin);
-    cairo_line_to(cr, left_margin + plot_w + arrow_size, height - bottom_margin + 0.5);
-    cairo_line_to(cr, left_margin + plot_w, height - bottom_margin + arrow_size);
+            /* Longer windows come from the downsampled tiers */
+            const double *x, *v;
+            int n = trace_points(h, t_min, window, l.plot_w, &x, &v);
 
-    cairo_stroke(cr);
+            /* A bit mask: one step lane per bit, bit 0 at the bottom */
+            if (type->bits && n >= 2)
+            {
+                st.y_max = type->bits;
+                for (int b = 0; b < type->bits; b++)
+                {
+                    n = trace_bit_points(b, &x, &v);
+                    n = trace_steps(x, v, n, &x, &v);
+                    glplot_draw_points(x, v, n, &st);
+                }
+                continue;
+            }
 
-    /* Y-axis arrow (up) */
-    cairo_move_to(cr, left_margin - arrow_size, arrow_size);
-    cairo_line_to(cr, left_margin + 0.5, 0);
-    cairo_line_to(cr, left_margin + arrow_size, arrow_size);
-    cairo_stroke(cr);
+            if (steps)
+                n = trace_steps(x, v, n, &x, &v);
+            glplot_draw_points(x, v, n, &st);
+        }
+    }
 
-    /* ================== X-axis Ticks ================== */
+    return TRUE;
+}
 
-    cairo_set_font_size(cr, 11);
+static gboolean gl_render(GtkGLArea *area, GdkGLContext *ctx, gpointer d)
+{
+    if (!gl_active)
+        return FALSE;
 
-    int tick_count = plot_w / grid_spacing;
-    if (tick_count < 1)
-        tick_count = 1;
+    int64_t t_start = g_get_monotonic_time();
+    gboolean done = gl_render_traces(area);
 
-    int ref_sensor = -1;
-    for (int s = 0; s < SENSOR_COUNT; s++)
-    {
-        if (is_sensor_selected(s) && visible_count[s] > 1)
-        {
-            ref_sensor = s;
-            break;
-        }
-    }
+    gl_frame_us = g_get_monotonic_time() - t_start;
+    return done;
+}
 
-    if (ref_sensor < 0)
-        ref_sensor = 0;
+/* ---------- Startup ----------
+ *
+ * Only what the first frame needs is done before it: the widgets, with
+ * the connect bar usable right away. The stylesheet, the plot's static
+ * layers, the GtkGLArea (--gl, whose GL context is the slowest part to
+ * set up), a --replay and the periodic timers follow in deferred_init(),
+ * which runs ahead of any input once the first frame is painted.
+ * --startup-profile prints the time each step took.
+ */
+#define STARTUP_MARKS 8
+
+static struct
+{
+    int64_t t0; /* main() */
+    int count;
+    const char *what[STARTUP_MARKS];
+    int64_t us[STARTUP_MARKS];
+} startup;
 
-    for (int i = 0; i <= tick_count; i++)
+static void startup_mark(const char *what)
+{
+    if (startup.count < STARTUP_MARKS)
     {
-        double x = left_margin + i * grid_spacing;
-        uint64_t t = t_min + (time_window_us * i) / tick_count;
+        startup.what[startup.count] = what;
+        startup.us[startup.count++] = g_get_monotonic_time();
+    }
+}
 
-        /* Tick mark */
-        cairo_move_to(cr, x + 0.5, height - bottom_margin);
-        cairo_line_to(cr, x + 0.5, height - bottom_margin + 6);
-        cairo_stroke(cr);
+/* How long ago the process was exec'd, -1 if unknown (clock ticks) */
+static int64_t process_age_us(void)
+{
+    char buf[1024];
+    FILE *f = fopen("/proc/self/stat", "r");
+    size_t n = f ? fread(buf, 1, sizeof(buf) - 1, f) : 0;
+    unsigned long long start = 0;
+    struct timespec now;
+
+    if (f)
+        fclose(f);
+    buf[n] = 0;
+
+    /* Field 22, counted after the parenthesised command name */
+    char *p = strrchr(buf, ')');
+    for (int field = 2; p && field < 22; field++)
+        p = strchr(p + 1, ' ');
+    if (!p || sscanf(p, " %llu", &start) != 1 ||
+        clock_gettime(CLOCK_BOOTTIME, &now) != 0)
+        return -1;
+
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000 -
+           (int64_t)(start * 1000000 / sysconf(_SC_CLK_TCK));
+}
 
-        /* Label */
-        char label[32];
+static void startup_report(void)
+{
+    char line[512];
+    int64_t prev = startup.t0;
+    int64_t before_main = process_age_us() -
+                          (g_get_monotonic_time() - startup.t0);
+    int n = snprintf(line, sizeof(line), "[GUI] Startup:");
 
-        /* Absolute monotonic time in milliseconds (reduced magnitude) */
-        uint64_t abs_ms = t / 1000;
+    if (before_main >= 0)
+        n += snprintf(line + n, sizeof(line) - n, " exec ~%.0f ms,",
+                      before_main / 1000.0);
 
-        /* Drop high digits to avoid clutter (keep last 5 digits) */
-        abs_ms %= 100000;
+    for (int i = 0; i < startup.count && n < (int)sizeof(line); i++)
+    {
+        n += snprintf(line + n, sizeof(line) - n, " %s %.1f ms%s",
+                      startup.what[i], (startup.us[i] - prev) / 1000.0,
+                      i + 1 < startup.count ? "," : "");
+        prev = startup.us[i];
+    }
+    printf("%s\n", line);
 
-        snprintf(label, sizeof(label), "%" PRIu64, abs_ms);
+    for (int i = 0; i < startup.count; i++)
+        if (strcmp(startup.what[i], "first frame") == 0)
+            printf("[GUI] Time to first frame: %.1f ms after main()\n",
+                   (startup.us[i] - startup.t0) / 1000.0);
+}
 
-        cairo_text_extents_t ext;
-        cairo_text_extents(cr, label, &ext);
+/* Section B's plot: the GtkGLArea goes under the Cairo overlay later */
+static GtkWidget *plot_overlay = NULL;
 
-        cairo_move_to(cr,
-                      x - ext.width / 2,
-                      height - bottom_margin + 20);
-        cairo_show_text(cr, label);
-    }
+static void add_gl_area(void)
+{
+    GtkWidget *gl_area = gtk_gl_area_new();
 
-    /* ================== X-axis Label ================== */
-    const char *xlabel = "Time (absolute monotonic, ms)";
+    gtk_gl_area_set_has_alpha(GTK_GL_AREA(gl_area), FALSE);
+    g_signal_connect(gl_area, "realize", G_CALLBACK(gl_realize), NULL);
+    g_signal_connect(gl_area, "unrealize", G_CALLBACK(gl_unrealize), NULL);
+    g_signal_connect(gl_area, "render", G_CALLBACK(gl_render), NULL);
 
-    cairo_select_font_face(cr, "Sans",
-                           CAIRO_FONT_SLANT_NORMAL,
-                           CAIRO_FONT_WEIGHT_NORMAL);
-    cairo_set_font_size(cr, 14);
-    cairo_set_source_rgba(cr,
-                          fg.red,
-                          fg.green,
-                          fg.blue,
-                          fg.alpha);
+    gl_active = TRUE;
+    gtk_container_add(GTK_CONTAINER(plot_overlay), gl_area);
+    gtk_widget_show(gl_area);
+}
 
-    cairo_text_extents_t ext;
-    cairo_text_extents(cr, xlabel, &ext);
+static gboolean deferred_init(gpointer data)
+{
+    (void)data;
 
-    double x = (width - ext.width) / 2.0 - ext.x_bearing;
-    double y = height - outer_bottom_margin;
+    load_css();
 
-    cairo_move_to(cr, x, y);
-    cairo_show_text(cr, xlabel);
+    if (plot_overlay)
+        add_gl_area();
 
-    /* ================== Y-axis Label ================== */
-    const char *ylabel = "Value";
+    plot_ready = TRUE;
+    if (graph_area)
+        gtk_widget_queue_draw(graph_area);
 
-    cairo_save(cr);
-    cairo_translate(cr, outer_left_margin + 2, height / 2);
+    if (opt_replay)
+        start_replay(opt_replay, opt_replay_speed);
 
-    cairo_rotate(cr, -G_PI / 2);
+    g_timeout_add_seconds(1, perf_tick, NULL);
 
-    cairo_set_font_size(cr, 14);
-    cairo_set_source_rgba(cr,
-                          fg.red,
-                          fg.green,
-                          fg.blue,
-                          fg.alpha);
+    printf("[GUI] Sample transforms: %s\n", xform_backend());
 
-    cairo_text_extents_t yext;
-    cairo_text_extents(cr, ylabel, &yext);
+    startup_mark("deferred");
+    if (opt_startup_profile)
+        startup_report();
+    return G_SOURCE_REMOVE;
+}
 
-    cairo_move_to(cr, -yext.width / 2, 0);
-    cairo_show_text(cr, ylabel);
+static void first_frame_painted(GdkFrameClock *clock, gpointer data)
+{
+    (void)data;
 
-    cairo_restore(cr);
+    g_signal_handlers_disconnect_by_func(clock, first_frame_painted, NULL);
+    startup_mark("first frame");
 
-    return FALSE;
+    /* Ahead of input events, so no handler sees a half-started UI */
+    g_idle_add_full(G_PRIORITY_HIGH, deferred_init, NULL, NULL);
 }
 
 /* ---------- UI ---------- */
 
 int main(int argc, char **argv)
 {
-    gtk_init(&argc, &argv);
-    load_css();
+    GError *opt_err = NULL;
+
+    startup.t0 = g_get_monotonic_time();
+
+    if (!gtk_init_with_args(&argc, &argv, NULL, option_entries, NULL,
+                            &opt_err))
+    {
+        fprintf(stderr, "%s\n", opt_err ? opt_err->message : "gtk_init failed");
+        return 1;
+    }
+    startup_mark("gtk_init");
 
-    sensor_freq =
-        g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    if (opt_raw_samples < MIN_HISTORY_SAMPLES)
+        opt_raw_samples = MIN_HISTORY_SAMPLES;
+    if (opt_tier_buckets < MIN_HISTORY_SAMPLES)
+        opt_tier_buckets = MIN_HISTORY_SAMPLES;
+
+    for (int i = 0; opt_profiles && opt_profiles[i]; i++)
+        if (!profile_parse(opt_profiles[i]))
+            fprintf(stderr, "Ignoring --profile %s\n", opt_profiles[i]);
 
     GtkWidget *win = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(win), "Measurement Network Gateway - GUI");
@@ -1537,13 +4033,15 @@ int main(int argc, char **argv)
     GtkWidget *left = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
     gtk_box_pack_start(GTK_BOX(top_row), left, FALSE, FALSE, 0);
 
-    GtkWidget *cnk_label = gtk_label_new("Enter Server IP:");
+    GtkWidget *cnk_label = gtk_label_new("Enter Server IP(s):");
     gtk_widget_set_halign(cnk_label, GTK_ALIGN_END);
     gtk_box_pack_start(GTK_BOX(left), cnk_label, FALSE, FALSE, 6);
 
     /* IP entry (inline with label and buttons) */
     connect_entry = gtk_entry_new();
-    gtk_entry_set_width_chars(GTK_ENTRY(connect_entry), 20);
+    gtk_entry_set_width_chars(GTK_ENTRY(connect_entry), 32);
+    gtk_entry_set_placeholder_text(GTK_ENTRY(connect_entry),
+                                   "IP, or several separated by commas");
     gtk_box_pack_start(GTK_BOX(left), connect_entry, FALSE, FALSE, 0);
     g_signal_connect(connect_entry, "focus-out-event",
                      G_CALLBACK(entry_focus_out), NULL);
@@ -1593,15 +4091,13 @@ int main(int argc, char **argv)
     gtk_widget_set_halign(chk_label, GTK_ALIGN_END);
     gtk_box_pack_start(GTK_BOX(right), chk_label, FALSE, FALSE, 6);
 
-    /* Checkboxes packed AFTER spacer = hard right aligned */
-    for (int i = 0; i < SENSOR_COUNT; i++)
-    {
-        checkboxes[i] =
-            gtk_check_button_new_with_label(sensor_labels[i]);
-        gtk_box_pack_start(GTK_BOX(right), checkboxes[i], FALSE, FALSE, 0);
-        g_signal_connect(checkboxes[i], "toggled",
-                         G_CALLBACK(checkbox_changed), NULL);
-    }
+    /* Checkboxes packed AFTER spacer = hard right aligned; they wrap
+     * onto more rows for gateways with many channels */
+    sensor_box = gtk_flow_box_new();
+    gtk_flow_box_set_selection_mode(GTK_FLOW_BOX(sensor_box),
+                                    GTK_SELECTION_NONE);
+    gtk_flow_box_set_max_children_per_line(GTK_FLOW_BOX(sensor_box), 8);
+    gtk_box_pack_start(GTK_BOX(right), sensor_box, FALSE, FALSE, 0);
 
     /* Section B */
     /* ---------- Section B : Graph ---------- */
@@ -1609,18 +4105,54 @@ int main(int argc, char **argv)
     gtk_widget_set_vexpand(secB, TRUE);
     gtk_box_pack_start(GTK_BOX(main_v), secB, TRUE, TRUE, 0);
 
-    graph_area = gtk_drawing_area_new();
+    /* Cairo draws everything, or only the static layers and labels on
+     * top of a GtkGLArea that draws the traces (--gl) */
+    GtkWidget *plot_da = gtk_drawing_area_new();
+    gtk_widget_set_hexpand(plot_da, TRUE);
+    gtk_widget_set_vexpand(plot_da, TRUE);
+
+    if (opt_gl)
+    {
+        /* The GtkGLArea itself is added after the first frame */
+        graph_area = plot_overlay = gtk_overlay_new();
+        gtk_overlay_add_overlay(GTK_OVERLAY(graph_area), plot_da);
+        gtk_overlay_set_overlay_pass_through(GTK_OVERLAY(graph_area),
+                                             plot_da, TRUE);
+    }
+    else
+        graph_area = plot_da;
+
     gtk_widget_set_hexpand(graph_area, TRUE);
     gtk_widget_set_vexpand(graph_area, TRUE);
-    gtk_container_add(GTK_CONTAINER(secB), graph_area);
 
-    g_signal_connect(graph_area, "draw",
+    /* Mouse zoom/pan/cursor; above the child so the GL area is covered too */
+    GtkWidget *plot_events = gtk_event_box_new();
+    gtk_event_box_set_above_child(GTK_EVENT_BOX(plot_events), TRUE);
+    gtk_widget_add_events(plot_events,
+                          GDK_SCROLL_MASK | GDK_BUTTON_PRESS_MASK |
+                              GDK_BUTTON_RELEASE_MASK |
+                              GDK_POINTER_MOTION_MASK |
+                              GDK_LEAVE_NOTIFY_MASK);
+    g_signal_connect(plot_events, "scroll-event",
+                     G_CALLBACK(plot_scroll), NULL);
+    g_signal_connect(plot_events, "button-press-event",
+                     G_CALLBACK(plot_button), NULL);
+    g_signal_connect(plot_events, "button-release-event",
+                     G_CALLBACK(plot_button), NULL);
+    g_signal_connect(plot_events, "motion-notify-event",
+                     G_CALLBACK(plot_motion), NULL);
+    g_signal_connect(plot_events, "leave-notify-event",
+                     G_CALLBACK(plot_leave), NULL);
+    gtk_container_add(GTK_CONTAINER(plot_events), graph_area);
+    gtk_container_add(GTK_CONTAINER(secB), plot_events);
+
+    g_signal_connect(plot_da, "draw",
                      G_CALLBACK(draw_grid), NULL);
+    gtk_widget_add_tick_callback(graph_area, graph_tick, NULL, NULL);
 
     /* Redraw plot when GTK theme / style changes */
     g_signal_connect(win, "style-updated",
-                     G_CALLBACK(gtk_widget_queue_draw),
-                     graph_area);
+                     G_CALLBACK(style_updated), NULL);
 
     /* Section C */
     GtkWidget *secC = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
@@ -1646,6 +4178,14 @@ int main(int argc, char **argv)
     gtk_box_pack_start(GTK_BOX(secC_left), start_btn, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(secC_left), stop_btn, FALSE, FALSE, 0);
 
+    /* Holds the view still; the streams keep filling the history */
+    freeze_btn = gtk_toggle_button_new_with_label("Freeze");
+    gtk_widget_set_tooltip_text(freeze_btn,
+                                "Freeze the plot. Drag to pan, wheel to "
+                                "zoom, right click to go back to live.");
+    g_signal_connect(freeze_btn, "toggled", G_CALLBACK(freeze_toggled), NULL);
+    gtk_box_pack_start(GTK_BOX(secC_left), freeze_btn, FALSE, FALSE, 0);
+
     /* ---- Expanding spacer ---- */
     GtkWidget *secC_spacer = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
     gtk_box_pack_start(GTK_BOX(secC), secC_spacer, TRUE, TRUE, 0);
@@ -1704,9 +4244,26 @@ int main(int argc, char **argv)
     g_signal_connect(stop_btn, "clicked", G_CALLBACK(stop_clicked), NULL);
     g_signal_connect(connect_entry, "changed", G_CALLBACK(apply_state), NULL);
 
+    /* The built-in sensors; advertised channels are added later */
+    add_channel_checkboxes();
+
     apply_state();
+    startup_mark("widgets");
     gtk_widget_show_all(win);
-    g_timeout_add(33, redraw_graph, NULL);
+    startup_mark("shown");
+
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(win);
+
+    if (clock)
+        g_signal_connect(clock, "after-paint",
+                         G_CALLBACK(first_frame_painted), NULL);
+    else
+        g_idle_add(deferred_init, NULL);
+
     gtk_main();
+
+    /* Stop the worker threads before the process goes away */
+    export_cancel();
+    spectrum_stop();
     return 0;
 }
@@ -0,0 +1,198 @@
+#include "history.h"
+
+/* bits > 0 keeps bit masks in bit lanes (store is not used then) */
+void history_init(SensorHistory *h, int raw_samples, int tier_buckets,
+                  RingStore store, int bits)
+{
+    RingStore tier[3];
+
+    memset(h, 0, sizeof(*h));
+
+    if (bits > 0)
+    {
+        h->bits = bits;
+        ring_init_bits(&h->level[0], raw_samples, 1, bits);
+
+        /* TIER_MIN and TIER_MAX only */
+        for (int t = 1; t <= HISTORY_TIERS; t++)
+            ring_init_bits(&h->level[t], tier_buckets, 2, bits);
+        return;
+    }
+
+    /* A bucket's min and max are samples; its mean needs a fraction */
+    tier[TIER_MIN] = store;
+    tier[TIER_MAX] = store;
+    tier[TIER_MEAN] = store == RING_F64 ? RING_F64 : RING_F32;
+
+    ring_init(&h->level[0], raw_samples, 1, &store);
+
+    for (int t = 1; t <= HISTORY_TIERS; t++)
+        ring_init(&h->level[t], tier_buckets, 3, tier);
+}
+
+/* Fold one value (or bucket) into tier t, cascading to coarser tiers */
+static void history_accumulate(SensorHistory *h, int t, uint64_t ts,
+                               double min, double max, double mean)
+{
+    HistAccum *a = &h->acc[t];
+
+    /* Time went backwards (stream restarted): drop the partial bucket */
+    if (a->n > 0 && ts < a->ts)
+        a->n = 0;
+
+    if (a->n == 0)
+    {
+        a->ts = ts;
+        a->min = min;
+        a->max = max;
+        a->sum = 0.0;
+    }
+    else if (h->bits)
+    {
+        /* Per bit: low somewhere (AND), high somewhere (OR) */
+        a->min = (unsigned)a->min & (unsigned)min;
+        a->max = (unsigned)a->max | (unsigned)max;
+    }
+    else
+    {
+        if (min < a->min)
+            a->min = min;
+        if (max > a->max)
+            a->max = max;
+    }
+
+    a->sum += mean;
+
+    if (++a->n < TIER_FACTOR)
+        return;
+
+    double vals[3];
+    vals[TIER_MIN] = a->min;
+    vals[TIER_MAX] = a->max;
+    vals[TIER_MEAN] = a->sum / a->n;
+
+    ring_push_lanes(&h->level[t + 1], a->ts, vals);
+    a->n = 0;
+
+    if (t + 1 < HISTORY_TIERS)
+        history_accumulate(h, t + 1, a->ts,
+                           vals[TIER_MIN], vals[TIER_MAX], vals[TIER_MEAN]);
+}
+
+void history_push(SensorHistory *h, uint64_t ts, double val)
+{
+    /* A mask as the ring keeps it, so the buckets combine whole bits */
+    if (h->bits)
+    {
+        double max = (1u << h->bits) - 1;
+        val = val <= 0 ? 0 : val >= max ? max : (unsigned)(val + 0.5);
+    }
+
+    ring_push(&h->level[0], ts, val);
+    history_accumulate(h, 0, ts, val, val, val);
+}
+
+void history_clear(SensorHistory *h)
+{
+    /* Rings only: the accumulators belong to the producer */
+    for (int t = 0; t <= HISTORY_TIERS; t++)
+        ring_clear(&h->level[t]);
+}
+
+gboolean history_latest_ts(SensorHistory *h, uint64_t *ts)
+{
+    return ring_latest_ts(&h->level[0], ts);
+}
+
+void history_span_reserve(HistorySpan *span, int cap)
+{
+    if (cap <= span->cap)
+        return;
+
+    span->cap = cap;
+    span->ts = g_renew(uint64_t, span->ts, cap);
+    span->lo = g_renew(double, span->lo, cap);
+    span->hi = g_renew(double, span->hi, cap);
+    span->mean = g_renew(double, span->mean, cap);
+}
+
+/*
+ * Fill span with everything from t_min onwards, using the finest level
+ * that still covers t_min and fits into span->cap points. The coarsest
+ * tier is used as a last resort (its newest span->cap buckets).
+ */
+int history_query(SensorHistory *h, uint64_t t_min, HistorySpan *span)
+{
+    return history_query_range(h, t_min, UINT64_MAX, span);
+}
+
+/*
+ * Like history_query() for [t_min, t_max] only. Picking the level and
+ * finding the range are binary searches, so a span far back or a deep
+ * zoom-out costs no more than span->cap points.
+ */
+int history_query_range(SensorHistory *h, uint64_t t_min, uint64_t t_max,
+                        HistorySpan *span)
+{
+    int level = 0;
+
+    for (; level < HISTORY_TIERS; level++)
+    {
+        SampleRing *r = &h->level[level];
+
+        if (ring_covers(r, t_min) &&
+            ring_count_range(r, t_min, t_max) <= span->cap)
+            break;
+    }
+
+    SampleRing *r = &h->level[level];
+    span->level = level;
+
+    if (level == 0)
+    {
+        span->n = ring_snapshot_range(r, t_min, t_max, span->ts, &span->lo,
+                                      span->cap);
+        memcpy(span->hi, span->lo, span->n * sizeof(double));
+        memcpy(span->mean, span->lo, span->n * sizeof(double));
+    }
+    else
+    {
+        double *vals[3];
+        vals[TIER_MIN] = span->lo;
+        vals[TIER_MAX] = span->hi;
+        vals[TIER_MEAN] = span->mean;
+
+        span->n = ring_snapshot_range(r, t_min, t_max, span->ts, vals,
+                                      span->cap);
+        if (h->bits)
+            memcpy(span->mean, span->hi, span->n * sizeof(double));
+    }
+
+    return span->n;
+}
+
+/*
+ * Value at time t for cursor readouts: the newest sample at or before t
+ * from the finest level that still holds t (a tier gives its bucket
+ * mean, or the bits set in it for a mask). FALSE if t is older than
+ * everything kept.
+ */
+gboolean history_value_at(SensorHistory *h, uint64_t t, uint64_t *ts,
+                          double *val)
+{
+    for (int level = 0; level <= HISTORY_TIERS; level++)
+    {
+        SampleRing *r = &h->level[level];
+        double v[RING_MAX_LANES];
+
+        if (level < HISTORY_TIERS && !ring_covers(r, t))
+            continue;
+
+        if (!ring_sample_at(r, t, ts, v))
+            return FALSE;
+
+        *val = level == 0 ? v[0] : v[h->bits ? TIER_MAX : TIER_MEAN];
+        return TRUE;
+    }
+    return FALSE;
+}
@@ -0,0 +1,76 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "ring.h"
+
+/* ---------- Tiered per-sensor history ----------
+ *
+ * level 0       : full-rate raw ring (recent window)
+ * level 1..TIERS: min/max/mean buckets, each TIER_FACTOR times coarser
+ *                 than the level below (10x, 100x, ...)
+ *
+ * At 1 kHz the defaults keep ~65 s of raw samples, ~11 min at 10x and
+ * ~1.8 h at 100x. Values are kept in the channel's store (ring.h):
+ * samples and bucket min/max in it, bucket means as floats unless it is
+ * RING_F64. That is about 2.7 MB per 16-bit sensor and 2.1 MB per
+ * push-button channel, against 5 MB with doubles throughout; the
+ * timestamps are most of what is left.
+ *
+ * A bit-mask history (a switch bank) keeps one bit lane per switch
+ * instead (ring_init_bits()). Its buckets hold, per bit, whether it was
+ * low and whether it was high at some point: the AND and the OR of the
+ * masks, with no mean. About 1.9 MB for eight switches.
+ */
+#define HISTORY_TIERS 2
+#define TIER_FACTOR 10
+
+#define DEFAULT_RAW_SAMPLES 65536
+#define DEFAULT_TIER_BUCKETS 65536
+#define MIN_HISTORY_SAMPLES 1024
+
+enum
+{
+    TIER_MIN = 0,
+    TIER_MAX,
+    TIER_MEAN
+};
+
+typedef struct
+{
+    uint64_t ts; /* timestamp of the first sample in the bucket */
+    double min, max, sum;
+    int n;
+} HistAccum;
+
+typedef struct
+{
+    SampleRing level[1 + HISTORY_TIERS];
+    HistAccum acc[HISTORY_TIERS]; /* producer only */
+    int bits;                     /* > 0: bit masks of that many bits */
+} SensorHistory;
+
+/* Caller-owned query result; lo == hi for raw samples, and mean == hi
+ * for bit-mask buckets */
+typedef struct
+{
+    int cap;
+    int n;
+    int level;
+    uint64_t *ts;
+    double *lo, *hi, *mean;
+} HistorySpan;
+
+void history_init(SensorHistory *h, int raw_samples, int tier_buckets,
+                  RingStore store, int bits);
+void history_push(SensorHistory *h, uint64_t ts, double val);
+void history_clear(SensorHistory *h);
+gboolean history_latest_ts(SensorHistory *h, uint64_t *ts);
+
+void history_span_reserve(HistorySpan *span, int cap);
+int history_query(SensorHistory *h, uint64_t t_min, HistorySpan *span);
+int history_query_range(SensorHistory *h, uint64_t t_min, uint64_t t_max,
+                        HistorySpan *span);
+gboolean history_value_at(SensorHistory *h, uint64_t t, uint64_t *ts,
+                          double *val);
+
+#endif
@@ -0,0 +1,119 @@
+#include "msgpool.h"
+
+/* In front of every message: its link in the queue and its handler */
+typedef struct MsgHeader
+{
+    _Alignas(16) struct MsgHeader *next;
+    GSourceFunc fn;
+} MsgHeader;
+
+static struct
+{
+    _Atomic uint64_t used; /* bit per slot */
+    atomic_uint_fast64_t misses;
+    _Alignas(16) unsigned char slot[MSG_POOL_SLOTS][MSG_POOL_SLOT_SIZE];
+} pool;
+
+static MsgHeader *_Atomic posted; /* newest first */
+
+void *msg_alloc(size_t size)
+{
+    uint64_t used = atomic_load_explicit(&pool.used, memory_order_relaxed);
+
+    while (sizeof(MsgHeader) + size <= MSG_POOL_SLOT_SIZE && ~used)
+    {
+        int i = __builtin_ctzll(~used);
+
+        if (atomic_compare_exchange_weak_explicit(
+                &pool.used, &used, used | (1ULL << i),
+                memory_order_acquire, memory_order_relaxed))
+            return (MsgHeader *)pool.slot[i] + 1;
+    }
+
+    atomic_fetch_add(&pool.misses, 1);
+    return (MsgHeader *)g_malloc(sizeof(MsgHeader) + size) + 1;
+}
+
+void msg_free(void *p)
+{
+    MsgHeader *h = (MsgHeader *)p - 1;
+    uintptr_t off = (uintptr_t)h - (uintptr_t)pool.slot;
+
+    if (off < sizeof(pool.slot))
+    {
+        uint64_t i = off / MSG_POOL_SLOT_SIZE;
+
+        atomic_fetch_and_explicit(&pool.used, ~(1ULL << i),
+                                  memory_order_release);
+        return;
+    }
+    g_free(h);
+}
+
+/* GTK thread: everything posted so far, oldest first */
+static gboolean msg_dispatch(GSource *src, GSourceFunc cb, gpointer data)
+{
+    (void)cb;
+    (void)data;
+
+    /* Before taking the list, so a post after it wakes us again */
+    g_source_set_ready_time(src, -1);
+
+    MsgHeader *h = atomic_exchange_explicit(&posted, NULL,
+                                            memory_order_acquire);
+    MsgHeader *fifo = NULL;
+
+    while (h)
+    {
+        MsgHeader *next = h->next;
+        h->next = fifo;
+        fifo = h;
+        h = next;
+    }
+
+    while (fifo)
+    {
+        MsgHeader *next = fifo->next;
+        fifo->fn(fifo + 1); /* may free it */
+        fifo = next;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs msg_funcs = {.dispatch = msg_dispatch};
+
+/* The one source that delivers messages, attached on first use */
+static GSource *msg_source(void)
+{
+    static gsize once = 0;
+    static GSource *src;
+
+    if (g_once_init_enter(&once))
+    {
+        src = g_source_new(&msg_funcs, sizeof(GSource));
+        g_source_set_priority(src, G_PRIORITY_DEFAULT_IDLE);
+        g_source_attach(src, NULL);
+        g_once_init_leave(&once, 1);
+    }
+    return src;
+}
+
+void msg_post(void *msg, GSourceFunc fn)
+{
+    MsgHeader *h = (MsgHeader *)msg - 1;
+    MsgHeader *head = atomic_load_explicit(&posted, memory_order_relaxed);
+
+    h->fn = fn;
+    do
+        h->next = head;
+    while (!atomic_compare_exchange_weak_explicit(
+        &posted, &head, h, memory_order_release, memory_order_relaxed));
+
+    g_source_set_ready_time(msg_source(), 0);
+}
+
+/* Allocations that had to go to the heap */
+uint64_t msg_pool_misses(void)
+{
+    return atomic_load(&pool.misses);
+}
@@ -0,0 +1,38 @@
+#ifndef MSGPOOL_H
+#define MSGPOOL_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "utils.h"
+
+/* ---------- Message pool ----------
+ *
+ * Messages the I/O, replay and export threads hand to the GTK thread
+ * (rates and channel updates, connection events, export results) come
+ * from MSG_POOL_SLOTS pre-allocated slots instead of the heap. A slot
+ * is taken by setting its bit in a 64-bit mask with compare-and-swap and
+ * returned with an atomic AND: any thread may allocate, any thread may
+ * free, nothing locks.
+ *
+ * msg_post() queues a message for its handler through one persistent
+ * GSource: the message is pushed on a lock-free list (its header is the
+ * link) and the source made ready; the GTK thread runs the handlers in
+ * posting order and they msg_free() the message. Their return value is
+ * ignored. Unlike g_idle_add() this creates no GSource per message, so
+ * a long session does no steady-state allocation for them.
+ *
+ * Should all slots be in flight (the GTK thread stalled for a long
+ * time), msg_alloc() falls back to g_malloc() and counts it; msg_free()
+ * tells the two apart by address.
+ */
+#define MSG_POOL_SLOTS 64
+#define MSG_POOL_SLOT_SIZE 1024
+
+void *msg_alloc(size_t size);
+void msg_free(void *p);
+void msg_post(void *msg, GSourceFunc fn);
+uint64_t msg_pool_misses(void);
+
+#endif
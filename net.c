@@ -0,0 +1,677 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "net.h"
+
+struct NetConn
+{
+    int fd;
+    int epfd;
+    int wakefd;
+    pthread_t thread;
+
+    atomic_int running;
+    atomic_int drain;
+    atomic_int reconnect;
+    atomic_int backlog; /* unread socket bytes after the last receive */
+    int timeout_ms;
+    gboolean connected;
+    struct sockaddr_in addr;
+
+    NetHandlers h;
+    void *user;
+
+    RxBuffer rx;
+
+    /* Command queue: filled by net_send(), drained by the I/O thread */
+    pthread_mutex_t lock;
+    char queue[NET_CMD_QUEUE][NET_CMD_MAX];
+    int q_head;
+    int q_count;
+
+    /* Bytes accepted from the queue but not yet written (I/O thread) */
+    char out[NET_OUT_BUF];
+    size_t out_len;
+
+    /* Batches over UDP (I/O thread), ufd -1 while on TCP only */
+    int ufd;
+    unsigned char *dgram;
+    gboolean mc_seen;
+    uint32_t mc_next; /* sequence number expected next */
+    atomic_int mc_joined;
+    atomic_uint_fast64_t mc_datagrams, mc_lost, mc_late;
+};
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void net_emit(NetConn *c, NetEvent ev, int err)
+{
+    /* Nobody is listening once net_close() has been called */
+    if (!atomic_load(&c->running))
+        return;
+
+    if (c->h.on_event)
+        c->h.on_event(c, ev, err, c->user);
+}
+
+static void net_watch(NetConn *c)
+{
+    struct epoll_event ev = {0};
+
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    if (!c->connected || c->out_len > 0)
+        ev.events |= EPOLLOUT;
+    ev.data.fd = c->fd;
+
+    epoll_ctl(c->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+/* Move queued commands into the output buffer (as many as fit) */
+static void net_pull_queue(NetConn *c)
+{
+    pthread_mutex_lock(&c->lock);
+
+    while (c->q_count > 0)
+    {
+        const char *cmd = c->queue[c->q_head];
+        size_t len = strlen(cmd);
+
+        if (c->out_len + len > sizeof(c->out))
+            break;
+
+        memcpy(c->out + c->out_len, cmd, len);
+        c->out_len += len;
+
+        c->q_head = (c->q_head + 1) % NET_CMD_QUEUE;
+        c->q_count--;
+    }
+
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* Returns -1 on a fatal socket error */
+static int net_flush(NetConn *c)
+{
+    while (c->out_len > 0)
+    {
+        ssize_t n = send(c->fd, c->out, c->out_len, MSG_NOSIGNAL);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return -1;
+        }
+
+        memmove(c->out, c->out + n, c->out_len - n);
+        c->out_len -= n;
+    }
+    return 0;
+}
+
+static void net_leave_multicast(NetConn *c)
+{
+    if (c->ufd < 0)
+        return;
+
+    epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->ufd, NULL);
+    close(c->ufd);
+    c->ufd = -1;
+    atomic_store(&c->mc_joined, 0);
+}
+
+/* Socket for "<group> <port>"; -1 with errno set */
+static int net_open_multicast(const Frame *f)
+{
+    char group[INET_ADDRSTRLEN];
+    struct sockaddr_in sa = {0};
+    int port, one = 1, rcvbuf = NET_MC_RCVBUF;
+
+    if (!frame_multicast(f, group, sizeof(group), &port) ||
+        inet_pton(AF_INET, group, &sa.sin_addr) != 1)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    /* Several receivers on one host share the port */
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    /* Bound to the group itself so other groups on the port stay out; a
+     * unicast address is taken as "this host" */
+    gboolean mc = IN_MULTICAST(ntohl(sa.sin_addr.s_addr));
+    struct sockaddr_in local = sa;
+    if (!mc)
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0)
+        goto fail;
+
+    if (mc)
+    {
+        struct ip_mreq mreq = {.imr_multiaddr = sa.sin_addr,
+                               .imr_interface.s_addr = htonl(INADDR_ANY)};
+
+        if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+                       sizeof(mreq)) < 0)
+            goto fail;
+    }
+    return fd;
+
+fail:;
+    int err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+}
+
+/*
+ * The gateway moved the batches to a group (MULTICAST reply). Without
+ * it they would simply stop, so if we cannot join it we ask for the TCP
+ * stream back.
+ */
+static void net_join_multicast(NetConn *c, const Frame *f)
+{
+    net_leave_multicast(c);
+
+    int fd = net_open_multicast(f);
+    if (fd < 0)
+    {
+        int err = errno;
+
+        net_send(c, "MULTICAST OFF\n");
+        net_emit(c, NET_EV_MULTICAST, err);
+        return;
+    }
+
+    if (!c->dgram)
+        c->dgram = g_malloc(NET_DGRAM_MAX);
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(c->epfd, EPOLL_CTL_ADD, fd, &ev);
+
+    c->ufd = fd;
+    c->mc_seen = FALSE;
+    atomic_store(&c->mc_joined, 1);
+    net_emit(c, NET_EV_MULTICAST, 0);
+}
+
+/*
+ * Every datagram that is waiting, in order of arrival. Gaps in the
+ * sequence count as lost; one behind the newest seen arrived late and
+ * is dropped, since the histories only take samples in time order.
+ * Receive errors on UDP concern single datagrams and end nothing.
+ */
+static void net_receive_datagrams(NetConn *c)
+{
+    for (;;)
+    {
+        ssize_t n = recv(c->ufd, c->dgram, NET_DGRAM_MAX, 0);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (n <= DGRAM_HEADER_LEN)
+            continue;
+
+        uint32_t seq;
+        memcpy(&seq, c->dgram, sizeof(seq));
+        seq = ntohl(seq);
+        atomic_fetch_add_explicit(&c->mc_datagrams, 1, memory_order_relaxed);
+
+        if (c->mc_seen)
+        {
+            int32_t d = (int32_t)(seq - c->mc_next);
+
+            if (d < 0)
+            {
+                atomic_fetch_add_explicit(&c->mc_late, 1,
+                                          memory_order_relaxed);
+                continue;
+            }
+            if (d > 0)
+                atomic_fetch_add_explicit(&c->mc_lost, (uint64_t)d,
+                                          memory_order_relaxed);
+        }
+        c->mc_seen = TRUE;
+        c->mc_next = seq + 1;
+
+        Frame f = {FRAME_BATCH, c->dgram + DGRAM_HEADER_LEN,
+                   (uint32_t)(n - DGRAM_HEADER_LEN)};
+
+        if (c->h.on_frame)
+            c->h.on_frame(c, &f, c->user);
+    }
+}
+
+/* Returns -1 when the stream is gone or corrupt */
+static int net_receive(NetConn *c)
+{
+    ssize_t n = rx_fill(&c->rx, c->fd);
+
+    if (n == 0)
+    {
+        errno = ECONNRESET; /* peer closed; reported like a reset */
+        return -1;
+    }
+    if (n < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                   ? 0
+                   : -1;
+
+    Frame f;
+    FrameType type;
+
+    while ((type = rx_next(&c->rx, &f)) != FRAME_NONE)
+    {
+        if (type == FRAME_ERROR)
+        {
+            printf("Invalid payload size: %u\n", f.len);
+            errno = EPROTO;
+            return -1;
+        }
+
+        if (type == FRAME_MULTICAST)
+        {
+            net_join_multicast(c, &f);
+            continue;
+        }
+
+        if (c->h.on_frame)
+            c->h.on_frame(c, &f, c->user);
+    }
+
+    /* What the kernel still holds is how far behind the parser is */
+    int pending = 0;
+    if (ioctl(c->fd, FIONREAD, &pending) == 0)
+        atomic_store_explicit(&c->backlog, pending, memory_order_relaxed);
+    return 0;
+}
+
+/* Best effort: push out whatever is still queued before closing */
+static void net_drain(NetConn *c)
+{
+    int64_t deadline = now_ms() + NET_DRAIN_MS;
+
+    net_pull_queue(c);
+
+    while (c->out_len > 0 && now_ms() < deadline)
+    {
+        struct pollfd p = {.fd = c->fd, .events = POLLOUT};
+
+        if (poll(&p, 1, (int)(deadline - now_ms())) <= 0)
+            break;
+        if (net_flush(c) < 0)
+            break;
+        net_pull_queue(c);
+    }
+}
+
+typedef enum
+{
+    NET_STOPPED,        /* net_close() */
+    NET_CONNECT_FAILED, /* never got through */
+    NET_LOST            /* was connected */
+} NetEnd;
+
+/* One connect attempt and, if it succeeds, the session until it ends */
+static NetEnd net_session(NetConn *c, int *err)
+{
+    int64_t deadline = now_ms() + c->timeout_ms;
+
+    *err = 0;
+
+    if (connect(c->fd, (struct sockaddr *)&c->addr, sizeof(c->addr)) < 0 &&
+        errno != EINPROGRESS)
+    {
+        *err = errno;
+        return NET_CONNECT_FAILED;
+    }
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLOUT;
+    ev.data.fd = c->fd;
+    epoll_ctl(c->epfd, EPOLL_CTL_ADD, c->fd, &ev);
+
+    while (atomic_load(&c->running))
+    {
+        int wait_ms = -1;
+
+        if (!c->connected)
+        {
+            wait_ms = (int)(deadline - now_ms());
+            if (wait_ms <= 0)
+            {
+                *err = ETIMEDOUT;
+                return NET_CONNECT_FAILED;
+            }
+        }
+
+        struct epoll_event events[3];
+        int n = epoll_wait(c->epfd, events, 3, wait_ms);
+
+        if (n < 0 && errno != EINTR)
+        {
+            *err = errno;
+            return NET_LOST;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (events[i].data.fd == c->wakefd)
+            {
+                uint64_t v;
+                if (read(c->wakefd, &v, sizeof(v)) < 0 && errno != EAGAIN)
+                    *err = errno;
+                continue;
+            }
+
+            if (events[i].data.fd == c->ufd)
+            {
+                net_receive_datagrams(c);
+                continue;
+            }
+
+            uint32_t e = events[i].events;
+
+            if (!c->connected)
+            {
+                int soerr = 0;
+                socklen_t len = sizeof(soerr);
+
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &soerr, &len);
+                if (soerr != 0)
+                {
+                    *err = soerr;
+                    return NET_CONNECT_FAILED;
+                }
+
+                c->connected = TRUE;
+                net_emit(c, NET_EV_CONNECTED, 0);
+                continue;
+            }
+
+            if ((e & EPOLLIN) && net_receive(c) < 0)
+            {
+                *err = errno;
+                goto lost;
+            }
+
+            /* No call failed here, errno says nothing: ask the socket */
+            if ((e & (EPOLLERR | EPOLLHUP)) && !(e & EPOLLIN))
+            {
+                int soerr = 0;
+                socklen_t len = sizeof(soerr);
+
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &soerr, &len);
+                *err = soerr ? soerr : ECONNRESET;
+                goto lost;
+            }
+        }
+
+        if (c->connected)
+        {
+            net_pull_queue(c);
+            if (net_flush(c) < 0)
+            {
+                *err = errno;
+                goto lost;
+            }
+            net_watch(c);
+        }
+    }
+
+    /* Closed on request */
+    if (c->connected && atomic_load(&c->drain))
+        net_drain(c);
+    return NET_STOPPED;
+
+lost:
+    return NET_LOST;
+}
+
+/*
+ * Fresh socket for the next attempt. Whatever was queued or half
+ * received belongs to the old session: the client replays its state
+ * once it is back (NET_EV_CONNECTED).
+ */
+static gboolean net_renew_socket(NetConn *c)
+{
+    epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    net_leave_multicast(c);
+
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    c->connected = FALSE;
+    c->out_len = 0;
+    rx_reset(&c->rx);
+    atomic_store(&c->backlog, 0);
+
+    pthread_mutex_lock(&c->lock);
+    c->q_count = 0;
+    pthread_mutex_unlock(&c->lock);
+
+    return c->fd >= 0;
+}
+
+/* Sleep for ms unless net_close() wakes us; FALSE if it did */
+static gboolean net_backoff(NetConn *c, int ms)
+{
+    int64_t deadline = now_ms() + ms;
+    int left;
+
+    while (atomic_load(&c->running) && (left = (int)(deadline - now_ms())) > 0)
+    {
+        struct pollfd p = {.fd = c->wakefd, .events = POLLIN};
+        uint64_t v;
+
+        if (poll(&p, 1, left) > 0 && read(c->wakefd, &v, sizeof(v)) < 0 &&
+            errno != EAGAIN)
+            break;
+    }
+    return atomic_load(&c->running);
+}
+
+static void *net_io_thread(void *arg)
+{
+    NetConn *c = arg;
+    gboolean was_connected = FALSE;
+    int backoff_ms = NET_BACKOFF_MIN_MS;
+    int err;
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.fd = c->wakefd;
+    epoll_ctl(c->epfd, EPOLL_CTL_ADD, c->wakefd, &ev);
+
+    for (;;)
+    {
+        NetEnd end = net_session(c, &err);
+
+        if (end == NET_STOPPED)
+            return NULL;
+
+        if (end == NET_LOST)
+        {
+            /* The first failure of a session reports it; retries don't */
+            if (!atomic_load(&c->reconnect))
+            {
+                net_emit(c, NET_EV_CLOSED, err);
+                return NULL;
+            }
+            was_connected = TRUE;
+            backoff_ms = NET_BACKOFF_MIN_MS;
+            net_emit(c, NET_EV_RECONNECTING, err);
+        }
+        else if (!was_connected)
+        {
+            net_emit(c, NET_EV_CONNECT_FAILED, err);
+            return NULL;
+        }
+
+        if (!net_backoff(c, backoff_ms))
+            return NULL;
+        backoff_ms = backoff_ms * 2 < NET_BACKOFF_MAX_MS ? backoff_ms * 2
+                                                         : NET_BACKOFF_MAX_MS;
+
+        if (!net_renew_socket(c))
+            continue;
+    }
+}
+
+NetConn *net_open(const char *ip, int port, int timeout_ms,
+                  const NetHandlers *h, void *user)
+{
+    NetConn *c = g_malloc0(sizeof(NetConn));
+
+    if (inet_pton(AF_INET, ip, &c->addr.sin_addr) != 1)
+    {
+        g_free(c);
+        return NULL;
+    }
+    c->addr.sin_family = AF_INET;
+    c->addr.sin_port = htons(port);
+
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    c->epfd = epoll_create1(EPOLL_CLOEXEC);
+    c->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    c->ufd = -1;
+
+    if (c->fd < 0 || c->epfd < 0 || c->wakefd < 0)
+    {
+        perror("net_open");
+        if (c->fd >= 0)
+            close(c->fd);
+        if (c->epfd >= 0)
+            close(c->epfd);
+        if (c->wakefd >= 0)
+            close(c->wakefd);
+        g_free(c);
+        return NULL;
+    }
+
+    c->timeout_ms = timeout_ms > 0 ? timeout_ms : DEFAULT_CONNECT_TIMEOUT_MS;
+    c->h = *h;
+    c->user = user;
+    pthread_mutex_init(&c->lock, NULL);
+    rx_init(&c->rx, RX_BUF_SIZE);
+
+    atomic_store(&c->running, 1);
+    pthread_create(&c->thread, NULL, net_io_thread, c);
+
+    return c;
+}
+
+/* Reconnect (NET_EV_RECONNECTING) instead of closing when the link drops */
+void net_set_reconnect(NetConn *c, gboolean on)
+{
+    if (c)
+        atomic_store(&c->reconnect, on ? 1 : 0);
+}
+
+/* Bytes the socket held unread after the last receive; any thread */
+int net_backlog(NetConn *c)
+{
+    return c ? atomic_load_explicit(&c->backlog, memory_order_relaxed) : 0;
+}
+
+/* Datagram counters since net_open(); any thread */
+void net_multicast_stats(NetConn *c, NetMulticastStats *st)
+{
+    memset(st, 0, sizeof(*st));
+    if (!c)
+        return;
+
+    st->joined = atomic_load(&c->mc_joined);
+    st->datagrams = atomic_load_explicit(&c->mc_datagrams,
+                                         memory_order_relaxed);
+    st->lost = atomic_load_explicit(&c->mc_lost, memory_order_relaxed);
+    st->late = atomic_load_explicit(&c->mc_late, memory_order_relaxed);
+}
+
+/* Queue a command for the I/O thread. Safe from any thread. */
+gboolean net_send(NetConn *c, const char *cmd)
+{
+    if (!c || strlen(cmd) >= NET_CMD_MAX)
+        return FALSE;
+
+    pthread_mutex_lock(&c->lock);
+
+    if (c->q_count == NET_CMD_QUEUE)
+    {
+        pthread_mutex_unlock(&c->lock);
+        return FALSE;
+    }
+
+    int slot = (c->q_head + c->q_count) % NET_CMD_QUEUE;
+    strcpy(c->queue[slot], cmd);
+    c->q_count++;
+
+    pthread_mutex_unlock(&c->lock);
+
+    uint64_t one = 1;
+    if (write(c->wakefd, &one, sizeof(one)) < 0)
+        perror("net_send");
+
+    return TRUE;
+}
+
+/*
+ * Stop the I/O thread and free the connection. With drain set, commands
+ * still queued (e.g. STOP/SHUTDOWN) are written out first, bounded by
+ * NET_DRAIN_MS. Must not be called from a handler.
+ */
+void net_close(NetConn *c, gboolean drain)
+{
+    if (!c)
+        return;
+
+    atomic_store(&c->drain, drain ? 1 : 0);
+    atomic_store(&c->running, 0);
+
+    uint64_t one = 1;
+    if (write(c->wakefd, &one, sizeof(one)) < 0)
+        perror("net_close");
+
+    pthread_join(c->thread, NULL);
+
+    close(c->fd);
+    if (c->ufd >= 0)
+        close(c->ufd);
+    close(c->epfd);
+    close(c->wakefd);
+
+    rx_free(&c->rx);
+    g_free(c->dgram);
+    pthread_mutex_destroy(&c->lock);
+    g_free(c);
+}
@@ -0,0 +1,73 @@
+#ifndef NET_H
+#define NET_H
+
+#include "proto.h"
+
+/* ---------- Gateway connection engine ----------
+ *
+ * Each NetConn owns one I/O thread running an epoll loop over the
+ * socket and a wake-up eventfd. The thread does the non-blocking
+ * connect (with timeout), receives and parses frames and performs every
+ * send; the GTK thread only queues commands and receives events, so
+ * nothing on the UI side ever blocks on the network.
+ *
+ * With net_set_reconnect() a connection that drops after it was up is
+ * not given up: the I/O thread reports NET_EV_RECONNECTING once and
+ * keeps retrying with exponential backoff (NET_BACKOFF_MIN_MS doubling
+ * up to NET_BACKOFF_MAX_MS) until it gets through, which is reported as
+ * NET_EV_CONNECTED again, or net_close() is called. Commands queued
+ * before the drop are discarded.
+ *
+ * When the gateway answers "MULTICAST\n" with a group, the I/O thread
+ * joins it (NET_EV_MULTICAST) and adds the UDP socket to the same epoll
+ * loop; its datagrams reach on_frame as ordinary FRAME_BATCH frames, the
+ * sequence header stripped and gaps counted (net_multicast_stats()).
+ * The group is left with the TCP session, so a reconnect has to ask
+ * again.
+ *
+ * Handlers run on the I/O thread; marshal to GTK with msg_post() (msgpool.h).
+ */
+#define NET_CMD_QUEUE 32
+#define NET_CMD_MAX 4096 /* SUBSCRIBE/CONFIGURE can name every channel */
+#define NET_OUT_BUF 8192
+#define NET_DRAIN_MS 1000
+#define DEFAULT_CONNECT_TIMEOUT_MS 3000
+#define NET_BACKOFF_MIN_MS 250
+#define NET_BACKOFF_MAX_MS 8000
+#define NET_MC_RCVBUF (4 * 1024 * 1024) /* bursts while the thread is busy */
+#define NET_DGRAM_MAX (DGRAM_HEADER_LEN + MAX_BATCH_BYTES)
+
+typedef enum
+{
+    NET_EV_CONNECTED,
+    NET_EV_CONNECT_FAILED, /* err = errno, ETIMEDOUT on timeout */
+    NET_EV_CLOSED,         /* peer closed, I/O error or bad frame */
+    NET_EV_RECONNECTING,   /* same, with reconnect on; err = errno */
+    NET_EV_MULTICAST       /* joined the group, or err = errno if not */
+} NetEvent;
+
+typedef struct NetConn NetConn;
+
+typedef struct
+{
+    gboolean joined;
+    uint64_t datagrams; /* received */
+    uint64_t lost;      /* sequence numbers never seen */
+    uint64_t late;      /* dropped, behind a newer one */
+} NetMulticastStats;
+
+typedef struct
+{
+    void (*on_frame)(NetConn *c, const Frame *f, void *user);
+    void (*on_event)(NetConn *c, NetEvent ev, int err, void *user);
+} NetHandlers;
+
+NetConn *net_open(const char *ip, int port, int timeout_ms,
+                  const NetHandlers *h, void *user);
+void net_set_reconnect(NetConn *c, gboolean on);
+int net_backlog(NetConn *c);
+void net_multicast_stats(NetConn *c, NetMulticastStats *st);
+gboolean net_send(NetConn *c, const char *cmd);
+void net_close(NetConn *c, gboolean drain);
+
+#endif
@@ -0,0 +1,369 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gateway.h"
+#include "msgpool.h"
+#include "perf.h"
+#include "recorder.h"
+
+/* ---------- Rates (GTK thread) ---------- */
+
+typedef struct
+{
+    uint64_t bytes, batches, samples[MAX_CHANNELS];
+} IngestCount;
+
+static struct
+{
+    int64_t t_us; /* time of the last perf_update, 0 = none yet */
+    IngestCount prev[MAX_GATEWAYS];
+
+    double bytes_s[MAX_GATEWAYS];
+    double batches_s[MAX_GATEWAYS];
+    double sample_hz[MAX_GATEWAYS][MAX_CHANNELS];
+} rates;
+
+static void ingest_count(Gateway *gw, IngestCount *out, int channels)
+{
+    IngestStats *st = &gw->stats;
+
+    out->bytes = atomic_load_explicit(&st->bytes, memory_order_relaxed);
+    out->batches = atomic_load_explicit(&st->batches, memory_order_relaxed);
+    for (int s = 0; s < channels; s++)
+        out->samples[s] =
+            atomic_load_explicit(&st->samples[s], memory_order_relaxed);
+}
+
+/* Call about once per second; rates are averaged over the elapsed time */
+void perf_update(void)
+{
+    int64_t now = g_get_monotonic_time();
+    double dt = rates.t_us ? (now - rates.t_us) / 1e6 : 0;
+    int channels = channel_count();
+
+    for (int g = 0; g < MAX_GATEWAYS; g++)
+    {
+        IngestCount cur = {0};
+        IngestCount *prev = &rates.prev[g];
+
+        ingest_count(&gateways[g], &cur, channels);
+
+        if (dt > 0)
+        {
+            rates.bytes_s[g] = (cur.bytes - prev->bytes) / dt;
+            rates.batches_s[g] = (cur.batches - prev->batches) / dt;
+            for (int s = 0; s < channels; s++)
+                rates.sample_hz[g][s] =
+                    (cur.samples[s] - prev->samples[s]) / dt;
+        }
+
+        *prev = cur;
+    }
+
+    rates.t_us = now;
+}
+
+/* ---------- Frame times (GTK thread) ---------- */
+
+static int64_t frame_us[PERF_FRAMES];
+static int frame_count = 0;
+static int frame_next = 0;
+
+void perf_frame(int64_t us)
+{
+    frame_us[frame_next] = us;
+    frame_next = (frame_next + 1) % PERF_FRAMES;
+    if (frame_count < PERF_FRAMES)
+        frame_count++;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* p50/p95/p99 of the recorded frames in ms; FALSE if there are none */
+static gboolean frame_percentiles(double out[3])
+{
+    static const int pct[3] = {50, 95, 99};
+    int64_t sorted[PERF_FRAMES];
+
+    if (frame_count == 0)
+        return FALSE;
+
+    memcpy(sorted, frame_us, frame_count * sizeof(int64_t));
+    qsort(sorted, frame_count, sizeof(int64_t), cmp_i64);
+
+    for (int i = 0; i < 3; i++)
+        out[i] = sorted[(frame_count - 1) * pct[i] / 100] / 1000.0;
+    return TRUE;
+}
+
+/* ---------- Clock offset ---------- */
+
+void clock_reset(ClockSync *c)
+{
+    atomic_store(&c->offset_us, 0);
+    atomic_store(&c->rtt_us, 0);
+    c->samples = 0;
+    c->next = 0;
+}
+
+/* NTP-style: the gateway read its clock halfway through the round trip */
+void clock_pong(ClockSync *c, int64_t sent_us, int64_t gateway_us,
+                int64_t recv_us)
+{
+    int64_t rtt = recv_us - sent_us;
+
+    if (rtt < 0)
+        return;
+
+    c->sample_offset[c->next] = gateway_us - (sent_us + recv_us) / 2;
+    c->sample_rtt[c->next] = rtt;
+    c->next = (c->next + 1) % CLOCK_SAMPLES;
+    if (c->samples < CLOCK_SAMPLES)
+        c->samples++;
+
+    int best = 0;
+    for (int i = 1; i < c->samples; i++)
+        if (c->sample_rtt[i] < c->sample_rtt[best])
+            best = i;
+
+    atomic_store(&c->offset_us, c->sample_offset[best]);
+    /* Never 0 once there is an estimate */
+    atomic_store(&c->rtt_us, c->sample_rtt[best] ? c->sample_rtt[best] : 1);
+}
+
+gboolean clock_to_local(ClockSync *c, uint64_t gateway_us, int64_t *local_us)
+{
+    if (atomic_load_explicit(&c->rtt_us, memory_order_relaxed) == 0)
+        return FALSE;
+
+    *local_us = (int64_t)gateway_us -
+                atomic_load_explicit(&c->offset_us, memory_order_relaxed);
+    return TRUE;
+}
+
+/* ---------- Latency histograms ---------- */
+
+static _Atomic uint64_t lat_hist[LAT_STAGES][LAT_BUCKETS];
+
+static const char *lat_names[LAT_STAGES] = {"net", "ring", "screen"};
+
+static int lat_bucket(uint64_t us)
+{
+    if (us < LAT_SUB)
+        return (int)us;
+
+    /* The LAT_SUB_BITS bits below the leading one pick the sub-bucket */
+    int lg = 63 - __builtin_clzll(us);
+    int b = (lg - LAT_SUB_BITS + 1) * LAT_SUB +
+            (int)((us >> (lg - LAT_SUB_BITS)) & (LAT_SUB - 1));
+
+    return b < LAT_BUCKETS ? b : LAT_BUCKETS - 1;
+}
+
+/* Upper edge of bucket b in us */
+static uint64_t lat_bucket_top(int b)
+{
+    if (b < LAT_SUB)
+        return (uint64_t)b + 1;
+
+    int lg = b / LAT_SUB + LAT_SUB_BITS - 1;
+    return (uint64_t)(LAT_SUB + b % LAT_SUB + 1) << (lg - LAT_SUB_BITS);
+}
+
+/* Safe from any thread; a negative age (offset error) counts as 0 */
+void latency_note(LatStage stage, int64_t age_us)
+{
+    int b = lat_bucket(age_us > 0 ? (uint64_t)age_us : 0);
+
+    perf_add(&lat_hist[stage][b], 1);
+}
+
+void latency_clear(void)
+{
+    for (int s = 0; s < LAT_STAGES; s++)
+        for (int b = 0; b < LAT_BUCKETS; b++)
+            atomic_store_explicit(&lat_hist[s][b], 0, memory_order_relaxed);
+}
+
+/* p50/p95/p99 of one stage in ms; FALSE if nothing was recorded */
+static gboolean lat_percentiles(LatStage stage, double out[3])
+{
+    static const int pct[3] = {50, 95, 99};
+    uint64_t counts[LAT_BUCKETS];
+    uint64_t total = 0;
+
+    for (int b = 0; b < LAT_BUCKETS; b++)
+    {
+        counts[b] = atomic_load_explicit(&lat_hist[stage][b],
+                                         memory_order_relaxed);
+        total += counts[b];
+    }
+
+    if (total == 0)
+        return FALSE;
+
+    for (int i = 0; i < 3; i++)
+    {
+        uint64_t want = (total * pct[i] + 99) / 100;
+        uint64_t seen = 0;
+        int b = 0;
+
+        while (b < LAT_BUCKETS - 1 && (seen += counts[b]) < want)
+            b++;
+        out[i] = lat_bucket_top(b) / 1000.0;
+    }
+    return TRUE;
+}
+
+/* ---------- Report ---------- */
+
+static double ring_fill(SampleRing *r)
+{
+    return r->capacity ? (double)ring_count(r) / r->capacity : 0;
+}
+
+/* Multi-line summary of every gateway plus frame times; returns length */
+int perf_report(char *buf, size_t len)
+{
+    size_t n = 0;
+
+#define OUT(...)                                                    \
+    do                                                              \
+    {                                                               \
+        if (n < len)                                                \
+        {                                                           \
+            int w = snprintf(buf + n, len - n, __VA_ARGS__);        \
+            n = (w < 0) ? len : n + (size_t)w;                      \
+        }                                                           \
+    } while (0)
+
+    buf[0] = 0;
+
+    for (int g = 0; g < gateway_count; g++)
+    {
+        Gateway *gw = &gateways[g];
+        IngestStats *st = &gw->stats;
+
+        OUT("%s: %.1f kB/s, %.0f batch/s, %" PRIu64 " out of order, "
+            "%" PRIu64 " dropped, %" PRIu64 " unsubscribed\n",
+            gw->ip, rates.bytes_s[g] / 1000.0, rates.batches_s[g],
+            atomic_load_explicit(&st->out_of_order, memory_order_relaxed),
+            atomic_load_explicit(&st->dropped, memory_order_relaxed),
+            atomic_load_explicit(&st->inactive, memory_order_relaxed));
+
+        int64_t rtt = atomic_load_explicit(&gw->clock.rtt_us,
+                                           memory_order_relaxed);
+        if (rtt)
+            OUT("  clock offset %+.3f ms, rtt %.3f ms\n",
+                atomic_load_explicit(&gw->clock.offset_us,
+                                     memory_order_relaxed) / 1000.0,
+                rtt / 1000.0);
+
+        uint64_t shed = atomic_load_explicit(&st->shed_batches,
+                                             memory_order_relaxed);
+        int backlog = net_backlog(gw->conn);
+
+        if (gw->connected || shed)
+            OUT("  lag %.1f ms, backlog %d kB, decimate 1/%d, shed %" PRIu64
+                " batches (%.1f kB)\n",
+                atomic_load_explicit(&gw->lag_us, memory_order_relaxed) /
+                    1000.0,
+                backlog / 1000, gw->decimate > 1 ? gw->decimate : 1, shed,
+                atomic_load_explicit(&st->shed_bytes, memory_order_relaxed) /
+                    1000.0);
+
+        NetMulticastStats mc;
+        net_multicast_stats(gw->conn, &mc);
+
+        if (mc.joined || mc.datagrams)
+            OUT("  multicast%s: %" PRIu64 " datagrams, %" PRIu64
+                " lost, %" PRIu64 " late\n",
+                mc.joined ? "" : " (left)", mc.datagrams, mc.lost, mc.late);
+
+        const StatsSnapshot *roll = stats_latest(&gw->rolling);
+
+        /* Channels this gateway streams or has a rate for */
+        for (int s = 0; s < channel_count(); s++)
+        {
+            SensorHistory *h = gateway_hist(gw, s);
+
+            if (!h && !gw->rate_hz[s])
+                continue;
+
+            OUT("  %-4s %6.0f / %4u Hz  ring %3.0f%%\n", channel_id(s),
+                rates.sample_hz[g][s], gw->rate_hz[s],
+                h ? ring_fill(&h->level[0]) * 100.0 : 0.0);
+
+            if (roll && roll->ch[s].n)
+            {
+                const ChannelStats *cs = &roll->ch[s];
+
+                OUT("       mean %.1f rms %.1f min %.0f max %.0f"
+                    "  dt %.0f us +- %.1f\n",
+                    cs->mean, cs->rms, cs->min, cs->max, cs->dt_us,
+                    cs->jitter_us);
+            }
+        }
+    }
+
+    if (recorder_active())
+        OUT("recorder: %" PRIu64 " frames dropped\n", recorder_dropped());
+
+    if (msg_pool_misses())
+        OUT("message pool: %" PRIu64 " messages fell back to the heap\n",
+            msg_pool_misses());
+
+    double p[3];
+    if (frame_percentiles(p))
+        OUT("frame p50 %.2f ms, p95 %.2f ms, p99 %.2f ms\n", p[0], p[1],
+            p[2]);
+
+    for (int s = 0; s < LAT_STAGES; s++)
+        if (lat_percentiles(s, p))
+            OUT("latency %-6s p50 %.1f ms, p95 %.1f ms, p99 %.1f ms\n",
+                lat_names[s], p[0], p[1], p[2]);
+
+#undef OUT
+
+    /* Drop the trailing newline */
+    if (n > len - 1)
+        n = len - 1;
+    if (n > 0 && buf[n - 1] == '\n')
+        buf[--n] = 0;
+    return (int)n;
+}
+
+/* One line for the command feedback label */
+void perf_summary(char *buf, size_t len)
+{
+    double hz = 0, bytes_s = 0;
+    uint64_t lost = 0, shed = 0;
+
+    for (int g = 0; g < gateway_count; g++)
+    {
+        IngestStats *st = &gateways[g].stats;
+
+        bytes_s += rates.bytes_s[g];
+        for (int s = 0; s < MAX_CHANNELS; s++)
+            hz += rates.sample_hz[g][s];
+        lost += atomic_load_explicit(&st->out_of_order, memory_order_relaxed) +
+                atomic_load_explicit(&st->dropped, memory_order_relaxed);
+        shed += atomic_load_explicit(&st->shed_batches, memory_order_relaxed);
+    }
+
+    double p[3];
+    if (!frame_percentiles(p))
+        p[1] = 0;
+
+    snprintf(buf, len,
+             "%d gateway(s), %.0f samples/s, %.1f kB/s, %" PRIu64
+             " dropped/out of order, %" PRIu64 " batches shed, frame p95 "
+             "%.2f ms",
+             gateway_count, hz, bytes_s / 1000.0, lost, shed, p[1]);
+}
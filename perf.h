@@ -0,0 +1,88 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "utils.h"
+
+/* ---------- Ingest / render counters ----------
+ *
+ * The I/O threads bump IngestStats with relaxed atomic adds, once per
+ * frame and channel rather than per sample. The GTK thread turns them
+ * into rates once per second (perf_update) and keeps the last
+ * PERF_FRAMES draw times for percentiles. perf_report() renders both,
+ * plus each channel's latest rolling statistics (stats.h), as text for
+ * the HUD and the STATUS command.
+ */
+#define PERF_FRAMES 256
+#define PERF_REPORT_MAX 16384
+
+typedef struct
+{
+    _Atomic uint64_t bytes;   /* frame payload bytes */
+    _Atomic uint64_t batches; /* sample batches */
+    _Atomic uint64_t samples[MAX_CHANNELS]; /* by registry index */
+    _Atomic uint64_t out_of_order; /* timestamp went backwards */
+    _Atomic uint64_t dropped;      /* wire ids not advertised */
+    _Atomic uint64_t inactive;     /* unchecked channels, not buffered */
+    _Atomic uint64_t shed_batches; /* dropped unread under overload */
+    _Atomic uint64_t shed_bytes;
+} IngestStats;
+
+static inline void perf_add(_Atomic uint64_t *c, uint64_t n)
+{
+    atomic_fetch_add_explicit(c, n, memory_order_relaxed);
+}
+
+void perf_frame(int64_t us);
+void perf_update(void);
+int perf_report(char *buf, size_t len);
+void perf_summary(char *buf, size_t len);
+
+/* ---------- Clock offset / end-to-end latency ----------
+ *
+ * A PING/PONG round trip every second gives each gateway's clock offset
+ * (gateway clock - local monotonic clock). The estimate comes from the
+ * round trip with the lowest RTT among the last CLOCK_SAMPLES, which has
+ * the least queuing error. With it a sample's gateway timestamp maps to
+ * local time, and the age of the newest sample is recorded when its
+ * batch comes off the socket (LAT_NET), once it is in the ring
+ * (LAT_RING) and when the frame showing it is presented (LAT_SCREEN).
+ *
+ * The histograms have LAT_SUB buckets per power of two of microseconds
+ * (within ~9% of the true value).
+ */
+#define CLOCK_SAMPLES 8
+#define LAT_SUB_BITS 3
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS (LAT_SUB * 40)
+
+typedef enum
+{
+    LAT_NET = 0,
+    LAT_RING,
+    LAT_SCREEN,
+    LAT_STAGES
+} LatStage;
+
+typedef struct
+{
+    _Atomic int64_t offset_us;
+    _Atomic int64_t rtt_us; /* 0 = no estimate yet */
+
+    /* Recent round trips, I/O thread only */
+    int64_t sample_offset[CLOCK_SAMPLES];
+    int64_t sample_rtt[CLOCK_SAMPLES];
+    int samples;
+    int next;
+} ClockSync;
+
+void clock_reset(ClockSync *c);
+void clock_pong(ClockSync *c, int64_t sent_us, int64_t gateway_us,
+                int64_t recv_us);
+gboolean clock_to_local(ClockSync *c, uint64_t gateway_us, int64_t *local_us);
+void latency_note(LatStage stage, int64_t age_us);
+void latency_clear(void);
+
+#endif
@@ -0,0 +1,393 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "proto.h"
+
+void rx_init(RxBuffer *rb, size_t cap)
+{
+    rb->buf = g_malloc(cap);
+    rb->cap = cap;
+    rb->start = 0;
+    rb->end = 0;
+}
+
+void rx_free(RxBuffer *rb)
+{
+    g_free(rb->buf);
+    rb->buf = NULL;
+    rb->cap = 0;
+    rb->start = rb->end = 0;
+}
+
+void rx_reset(RxBuffer *rb)
+{
+    rb->start = rb->end = 0;
+}
+
+/*
+ * Move any partial frame to the front and read as much as fits.
+ * Returns the recv() result (<= 0 on EOF or error).
+ */
+ssize_t rx_fill(RxBuffer *rb, int fd)
+{
+    if (rb->start > 0)
+    {
+        size_t left = rb->end - rb->start;
+        memmove(rb->buf, rb->buf + rb->start, left);
+        rb->start = 0;
+        rb->end = left;
+    }
+
+    if (rb->end == rb->cap)
+    {
+        errno = EMSGSIZE; /* a frame larger than the buffer */
+        return -1;
+    }
+
+    ssize_t n;
+    do
+    {
+        n = recv(fd, rb->buf + rb->end, rb->cap - rb->end, 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0)
+        rb->end += n;
+
+    return n;
+}
+
+/* A short text line whose magic (magic_len bytes) is at the front */
+static FrameType rx_text_line(RxBuffer *rb, Frame *f, size_t magic_len,
+                              size_t max_len, FrameType type)
+{
+    size_t avail = rb->end - rb->start;
+    const unsigned char *p = rb->buf + rb->start;
+    const unsigned char *nl = memchr(p, '\n', avail);
+
+    if (!nl)
+    {
+        if (avail >= max_len)
+        {
+            f->type = FRAME_ERROR;
+            f->data = NULL;
+            f->len = (uint32_t)avail;
+            return FRAME_ERROR;
+        }
+        return FRAME_NONE;
+    }
+
+    f->type = type;
+    f->data = p + magic_len;
+    f->len = (uint32_t)(nl - f->data);
+    rb->start += (nl - p) + 1;
+    return type;
+}
+
+static FrameType rx_error(Frame *f, uint32_t len)
+{
+    f->type = FRAME_ERROR;
+    f->data = NULL;
+    f->len = len;
+    return FRAME_ERROR;
+}
+
+/* "RATES\n" (SENSOR_COUNT entries) or "RATES <n>\n", then the entries */
+static FrameType rx_rates(RxBuffer *rb, Frame *f)
+{
+    size_t avail = rb->end - rb->start;
+    const unsigned char *p = rb->buf + rb->start;
+    size_t header = RATES_MAGIC_LEN;
+    unsigned long count = SENSOR_COUNT;
+
+    if (avail <= RATES_PREFIX_LEN)
+        return FRAME_NONE;
+
+    if (p[RATES_PREFIX_LEN] == ' ')
+    {
+        size_t scan = avail < RATES_HEADER_MAX ? avail : RATES_HEADER_MAX;
+        const unsigned char *nl = memchr(p, '\n', scan);
+        char num[RATES_HEADER_MAX];
+        char *end;
+
+        if (!nl)
+            return avail < RATES_HEADER_MAX ? FRAME_NONE
+                                             : rx_error(f, (uint32_t)avail);
+
+        header = (size_t)(nl - p) + 1;
+        memcpy(num, p + RATES_PREFIX_LEN + 1, header - RATES_PREFIX_LEN - 2);
+        num[header - RATES_PREFIX_LEN - 2] = 0;
+
+        count = strtoul(num, &end, 10);
+        if (end == num || *end || count == 0 || count > MAX_CHANNELS)
+            return rx_error(f, (uint32_t)avail);
+    }
+    else if (p[RATES_PREFIX_LEN] != '\n')
+        return rx_error(f, (uint32_t)avail);
+
+    size_t need = header + sizeof(sensor_rate_t) * count;
+    if (avail < need)
+        return FRAME_NONE;
+
+    f->type = FRAME_RATES;
+    f->data = p + header;
+    f->len = (uint32_t)(need - header);
+    rb->start += need;
+    return FRAME_RATES;
+}
+
+/* Parse the next complete frame without copying its payload. */
+FrameType rx_next(RxBuffer *rb, Frame *f)
+{
+    size_t avail = rb->end - rb->start;
+    const unsigned char *p = rb->buf + rb->start;
+
+    if (avail == 0)
+        return FRAME_NONE;
+
+    /* RATES header (may still be arriving) */
+    size_t cmp = avail < RATES_PREFIX_LEN ? avail : RATES_PREFIX_LEN;
+    if (memcmp(p, RATES_MAGIC, cmp) == 0)
+        return rx_rates(rb, f);
+
+    /* FORMAT acknowledgement, PONG and CHANNELS: text lines */
+    static const struct
+    {
+        const char *magic;
+        size_t len, max;
+        FrameType type;
+    } lines[] = {
+        {FORMAT_MAGIC, FORMAT_MAGIC_LEN, FORMAT_MAX_LEN, FRAME_FORMAT},
+        {PONG_MAGIC, PONG_MAGIC_LEN, PONG_MAX_LEN, FRAME_PONG},
+        {CHANNELS_MAGIC, CHANNELS_MAGIC_LEN, CHANNELS_MAX_LEN, FRAME_CHANNELS},
+        {MULTICAST_MAGIC, MULTICAST_MAGIC_LEN, MULTICAST_MAX_LEN,
+         FRAME_MULTICAST},
+    };
+
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++)
+    {
+        size_t cmp_len = avail < lines[i].len ? avail : lines[i].len;
+
+        if (memcmp(p, lines[i].magic, cmp_len) != 0)
+            continue;
+
+        return rx_text_line(rb, f, lines[i].len, lines[i].max,
+                            lines[i].type);
+    }
+
+    /* Length-prefixed batch */
+    if (avail < sizeof(uint32_t))
+        return FRAME_NONE;
+
+    uint32_t net_size;
+    memcpy(&net_size, p, sizeof(net_size));
+    uint32_t payload_size = ntohl(net_size);
+
+    if (payload_size == 0 || payload_size > MAX_BATCH_BYTES)
+        return rx_error(f, payload_size);
+
+    if (avail < sizeof(uint32_t) + payload_size)
+        return FRAME_NONE;
+
+    f->type = FRAME_BATCH;
+    f->data = p + sizeof(uint32_t);
+    f->len = payload_size;
+    rb->start += sizeof(uint32_t) + payload_size;
+    return FRAME_BATCH;
+}
+
+static uint64_t get_le(const unsigned char *p, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+void frame_cursor_init(FrameCursor *cur, const Frame *f, WireFormat fmt)
+{
+    cur->p = f->data;
+    cur->end = f->data + f->len;
+    cur->fmt = fmt;
+    cur->ts = 0;
+
+    if (fmt == WIRE_PACKED)
+    {
+        if (f->len < sizeof(uint64_t))
+        {
+            cur->p = cur->end;
+            return;
+        }
+        cur->ts = get_le(cur->p, sizeof(uint64_t));
+        cur->p += sizeof(uint64_t);
+    }
+}
+
+/* FALSE at the end of the batch, or on a truncated packed sample */
+gboolean frame_cursor_next(FrameCursor *cur, sensor_data_t *out)
+{
+    if (cur->fmt == WIRE_LEGACY)
+    {
+        if ((size_t)(cur->end - cur->p) < sizeof(sensor_data_t))
+            return FALSE;
+
+        /* Samples are not necessarily aligned inside the receive buffer */
+        memcpy(out, cur->p, sizeof(sensor_data_t));
+        cur->p += sizeof(sensor_data_t);
+        return TRUE;
+    }
+
+    const unsigned char *p = cur->p;
+
+    if (p >= cur->end)
+        return FALSE;
+
+    unsigned int sid = *p++;
+
+    /* LEB128 timestamp delta */
+    uint64_t delta = 0;
+    int shift = 0;
+    for (;;)
+    {
+        if (p >= cur->end || shift > 63)
+            return FALSE;
+
+        unsigned char b = *p++;
+        delta |= (uint64_t)(b & 0x7F) << shift;
+        shift += 7;
+
+        if (!(b & 0x80))
+            break;
+    }
+
+    if (cur->end - p < 2)
+        return FALSE;
+
+    cur->ts += delta;
+    out->sensor_id = (sensor_id_t)sid;
+    out->sensor_value = (unsigned int)get_le(p, 2);
+    out->timestamp = cur->ts;
+
+    cur->p = p + 2;
+    return TRUE;
+}
+
+/* Copies up to max entries; returns how many */
+int frame_rates(const Frame *f, sensor_rate_t *out, int max)
+{
+    int n = (int)(f->len / sizeof(sensor_rate_t));
+
+    if (n > max)
+        n = max;
+    memcpy(out, f->data, sizeof(sensor_rate_t) * n);
+    return n;
+}
+
+WireFormat frame_format(const Frame *f)
+{
+    if (f->len == 6 && memcmp(f->data, "PACKED", 6) == 0)
+        return WIRE_PACKED;
+    return WIRE_LEGACY;
+}
+
+gboolean frame_pong(const Frame *f, int64_t *echo, int64_t *gateway_us)
+{
+    char line[PONG_MAX_LEN];
+    char *end;
+
+    if (f->len >= sizeof(line))
+        return FALSE;
+
+    memcpy(line, f->data, f->len);
+    line[f->len] = 0;
+
+    *echo = strtoll(line, &end, 10);
+    if (end == line || *end != ' ')
+        return FALSE;
+
+    *gateway_us = strtoll(end + 1, &end, 10);
+    return *end == 0;
+}
+
+/* "<group> <port>" of a MULTICAST reply */
+gboolean frame_multicast(const Frame *f, char *group, size_t len, int *port)
+{
+    char line[MULTICAST_MAX_LEN];
+    char *sp, *end;
+
+    if (f->len >= sizeof(line))
+        return FALSE;
+
+    memcpy(line, f->data, f->len);
+    line[f->len] = 0;
+
+    sp = strchr(line, ' ');
+    if (!sp || (size_t)(sp - line) >= len)
+        return FALSE;
+
+    *sp = 0;
+    g_strlcpy(group, line, len);
+
+    long p = strtol(sp + 1, &end, 10);
+    if (end == sp + 1 || *end || p <= 0 || p > 65535)
+        return FALSE;
+
+    *port = (int)p;
+    return TRUE;
+}
+
+/* "id[:label[:max]]"; leaves d->id empty if the id is unusable */
+static void parse_channel(char *e, ChannelDesc *d)
+{
+    char *label = strchr(e, ':');
+    char *max_s = label ? strchr(label + 1, ':') : NULL;
+
+    memset(d, 0, sizeof(*d));
+
+    if (label)
+        *label++ = 0;
+    if (max_s)
+    {
+        *max_s++ = 0;
+        d->y_max = g_ascii_strtod(max_s, NULL);
+    }
+
+    /* Ids are command tokens: no blanks, must fit */
+    g_strstrip(e);
+    if (!*e || strlen(e) >= CHANNEL_ID_LEN || strpbrk(e, " \t"))
+        return;
+
+    g_strlcpy(d->id, e, sizeof(d->id));
+    if (label)
+        g_strlcpy(d->label, g_strstrip(label), sizeof(d->label));
+}
+
+/*
+ * Entries in wire id order; returns how many (at most max). An entry
+ * with a malformed id keeps its position with an empty id, so the ids
+ * after it still line up.
+ */
+int frame_channels(const Frame *f, ChannelDesc *out, int max)
+{
+    char line[CHANNELS_MAX_LEN];
+    char *e = line;
+    int n = 0;
+
+    if (f->len >= sizeof(line))
+        return 0;
+
+    memcpy(line, f->data, f->len);
+    line[f->len] = 0;
+
+    while (e && n < max)
+    {
+        char *next = strchr(e, ',');
+
+        if (next)
+            *next++ = 0;
+        parse_channel(e, &out[n++]);
+        e = next;
+    }
+
+    return n;
+}
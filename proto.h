@@ -0,0 +1,149 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "channels.h"
+#include "utils.h"
+
+/* ---------- Gateway stream protocol ----------
+ *
+ * The gateway sends these frames on the TCP stream:
+ *
+ *   "CHANNELS <id>:<label>:<max>,...\n" (on connect, optional)
+ *   "RATES\n" + sensor_rate_t[SENSOR_COUNT]
+ *   "RATES <n>\n" + sensor_rate_t[n]
+ *   "FORMAT <LEGACY|PACKED>\n"  (reply to our FORMAT request)
+ *   "PONG <echo> <gateway_us>\n" (reply to our "PING <echo>\n")
+ *   "MULTICAST <group> <port>\n" (reply to our "MULTICAST\n", optional)
+ *   uint32 payload length (network order) + batch payload
+ *
+ * The batch payload is sensor_data_t[] in the gateway's host layout
+ * (WIRE_LEGACY) unless the gateway acknowledged "FORMAT PACKED", after
+ * which it is (all little-endian):
+ *
+ *   uint64 base timestamp
+ *   repeated { uint8 sensor id, varint ts delta, uint16 value }
+ *
+ * where each delta is relative to the previous sample (the first one to
+ * the base). That is 4-5 bytes per sample instead of 16.
+ *
+ * CHANNELS lists the gateway's channels in wire id order: the n-th
+ * entry is sensor id n in batches and RATES. Label and max (full-scale
+ * raw value) may be left out, e.g. "CHANNELS ADC0,ADC1:Probe 1:1023".
+ * Gateways that don't send it have the SENSOR_COUNT built-in sensors
+ * and the fixed-size RATES.
+ *
+ * Besides the operator's commands we send "FORMAT PACKED", "PING <echo>"
+ * and "SUBSCRIBE <id> ..." / "UNSUBSCRIBE <id> ..." (channel ids as in
+ * CONFIGURE) to stop or resume streaming channels nobody is watching.
+ * When we fall behind, "DECIMATE <id> <n> [<id> <n> ...]" asks for only
+ * every n-th sample of those channels (1 = all of them) without changing
+ * the configured rate, so no RATES follows. A new connection streams
+ * every channel undecimated; gateways may ignore all four.
+ *
+ * MULTICAST moves the batches to UDP so any number of clients cost the
+ * gateway one stream: after the reply they are sent to <group>:<port>
+ * (an IPv4 group, or a unicast address for a single receiver) as
+ * datagrams of
+ *
+ *   uint32 sequence number (network order) + batch payload (packed)
+ *
+ * and no longer on the TCP stream, which carries everything else
+ * (CHANNELS, RATES, FORMAT, PONG) and all our commands. We only ask after
+ * "FORMAT PACKED" was acknowledged, since all receivers share the
+ * datagrams. The sequence number counts datagrams on the group, so gaps
+ * show loss; a datagram older than one already seen is dropped.
+ * "MULTICAST OFF" goes back to batches on the TCP stream. The gateway
+ * streams the group while any of its clients has sent START, and keeps
+ * every channel in it: SUBSCRIBE and DECIMATE only apply to TCP
+ * streams, the client drops what it doesn't show.
+ *
+ * PONG carries our PING token back plus the gateway's clock (the time
+ * base of the sample timestamps, in us) when it answered; see
+ * clock_pong() for the offset estimate.
+ *
+ * RxBuffer pulls large chunks from the socket and frames are parsed out
+ * of it in place, so one recv() typically yields many batches.
+ */
+#define RX_BUF_SIZE (64 * 1024)
+#define RATES_MAGIC "RATES\n"
+#define RATES_MAGIC_LEN 6
+#define RATES_COUNT_MAGIC "RATES "
+#define RATES_PREFIX_LEN 5 /* "RATES", common to both headers */
+#define RATES_HEADER_MAX 16
+#define MAX_BATCH_BYTES (RX_BUF_SIZE - sizeof(uint32_t))
+#define FORMAT_MAGIC "FORMAT "
+#define FORMAT_MAGIC_LEN 7
+#define FORMAT_MAX_LEN 32
+#define PONG_MAGIC "PONG "
+#define PONG_MAGIC_LEN 5
+#define PONG_MAX_LEN 64
+#define CHANNELS_MAGIC "CHANNELS "
+#define CHANNELS_MAGIC_LEN 9
+#define CHANNELS_MAX_LEN (MAX_CHANNELS * 64)
+#define MULTICAST_MAGIC "MULTICAST "
+#define MULTICAST_MAGIC_LEN 10
+#define MULTICAST_MAX_LEN 64
+#define DGRAM_HEADER_LEN 4 /* sequence number */
+
+typedef enum
+{
+    WIRE_LEGACY = 0,
+    WIRE_PACKED
+} WireFormat;
+
+typedef enum
+{
+    FRAME_NONE = 0, /* need more bytes */
+    FRAME_RATES,
+    FRAME_FORMAT, /* data/len: the format word, e.g. "PACKED" */
+    FRAME_BATCH,
+    FRAME_ERROR,
+    FRAME_PONG, /* data/len: "<echo> <gateway_us>"; after the others since
+                   recordings store these values */
+    FRAME_CHANNELS, /* data/len: the channel list */
+    FRAME_MULTICAST /* data/len: "<group> <port>", handled by NetConn */
+} FrameType;
+
+typedef struct
+{
+    FrameType type;
+    const unsigned char *data; /* points into the RxBuffer */
+    uint32_t len;
+} Frame;
+
+typedef struct
+{
+    unsigned char *buf;
+    size_t cap;
+    size_t start; /* first unparsed byte */
+    size_t end;   /* one past the last received byte */
+} RxBuffer;
+
+void rx_init(RxBuffer *rb, size_t cap);
+void rx_free(RxBuffer *rb);
+void rx_reset(RxBuffer *rb);
+ssize_t rx_fill(RxBuffer *rb, int fd);
+FrameType rx_next(RxBuffer *rb, Frame *f);
+
+/* Walks the samples of a FRAME_BATCH in either wire format */
+typedef struct
+{
+    const unsigned char *p;
+    const unsigned char *end;
+    WireFormat fmt;
+    uint64_t ts;
+} FrameCursor;
+
+void frame_cursor_init(FrameCursor *cur, const Frame *f, WireFormat fmt);
+gboolean frame_cursor_next(FrameCursor *cur, sensor_data_t *out);
+int frame_rates(const Frame *f, sensor_rate_t *out, int max);
+WireFormat frame_format(const Frame *f);
+gboolean frame_pong(const Frame *f, int64_t *echo, int64_t *gateway_us);
+int frame_channels(const Frame *f, ChannelDesc *out, int max);
+gboolean frame_multicast(const Frame *f, char *group, size_t len, int *port);
+
+#endif
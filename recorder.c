@@ -0,0 +1,722 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "recorder.h"
+
+/* ---------- Recording ---------- */
+
+typedef struct
+{
+    unsigned char data[REC_CHUNK_BYTES];
+    size_t used;
+    int64_t first_t;
+    int64_t last_t;
+    uint32_t records;
+} RecChunk;
+
+static struct
+{
+    atomic_int active;
+    atomic_uint session; /* bumped per recording */
+    atomic_uint_fast64_t dropped;
+
+    int fd;
+    pthread_t writer;
+    int running;
+
+    /* Guarded by lock */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    RecChunk *pool[REC_CHUNK_POOL];
+    RecChunk *free_list[REC_CHUNK_POOL];
+    int free_count;
+    RecChunk *full[REC_CHUNK_POOL];
+    int full_head;
+    int full_count;
+    RecChunk *cur;
+
+    /* Writer thread only */
+    uint64_t offset;
+    gboolean failed; /* the file could not be cut back after an error */
+    RecIndexEntry *index;
+    size_t index_count;
+    size_t index_cap;
+} rec = {.fd = -1,
+         .lock = PTHREAD_MUTEX_INITIALIZER,
+         .cond = PTHREAD_COND_INITIALIZER};
+
+static gboolean write_all(int fd, const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return TRUE;
+}
+
+static void write_chunk(RecChunk *ch)
+{
+    RecChunkHeader hdr = {
+        .magic = REC_CHUNK_MAGIC,
+        .bytes = (uint32_t)ch->used,
+        .first_t = ch->first_t,
+        .last_t = ch->last_t,
+        .records = ch->records,
+    };
+
+    if (rec.failed)
+    {
+        atomic_fetch_add(&rec.dropped, ch->records);
+        return;
+    }
+
+    if (!write_all(rec.fd, &hdr, sizeof(hdr)) ||
+        !write_all(rec.fd, ch->data, ch->used))
+    {
+        perror("[GUI] recorder write");
+        atomic_fetch_add(&rec.dropped, ch->records);
+
+        /* Cut off what got out of the chunk, so the index offsets stay
+           right. If that fails too, nothing more is written and the file
+           ends without an index (replay walks the chunks instead). */
+        if (ftruncate(rec.fd, (off_t)rec.offset) != 0 ||
+            lseek(rec.fd, (off_t)rec.offset, SEEK_SET) < 0)
+        {
+            perror("[GUI] recorder truncate");
+            rec.failed = TRUE;
+        }
+        return;
+    }
+
+    if (rec.index_count == rec.index_cap)
+    {
+        rec.index_cap = rec.index_cap ? rec.index_cap * 2 : 256;
+        rec.index = g_realloc(rec.index,
+                              rec.index_cap * sizeof(RecIndexEntry));
+    }
+    rec.index[rec.index_count].offset = rec.offset;
+    rec.index[rec.index_count].first_t = ch->first_t;
+    rec.index_count++;
+
+    rec.offset += sizeof(hdr) + ch->used;
+}
+
+static void *writer_thread(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&rec.lock);
+    for (;;)
+    {
+        while (rec.full_count == 0 && rec.running)
+            pthread_cond_wait(&rec.cond, &rec.lock);
+
+        if (rec.full_count == 0)
+            break;
+
+        RecChunk *ch = rec.full[rec.full_head];
+        rec.full_head = (rec.full_head + 1) % REC_CHUNK_POOL;
+        rec.full_count--;
+        pthread_mutex_unlock(&rec.lock);
+
+        write_chunk(ch);
+
+        pthread_mutex_lock(&rec.lock);
+        ch->used = 0;
+        ch->records = 0;
+        rec.free_list[rec.free_count++] = ch;
+    }
+    pthread_mutex_unlock(&rec.lock);
+
+    if (rec.failed)
+        return NULL;
+
+    RecFooter footer = {
+        .magic = REC_FOOTER_MAGIC,
+        .index_offset = rec.offset,
+        .index_count = rec.index_count,
+    };
+
+    if (!write_all(rec.fd, rec.index, rec.index_count * sizeof(RecIndexEntry)) ||
+        !write_all(rec.fd, &footer, sizeof(footer)))
+        perror("[GUI] recorder index");
+
+    return NULL;
+}
+
+/* Caller holds rec.lock */
+static void chunk_put(RecChunk *ch, uint8_t type, int gateway,
+                      WireFormat wire, const void *data, uint32_t len,
+                      int64_t t)
+{
+    RecRecordHeader rh = {
+        .type = type,
+        .gateway = (uint8_t)gateway,
+        .wire = (uint8_t)wire,
+        .len = len,
+        .t_us = t,
+    };
+
+    if (ch->records == 0)
+        ch->first_t = t;
+    ch->last_t = t;
+    ch->records++;
+
+    memcpy(ch->data + ch->used, &rh, sizeof(rh));
+    memcpy(ch->data + ch->used + sizeof(rh), data, len);
+    memset(ch->data + ch->used + sizeof(rh) + len, 0, REC_ALIGN(len) - len);
+    ch->used += sizeof(rh) + REC_ALIGN(len);
+}
+
+/* Caller holds rec.lock. Hands the current chunk to the writer and
+ * starts a fresh one with a wall-clock marker. */
+static gboolean chunk_rotate(int64_t t)
+{
+    if (rec.cur && rec.cur->used > 0)
+    {
+        int tail = (rec.full_head + rec.full_count) % REC_CHUNK_POOL;
+        rec.full[tail] = rec.cur;
+        rec.full_count++;
+        rec.cur = NULL;
+        pthread_cond_signal(&rec.cond);
+    }
+
+    if (!rec.cur)
+    {
+        if (rec.free_count == 0)
+            return FALSE;
+        rec.cur = rec.free_list[--rec.free_count];
+    }
+
+    int64_t wall = g_get_real_time();
+    chunk_put(rec.cur, REC_WALLCLOCK, 0, WIRE_LEGACY, &wall, sizeof(wall), t);
+    return TRUE;
+}
+
+gboolean recorder_start(const char *path)
+{
+    if (atomic_load(&rec.active))
+        return FALSE;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror("[GUI] recorder open");
+        return FALSE;
+    }
+
+    RecFileHeader fh = {.magic = REC_MAGIC, .version = REC_VERSION};
+    if (!write_all(fd, &fh, sizeof(fh)))
+    {
+        perror("[GUI] recorder header");
+        close(fd);
+        return FALSE;
+    }
+
+    /* The chunk pool is allocated once and kept for later recordings */
+    if (!rec.pool[0])
+    {
+        for (int i = 0; i < REC_CHUNK_POOL; i++)
+            rec.pool[i] = g_malloc0(sizeof(RecChunk));
+    }
+
+    rec.fd = fd;
+    rec.offset = sizeof(fh);
+    rec.failed = FALSE;
+    rec.index_count = 0;
+    rec.full_head = 0;
+    rec.full_count = 0;
+    rec.free_count = 0;
+    for (int i = 0; i < REC_CHUNK_POOL; i++)
+    {
+        rec.pool[i]->used = 0;
+        rec.pool[i]->records = 0;
+        rec.free_list[rec.free_count++] = rec.pool[i];
+    }
+    rec.cur = NULL;
+    chunk_rotate(g_get_monotonic_time());
+
+    rec.running = 1;
+    atomic_store(&rec.dropped, 0);
+    if (pthread_create(&rec.writer, NULL, writer_thread, NULL) != 0)
+    {
+        fprintf(stderr, "[GUI] recorder: cannot start the writer thread\n");
+        rec.running = 0;
+        rec.cur = NULL;
+        close(rec.fd);
+        rec.fd = -1;
+        return FALSE;
+    }
+    atomic_fetch_add(&rec.session, 1);
+    atomic_store(&rec.active, 1);
+
+    printf("[GUI] Recording to %s\n", path);
+    return TRUE;
+}
+
+void recorder_stop(void)
+{
+    if (!atomic_exchange(&rec.active, 0))
+        return;
+
+    pthread_mutex_lock(&rec.lock);
+    if (rec.cur && rec.cur->used > 0)
+    {
+        int tail = (rec.full_head + rec.full_count) % REC_CHUNK_POOL;
+        rec.full[tail] = rec.cur;
+        rec.full_count++;
+    }
+    rec.cur = NULL;
+    rec.running = 0;
+    pthread_cond_signal(&rec.cond);
+    pthread_mutex_unlock(&rec.lock);
+
+    pthread_join(rec.writer, NULL);
+    close(rec.fd);
+    rec.fd = -1;
+
+    printf("[GUI] Recording stopped (%zu chunks, %llu frames dropped)\n",
+           rec.index_count, (unsigned long long)atomic_load(&rec.dropped));
+}
+
+gboolean recorder_active(void)
+{
+    return atomic_load_explicit(&rec.active, memory_order_relaxed);
+}
+
+/* Changes with every recorder_start(), e.g. to repeat per-file headers */
+unsigned recorder_session(void)
+{
+    return atomic_load(&rec.session);
+}
+
+uint64_t recorder_dropped(void)
+{
+    return atomic_load(&rec.dropped);
+}
+
+/* I/O threads: never touches the disk, at worst drops the frame */
+void recorder_append(int gateway, WireFormat wire, const Frame *f)
+{
+    size_t need = sizeof(RecRecordHeader) + REC_ALIGN(f->len);
+    int64_t t = g_get_monotonic_time();
+
+    if (need + sizeof(RecRecordHeader) + sizeof(int64_t) > REC_CHUNK_BYTES)
+    {
+        atomic_fetch_add(&rec.dropped, 1);
+        return;
+    }
+
+    pthread_mutex_lock(&rec.lock);
+    if (atomic_load(&rec.active))
+    {
+        if ((!rec.cur || rec.cur->used + need > REC_CHUNK_BYTES) &&
+            !chunk_rotate(t))
+            atomic_fetch_add(&rec.dropped, 1);
+        else
+            chunk_put(rec.cur, (uint8_t)f->type, gateway, wire,
+                      f->data, f->len, t);
+    }
+    pthread_mutex_unlock(&rec.lock);
+}
+
+/* ---------- Replay ---------- */
+
+struct Replay
+{
+    unsigned char *map;
+    size_t size;
+
+    RecIndexEntry *index;
+    size_t index_count;
+    int64_t t_first;
+    int64_t t_last;
+    int gateways;
+
+    ReplayHandlers h;
+    void *user;
+
+    pthread_t thread;
+    gboolean started;
+    atomic_int running;
+
+    /* Requests from the GUI thread, picked up by the replay thread */
+    _Atomic int64_t seek_to; /* absolute recording time, -1 if none */
+    _Atomic int64_t seek_lead;
+    _Atomic double speed;
+    atomic_int speed_changed;
+};
+
+static gboolean chunk_valid(const Replay *r, uint64_t off,
+                            const RecChunkHeader **out)
+{
+    if (off + sizeof(RecChunkHeader) > r->size)
+        return FALSE;
+
+    const RecChunkHeader *ch = (const RecChunkHeader *)(r->map + off);
+    if (ch->magic != REC_CHUNK_MAGIC ||
+        off + sizeof(*ch) + ch->bytes > r->size)
+        return FALSE;
+
+    *out = ch;
+    return TRUE;
+}
+
+/* Used when the footer is missing: walk the chunk headers */
+static void replay_scan_index(Replay *r)
+{
+    size_t cap = 0;
+    uint64_t off = sizeof(RecFileHeader);
+    const RecChunkHeader *ch;
+
+    while (chunk_valid(r, off, &ch))
+    {
+        if (r->index_count == cap)
+        {
+            cap = cap ? cap * 2 : 256;
+            r->index = g_realloc(r->index, cap * sizeof(RecIndexEntry));
+        }
+        r->index[r->index_count].offset = off;
+        r->index[r->index_count].first_t = ch->first_t;
+        r->index_count++;
+        off += sizeof(*ch) + ch->bytes;
+    }
+}
+
+static gboolean replay_load_index(Replay *r)
+{
+    if (r->size < sizeof(RecFileHeader) + sizeof(RecFooter))
+        return FALSE;
+
+    /* Copied out: a truncated file leaves the tail unaligned */
+    RecFooter ft;
+    memcpy(&ft, r->map + r->size - sizeof(ft), sizeof(ft));
+
+    if (memcmp(ft.magic, REC_FOOTER_MAGIC, sizeof(ft.magic)) != 0 ||
+        ft.index_count > r->size / sizeof(RecIndexEntry) ||
+        ft.index_offset + ft.index_count * sizeof(RecIndexEntry) >
+            r->size - sizeof(ft))
+        return FALSE;
+
+    r->index_count = ft.index_count;
+    r->index = g_malloc(r->index_count * sizeof(RecIndexEntry));
+    memcpy(r->index, r->map + ft.index_offset,
+           r->index_count * sizeof(RecIndexEntry));
+    return TRUE;
+}
+
+Replay *replay_open(const char *path, const ReplayHandlers *h, void *user)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("[GUI] replay open");
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(RecFileHeader))
+    {
+        fprintf(stderr, "[GUI] %s: not a recording\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("[GUI] replay mmap");
+        return NULL;
+    }
+
+    const RecFileHeader *fh = map;
+    if (memcmp(fh->magic, REC_MAGIC, sizeof(fh->magic)) != 0 ||
+        fh->version != REC_VERSION)
+    {
+        fprintf(stderr, "[GUI] %s: not a recording\n", path);
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    Replay *r = g_new0(Replay, 1);
+    r->map = map;
+    r->size = (size_t)st.st_size;
+    if (h)
+        r->h = *h;
+    r->user = user;
+    atomic_store(&r->seek_to, -1);
+    atomic_store(&r->speed, 1.0);
+
+    if (!replay_load_index(r))
+    {
+        printf("[GUI] %s has no index, scanning chunks\n", path);
+        replay_scan_index(r);
+    }
+
+    if (r->index_count == 0)
+    {
+        fprintf(stderr, "[GUI] %s: empty recording\n", path);
+        replay_close(r);
+        return NULL;
+    }
+
+    /* Time span and number of gateways recorded */
+    r->t_first = r->index[0].first_t;
+    for (size_t i = 0; i < r->index_count; i++)
+    {
+        const RecChunkHeader *ch;
+        if (!chunk_valid(r, r->index[i].offset, &ch))
+        {
+            r->index_count = i;
+            break;
+        }
+        r->t_last = ch->last_t;
+
+        const unsigned char *p = (const unsigned char *)(ch + 1);
+        const unsigned char *end = p + ch->bytes;
+        while (p + sizeof(RecRecordHeader) <= end)
+        {
+            const RecRecordHeader *rh = (const RecRecordHeader *)p;
+            if (rh->type != REC_WALLCLOCK && rh->gateway + 1 > r->gateways)
+                r->gateways = rh->gateway + 1;
+            p += sizeof(*rh) + REC_ALIGN(rh->len);
+        }
+    }
+
+    if (r->gateways == 0)
+        r->gateways = 1;
+
+    printf("[GUI] Replay %s: %zu chunks, %.1f s, %d gateway(s)\n", path,
+           r->index_count, (r->t_last - r->t_first) / 1e6, r->gateways);
+    return r;
+}
+
+/* Last chunk starting at or before t */
+static size_t replay_find_chunk(const Replay *r, int64_t t)
+{
+    size_t lo = 0, hi = r->index_count;
+
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (r->index[mid].first_t <= t)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Sleeps until the record at t is due. Returns FALSE if interrupted by
+ * a seek, speed change or close. */
+static gboolean replay_wait(Replay *r, int64_t t, int64_t anchor_t,
+                            int64_t anchor_wall, double speed)
+{
+    int64_t due = anchor_wall + (int64_t)((t - anchor_t) / speed);
+
+    for (;;)
+    {
+        if (!atomic_load(&r->running) || atomic_load(&r->seek_to) >= 0 ||
+            atomic_load(&r->speed_changed))
+            return FALSE;
+
+        int64_t left = due - g_get_monotonic_time();
+        if (left <= 0)
+            return TRUE;
+
+        g_usleep(left < 50000 ? left : 50000);
+    }
+}
+
+static void *replay_thread(void *arg)
+{
+    Replay *r = arg;
+    size_t ci = 0;
+    size_t off = 0; /* within the current chunk payload */
+    int64_t ff_until = 0;
+    double speed = atomic_load(&r->speed);
+    int64_t anchor_t = r->t_first;
+    int64_t anchor_wall = g_get_monotonic_time();
+    gboolean ended = FALSE;
+
+    while (atomic_load(&r->running))
+    {
+        int64_t seek = atomic_exchange(&r->seek_to, -1);
+        if (seek >= 0)
+        {
+            int64_t lead = atomic_load(&r->seek_lead);
+            ci = replay_find_chunk(r, seek - lead);
+            off = 0;
+            ff_until = seek;
+            anchor_t = seek;
+            anchor_wall = g_get_monotonic_time();
+            ended = FALSE;
+            if (r->h.on_seek)
+                r->h.on_seek(r->user);
+        }
+
+        if (atomic_exchange(&r->speed_changed, 0))
+        {
+            speed = atomic_load(&r->speed);
+            anchor_wall = g_get_monotonic_time();
+            ended = FALSE;
+            /* anchor_t is moved to the next record below */
+            anchor_t = -1;
+        }
+
+        const RecChunkHeader *ch;
+        if (ci >= r->index_count || !chunk_valid(r, r->index[ci].offset, &ch))
+        {
+            if (!ended && r->h.on_end)
+                r->h.on_end(r->user);
+            ended = TRUE;
+            g_usleep(50000);
+            continue;
+        }
+
+        const unsigned char *payload = (const unsigned char *)(ch + 1);
+        if (off + sizeof(RecRecordHeader) > ch->bytes)
+        {
+            ci++;
+            off = 0;
+            continue;
+        }
+
+        const RecRecordHeader *rh = (const RecRecordHeader *)(payload + off);
+        if (off + sizeof(*rh) + REC_ALIGN(rh->len) > ch->bytes)
+        {
+            ci++;
+            off = 0;
+            continue;
+        }
+
+        if (anchor_t < 0)
+            anchor_t = rh->t_us;
+
+        if (rh->t_us >= ff_until &&
+            !replay_wait(r, rh->t_us, anchor_t, anchor_wall, speed))
+            continue;
+
+        if (rh->type != REC_WALLCLOCK && r->h.on_frame)
+        {
+            Frame f = {
+                .type = (FrameType)rh->type,
+                .data = (const unsigned char *)(rh + 1),
+                .len = rh->len,
+            };
+            r->h.on_frame(rh->gateway, (WireFormat)rh->wire, &f, r->user);
+        }
+
+        off += sizeof(*rh) + REC_ALIGN(rh->len);
+    }
+
+    return NULL;
+}
+
+/* Not for use while the replay thread is running */
+void replay_foreach(Replay *r, ReplayVisit visit, void *user)
+{
+    for (size_t i = 0; i < r->index_count; i++)
+    {
+        const RecChunkHeader *ch;
+        if (!chunk_valid(r, r->index[i].offset, &ch))
+            return;
+
+        const unsigned char *p = (const unsigned char *)(ch + 1);
+        const unsigned char *end = p + ch->bytes;
+
+        while (p + sizeof(RecRecordHeader) <= end)
+        {
+            const RecRecordHeader *rh = (const RecRecordHeader *)p;
+            if (p + sizeof(*rh) + REC_ALIGN(rh->len) > end)
+                break;
+
+            if (rh->type != REC_WALLCLOCK)
+            {
+                Frame f = {
+                    .type = (FrameType)rh->type,
+                    .data = (const unsigned char *)(rh + 1),
+                    .len = rh->len,
+                };
+                if (!visit(rh->gateway, (WireFormat)rh->wire, &f, rh->t_us,
+                           user))
+                    return;
+            }
+
+            p += sizeof(*rh) + REC_ALIGN(rh->len);
+        }
+    }
+}
+
+void replay_start(Replay *r, double speed)
+{
+    atomic_store(&r->speed, speed);
+    atomic_store(&r->running, 1);
+    r->started = TRUE;
+    pthread_create(&r->thread, NULL, replay_thread, r);
+}
+
+/* offset_us is relative to the start of the recording. Playback resumes
+ * there; the lead_us before it is fed without delay so the plot window
+ * is already filled. */
+void replay_seek(Replay *r, int64_t offset_us, int64_t lead_us)
+{
+    int64_t t = r->t_first + (offset_us > 0 ? offset_us : 0);
+    if (t > r->t_last)
+        t = r->t_last;
+
+    atomic_store(&r->seek_lead, lead_us);
+    atomic_store(&r->seek_to, t);
+}
+
+void replay_set_speed(Replay *r, double speed)
+{
+    atomic_store(&r->speed, speed);
+    atomic_store(&r->speed_changed, 1);
+}
+
+int64_t replay_duration_us(Replay *r)
+{
+    return r->t_last - r->t_first;
+}
+
+int replay_gateways(Replay *r)
+{
+    return r->gateways;
+}
+
+void replay_close(Replay *r)
+{
+    if (!r)
+        return;
+
+    if (r->started)
+    {
+        atomic_store(&r->running, 0);
+        pthread_join(r->thread, NULL);
+    }
+
+    munmap(r->map, r->size);
+    g_free(r->index);
+    g_free(r);
+}
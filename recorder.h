@@ -0,0 +1,113 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "proto.h"
+
+/* ---------- Stream recorder / replay ----------
+ *
+ * File layout (host byte order, this is a local capture format):
+ *
+ *   RecFileHeader
+ *   chunk*   : RecChunkHeader + records
+ *   index    : RecIndexEntry[count]   (one per chunk)
+ *   RecFooter
+ *
+ * A record is a RecRecordHeader followed by the frame payload exactly as
+ * it came off the wire (RATES, CHANNELS, FORMAT, PONG or a batch), or
+ * an 8-byte wall-clock marker (REC_WALLCLOCK) at the start of every
+ * chunk. Records are padded to 8 bytes so the mapped file can be read
+ * in place. A gateway's last CHANNELS is repeated ahead of its first
+ * frame in the file, so recordings started mid-stream still decode.
+ *
+ * Recording: the I/O threads only memcpy frames into a pre-allocated
+ * chunk; a writer thread does all disk I/O. If the writer falls behind
+ * and no free chunk is left, frames are dropped and counted rather than
+ * stalling ingest.
+ *
+ * Replay: the file is mmap'ed and frames are fed back on a replay thread
+ * at original or scaled speed. The chunk index makes seeking instant. A
+ * file without footer (e.g. after a crash) is indexed by scanning the
+ * chunk headers.
+ */
+#define REC_MAGIC "MNGREC1"
+#define REC_FOOTER_MAGIC "MNGIDX1"
+#define REC_VERSION 1
+#define REC_CHUNK_BYTES (256 * 1024)
+#define REC_CHUNK_POOL 8
+#define REC_CHUNK_MAGIC 0x4B4E4843u /* "CHNK" */
+
+#define REC_ALIGN(n) (((n) + 7u) & ~(size_t)7u)
+#define REC_WALLCLOCK 0x80 /* record type besides FrameType values */
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} RecFileHeader;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t bytes; /* payload bytes following this header */
+    int64_t first_t;
+    int64_t last_t;
+    uint32_t records;
+    uint32_t reserved;
+} RecChunkHeader;
+
+typedef struct
+{
+    uint8_t type;    /* FrameType or REC_WALLCLOCK */
+    uint8_t gateway; /* index into gateways[] */
+    uint8_t wire;    /* WireFormat of a batch */
+    uint8_t reserved;
+    uint32_t len;
+    int64_t t_us; /* local monotonic receive time */
+} RecRecordHeader;
+
+typedef struct
+{
+    uint64_t offset; /* of the RecChunkHeader */
+    int64_t first_t;
+} RecIndexEntry;
+
+typedef struct
+{
+    char magic[8];
+    uint64_t index_offset;
+    uint64_t index_count;
+} RecFooter;
+
+gboolean recorder_start(const char *path);
+void recorder_stop(void);
+gboolean recorder_active(void);
+void recorder_append(int gateway, WireFormat wire, const Frame *f);
+uint64_t recorder_dropped(void);
+unsigned recorder_session(void);
+
+typedef struct Replay Replay;
+
+/* Called on the replay thread */
+typedef struct
+{
+    void (*on_frame)(int gateway, WireFormat wire, const Frame *f,
+                     void *user);
+    void (*on_seek)(void *user);
+    void (*on_end)(void *user);
+} ReplayHandlers;
+
+/* Synchronous walk over every frame, e.g. for export; FALSE stops it */
+typedef gboolean (*ReplayVisit)(int gateway, WireFormat wire,
+                                const Frame *f, int64_t t_us, void *user);
+
+Replay *replay_open(const char *path, const ReplayHandlers *h, void *user);
+void replay_foreach(Replay *r, ReplayVisit visit, void *user);
+void replay_start(Replay *r, double speed);
+void replay_seek(Replay *r, int64_t offset_us, int64_t lead_us);
+void replay_set_speed(Replay *r, double speed);
+int64_t replay_duration_us(Replay *r);
+int replay_gateways(Replay *r);
+void replay_close(Replay *r);
+
+#endif
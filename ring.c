@@ -0,0 +1,407 @@
+#include "ring.h"
+
+static size_t lane_bytes(RingStore store, uint64_t capacity)
+{
+    switch (store)
+    {
+    case RING_F32:
+        return capacity * sizeof(float);
+    case RING_U16:
+        return capacity * sizeof(uint16_t);
+    case RING_U8:
+        return capacity * sizeof(uint8_t);
+    case RING_BIT:
+        return (capacity + 63) / 64 * sizeof(uint64_t);
+    default:
+        return capacity * sizeof(double);
+    }
+}
+
+/* store[l] for each lane; NULL keeps every lane as doubles */
+void ring_init(SampleRing *r, uint64_t capacity, int lanes,
+               const RingStore *store)
+{
+    memset(r, 0, sizeof(*r));
+
+    r->capacity = capacity;
+    r->lanes = lanes;
+    r->values = lanes;
+    r->ts = g_malloc0(capacity * sizeof(*r->ts));
+
+    for (int l = 0; l < lanes; l++)
+    {
+        r->store[l] = store ? store[l] : RING_F64;
+        r->val[l].f64 = g_malloc0(lane_bytes(r->store[l], capacity));
+    }
+}
+
+/* values masks of `bits` bits each, values * bits <= RING_MAX_LANES */
+void ring_init_bits(SampleRing *r, uint64_t capacity, int values, int bits)
+{
+    RingStore store[RING_MAX_LANES];
+
+    for (int l = 0; l < values * bits; l++)
+        store[l] = RING_BIT;
+
+    ring_init(r, capacity, values * bits, store);
+    r->values = values;
+    r->bits = bits;
+}
+
+static inline unsigned lane_clamp(double v, unsigned max)
+{
+    return v <= 0 ? 0 : v >= max ? max : (unsigned)(v + 0.5);
+}
+
+static inline void lane_store(SampleRing *r, int l, uint64_t slot, double v)
+{
+    RingLane lane = r->val[l];
+
+    switch (r->store[l])
+    {
+    case RING_F64:
+        atomic_store_explicit(&lane.f64[slot], v, memory_order_relaxed);
+        break;
+    case RING_F32:
+        atomic_store_explicit(&lane.f32[slot], (float)v, memory_order_relaxed);
+        break;
+    case RING_U16:
+        atomic_store_explicit(&lane.u16[slot], lane_clamp(v, UINT16_MAX),
+                              memory_order_relaxed);
+        break;
+    case RING_U8:
+        atomic_store_explicit(&lane.u8[slot], lane_clamp(v, UINT8_MAX),
+                              memory_order_relaxed);
+        break;
+    case RING_BIT:
+    {
+        _Atomic uint64_t *w = &lane.bits[slot / 64];
+        uint64_t bit = 1ULL << (slot % 64);
+        uint64_t old = atomic_load_explicit(w, memory_order_relaxed);
+
+        atomic_store_explicit(w, v != 0 ? old | bit : old & ~bit,
+                              memory_order_relaxed);
+        break;
+    }
+    }
+}
+
+/* Producer side: claim the slot, write it, then publish it. */
+void ring_push_lanes(SampleRing *r, uint64_t ts, const double *vals)
+{
+    uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t slot = h % r->capacity;
+
+    atomic_store_explicit(&r->reserve, h + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&r->ts[slot], ts, memory_order_relaxed);
+    if (r->bits)
+    {
+        unsigned max = (1u << r->bits) - 1;
+
+        for (int l = 0; l < r->lanes; l++)
+        {
+            unsigned mask = lane_clamp(vals[l / r->bits], max);
+            lane_store(r, l, slot, (mask >> (l % r->bits)) & 1);
+        }
+    }
+    else
+    {
+        for (int l = 0; l < r->lanes; l++)
+            lane_store(r, l, slot, vals[l]);
+    }
+
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+}
+
+void ring_push(SampleRing *r, uint64_t ts, double val)
+{
+    ring_push_lanes(r, ts, &val);
+}
+
+/* Safe from either side: only moves tail forward to the current head. */
+void ring_clear(SampleRing *r)
+{
+    atomic_store_explicit(&r->tail,
+                          atomic_load_explicit(&r->head, memory_order_acquire),
+                          memory_order_release);
+}
+
+static uint64_t ring_first(SampleRing *r, uint64_t head)
+{
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint64_t oldest = (head > r->capacity) ? head - r->capacity : 0;
+
+    return (tail > oldest) ? tail : oldest;
+}
+
+static uint64_t ring_ts_at(SampleRing *r, uint64_t i)
+{
+    return atomic_load_explicit(&r->ts[i % r->capacity], memory_order_relaxed);
+}
+
+/* First index in [first, head) whose timestamp is >= t (timestamps ascend) */
+static uint64_t ring_lower_bound(SampleRing *r, uint64_t first,
+                                 uint64_t head, uint64_t t)
+{
+    uint64_t lo = first, hi = head;
+
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if (ring_ts_at(r, mid) < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int ring_count(SampleRing *r)
+{
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    return (int)(head - ring_first(r, head));
+}
+
+/* One past the last index in [first, head) with timestamp <= t_max */
+static uint64_t ring_upper_bound(SampleRing *r, uint64_t first,
+                                 uint64_t head, uint64_t t_max)
+{
+    return t_max == UINT64_MAX ? head
+                               : ring_lower_bound(r, first, head, t_max + 1);
+}
+
+int ring_count_since(SampleRing *r, uint64_t t_min)
+{
+    return ring_count_range(r, t_min, UINT64_MAX);
+}
+
+int ring_count_range(SampleRing *r, uint64_t t_min, uint64_t t_max)
+{
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint64_t first = ring_first(r, head);
+    uint64_t end = ring_upper_bound(r, first, head, t_max);
+
+    first = ring_lower_bound(r, first, end, t_min);
+    return (int)(end - first);
+}
+
+/*
+ * TRUE if nothing newer than t_min has been overwritten, i.e. the ring
+ * still holds the complete history from t_min onwards.
+ */
+gboolean ring_covers(SampleRing *r, uint64_t t_min)
+{
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint64_t first = ring_first(r, head);
+
+    if (first == atomic_load_explicit(&r->tail, memory_order_acquire))
+        return TRUE;
+
+    return ring_ts_at(r, first) <= t_min;
+}
+
+gboolean ring_latest_ts(SampleRing *r, uint64_t *ts)
+{
+    uint64_t t;
+    int n = ring_snapshot(r, &t, NULL, 1);
+
+    if (n < 1)
+        return FALSE;
+
+    *ts = t;
+    return TRUE;
+}
+
+/* One loop per store, so the copy itself does not branch per slot */
+#define LANE_COPY(load)                                                      \
+    for (uint64_t i = first; i < end; i++)                                   \
+    {                                                                        \
+        uint64_t slot = i % r->capacity;                                     \
+        out[i - first] = (load);                                             \
+    }
+
+static void lane_copy(SampleRing *r, int l, uint64_t first, uint64_t end,
+                      double *out)
+{
+    RingLane lane = r->val[l];
+
+    switch (r->store[l])
+    {
+    case RING_F64:
+        LANE_COPY(atomic_load_explicit(&lane.f64[slot], memory_order_relaxed));
+        break;
+    case RING_F32:
+        LANE_COPY(atomic_load_explicit(&lane.f32[slot], memory_order_relaxed));
+        break;
+    case RING_U16:
+        LANE_COPY(atomic_load_explicit(&lane.u16[slot], memory_order_relaxed));
+        break;
+    case RING_U8:
+        LANE_COPY(atomic_load_explicit(&lane.u8[slot], memory_order_relaxed));
+        break;
+    case RING_BIT:
+        LANE_COPY((atomic_load_explicit(&lane.bits[slot / 64],
+                                        memory_order_relaxed) >>
+                   (slot % 64)) & 1);
+        break;
+    }
+}
+
+#undef LANE_COPY
+
+/* Value v of a mask ring: its bit lanes put back together */
+static void mask_copy(SampleRing *r, int v, uint64_t first, uint64_t end,
+                      double *out)
+{
+    const RingLane *lane = &r->val[v * r->bits];
+
+    for (uint64_t i = first; i < end; i++)
+    {
+        uint64_t slot = i % r->capacity;
+        unsigned mask = 0;
+
+        for (int b = 0; b < r->bits; b++)
+        {
+            uint64_t w = atomic_load_explicit(&lane[b].bits[slot / 64],
+                                              memory_order_relaxed);
+            mask |= (unsigned)((w >> (slot % 64)) & 1) << b;
+        }
+        out[i - first] = mask;
+    }
+}
+
+/* Copy slots [first, end), then drop any the producer reused meanwhile */
+static int ring_copy(SampleRing *r, uint64_t first, uint64_t end,
+                     uint64_t *ts, double *const *vals)
+{
+    for (uint64_t i = first; ts && i < end; i++)
+        ts[i - first] = atomic_load_explicit(&r->ts[i % r->capacity],
+                                             memory_order_relaxed);
+
+    for (int l = 0; vals && l < r->values; l++)
+    {
+        if (!vals[l])
+            continue;
+
+        if (r->bits)
+            mask_copy(r, l, first, end, vals[l]);
+        else
+            lane_copy(r, l, first, end, vals[l]);
+    }
+
+    /*
+     * Anything the producer reserved since we started may have landed on
+     * a slot we just read; those entries are the oldest ones, so drop them
+     * from the front.
+     */
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t reserve = atomic_load_explicit(&r->reserve, memory_order_relaxed);
+    uint64_t valid = (reserve > r->capacity) ? reserve - r->capacity : 0;
+
+    if (valid <= first)
+        return (int)(end - first);
+
+    if (valid >= end)
+        return 0;
+
+    int drop = (int)(valid - first);
+    int n = (int)(end - valid);
+
+    if (ts)
+        memmove(ts, ts + drop, n * sizeof(*ts));
+
+    for (int l = 0; vals && l < r->values; l++)
+    {
+        if (vals[l])
+            memmove(vals[l], vals[l] + drop, n * sizeof(*vals[l]));
+    }
+
+    return n;
+}
+
+/*
+ * Copy the newest (up to max) samples with ts >= t_min, oldest first.
+ * ts, vals and any entry of vals may be NULL. Returns the count copied.
+ */
+int ring_snapshot_since(SampleRing *r, uint64_t t_min,
+                        uint64_t *ts, double *const *vals, int max)
+{
+    return ring_snapshot_range(r, t_min, UINT64_MAX, ts, vals, max);
+}
+
+/*
+ * Like ring_snapshot_since() but only up to t_max (inclusive). Both ends
+ * are binary searches, so the cost follows the samples copied, not the
+ * ring size or how far back the range lies.
+ */
+int ring_snapshot_range(SampleRing *r, uint64_t t_min, uint64_t t_max,
+                        uint64_t *ts, double *const *vals, int max)
+{
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint64_t first = ring_first(r, head);
+
+    if (max <= 0 || head == first)
+        return 0;
+
+    uint64_t end = ring_upper_bound(r, first, head, t_max);
+
+    if (t_min > 0)
+        first = ring_lower_bound(r, first, end, t_min);
+
+    if (end - first > (uint64_t)max)
+        first = end - max;
+
+    return ring_copy(r, first, end, ts, vals);
+}
+
+/* Newest sample with ts <= t into *ts and vals[0..values), FALSE if none */
+gboolean ring_sample_at(SampleRing *r, uint64_t t, uint64_t *ts,
+                        double *vals)
+{
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint64_t first = ring_first(r, head);
+    uint64_t end = ring_upper_bound(r, first, head, t);
+    double *lanes[RING_MAX_LANES];
+
+    if (end == first)
+        return FALSE;
+
+    for (int l = 0; l < RING_MAX_LANES; l++)
+        lanes[l] = &vals[l];
+
+    return ring_copy(r, end - 1, end, ts, lanes) == 1;
+}
+
+/*
+ * Like ring_snapshot_since() but takes the oldest (up to max) samples
+ * with ts >= t_min, for walking the whole ring in chunks.
+ */
+int ring_read_since(SampleRing *r, uint64_t t_min,
+                    uint64_t *ts, double *const *vals, int max)
+{
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint64_t first = ring_first(r, head);
+
+    if (max <= 0 || head == first)
+        return 0;
+
+    if (t_min > 0)
+        first = ring_lower_bound(r, first, head, t_min);
+
+    uint64_t end = head;
+    if (end - first > (uint64_t)max)
+        end = first + max;
+
+    return ring_copy(r, first, end, ts, vals);
+}
+
+/* Lane 0 only; ring_copy() reads one pointer per lane */
+int ring_snapshot(SampleRing *r, uint64_t *ts, double *val, int max)
+{
+    double *lanes[RING_MAX_LANES] = {val};
+
+    return ring_snapshot_since(r, 0, ts, val ? lanes : NULL, max);
+}
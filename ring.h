@@ -0,0 +1,92 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "utils.h"
+
+#define RING_MAX_LANES 16
+
+/* ---------- Lock-free sample ring ----------
+ *
+ * Single producer (the owning gateway's NetConn I/O thread,
+ * net_io_thread in net.c, or the replay thread while a recording
+ * plays) / single consumer (draw_grid).
+ * The producer never waits: once the ring is full the oldest slot is
+ * overwritten. The consumer takes a snapshot and drops any slot the
+ * producer may have reused while it was copying, so a snapshot never
+ * contains a half-written sample.
+ *
+ * Every slot has a timestamp and 1..RING_MAX_LANES values (a raw ring
+ * has one lane, a downsampled tier has min/max/mean). Each lane keeps
+ * its values in a RingStore picked at ring_init(); values go in and
+ * come out as doubles, clamped (or rounded to float) to what the store
+ * holds. RING_BIT packs 64 slots a word, which is safe because only
+ * the producer writes and a word is read whole.
+ *
+ * A ring from ring_init_bits() holds bit masks instead: each value is
+ * spread over `bits` RING_BIT lanes (bit 0 first), and goes in and
+ * comes out as the whole mask. A switch bank keeps one lane per switch
+ * that way.
+ *
+ *   reserve  - sample index the producer is about to write
+ *   head     - number of samples fully written (published)
+ *   tail     - first sample index still valid after a clear
+ */
+typedef enum
+{
+    RING_F64,
+    RING_F32,
+    RING_U16,
+    RING_U8,
+    RING_BIT /* 0 or 1 */
+} RingStore;
+
+typedef union
+{
+    _Atomic double *f64;
+    _Atomic float *f32;
+    _Atomic uint16_t *u16;
+    _Atomic uint8_t *u8;
+    _Atomic uint64_t *bits;
+} RingLane;
+
+typedef struct
+{
+    _Atomic uint64_t reserve;
+    _Atomic uint64_t head;
+    _Atomic uint64_t tail;
+
+    uint64_t capacity;
+    int lanes;
+    int values; /* per slot: lanes, or lanes / bits for a mask ring */
+    int bits;   /* lanes per value, 0 unless ring_init_bits() */
+
+    _Atomic uint64_t *ts;
+    RingStore store[RING_MAX_LANES];
+    RingLane val[RING_MAX_LANES];
+} SampleRing;
+
+void ring_init(SampleRing *r, uint64_t capacity, int lanes,
+               const RingStore *store);
+void ring_init_bits(SampleRing *r, uint64_t capacity, int values, int bits);
+void ring_push(SampleRing *r, uint64_t ts, double val);
+void ring_push_lanes(SampleRing *r, uint64_t ts, const double *vals);
+void ring_clear(SampleRing *r);
+int ring_count(SampleRing *r);
+int ring_count_since(SampleRing *r, uint64_t t_min);
+int ring_count_range(SampleRing *r, uint64_t t_min, uint64_t t_max);
+gboolean ring_covers(SampleRing *r, uint64_t t_min);
+gboolean ring_latest_ts(SampleRing *r, uint64_t *ts);
+int ring_snapshot(SampleRing *r, uint64_t *ts, double *val, int max);
+int ring_snapshot_since(SampleRing *r, uint64_t t_min,
+                        uint64_t *ts, double *const *vals, int max);
+int ring_snapshot_range(SampleRing *r, uint64_t t_min, uint64_t t_max,
+                        uint64_t *ts, double *const *vals, int max);
+gboolean ring_sample_at(SampleRing *r, uint64_t t, uint64_t *ts,
+                        double *vals);
+int ring_read_since(SampleRing *r, uint64_t t_min,
+                    uint64_t *ts, double *const *vals, int max);
+
+#endif
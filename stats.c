@@ -0,0 +1,84 @@
+#include <math.h>
+#include <string.h>
+
+#include "stats.h"
+
+void stats_init(RollingStats *s)
+{
+    memset(s->acc, 0, sizeof(s->acc));
+    memset(s->buf, 0, sizeof(s->buf));
+    s->period_start = 0;
+    tribuf_init(&s->tb);
+}
+
+static void stats_fold(const StatsAccum *a, double period_s, ChannelStats *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (a->n == 0)
+        return;
+
+    out->n = a->n;
+    out->mean = a->sum / a->n;
+    out->rms = sqrt(a->sum_sq / a->n);
+    out->min = a->min;
+    out->max = a->max;
+    out->rate_hz = period_s > 0 ? a->n / period_s : 0;
+
+    if (a->dt_n > 0)
+    {
+        double var;
+
+        out->dt_us = a->dt_sum / a->dt_n;
+        var = a->dt_sq / a->dt_n - out->dt_us * out->dt_us;
+        out->jitter_us = var > 0 ? sqrt(var) : 0;
+    }
+}
+
+/*
+ * I/O thread, after each batch: once a period has passed, publish its
+ * statistics and start the next one. A channel's last timestamp carries
+ * over so the first delta of a period is not lost.
+ */
+void stats_flush(RollingStats *s, int64_t now_us)
+{
+    if (s->period_start == 0)
+    {
+        s->period_start = now_us;
+        return;
+    }
+
+    int64_t period = now_us - s->period_start;
+    if (period < STATS_PERIOD_US)
+        return;
+
+    StatsSnapshot *snap = &s->buf[s->tb.back];
+
+    snap->t_us = now_us;
+    snap->period_us = period;
+    for (int c = 0; c < MAX_CHANNELS; c++)
+    {
+        StatsAccum *a = &s->acc[c];
+        uint64_t last_ts = a->last_ts;
+
+        stats_fold(a, period / 1e6, &snap->ch[c]);
+        memset(a, 0, sizeof(*a));
+        a->last_ts = last_ts;
+    }
+
+    tribuf_publish(&s->tb);
+    s->period_start = now_us;
+}
+
+/*
+ * Consumer thread only: the latest period, or NULL if none was published
+ * in the last two periods (not streaming).
+ */
+const StatsSnapshot *stats_latest(RollingStats *s)
+{
+    const StatsSnapshot *snap = &s->buf[tribuf_front(&s->tb, NULL)];
+
+    if (snap->t_us == 0 ||
+        g_get_monotonic_time() - snap->t_us > 2 * STATS_PERIOD_US)
+        return NULL;
+    return snap;
+}
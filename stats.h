@@ -0,0 +1,132 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "utils.h"
+
+/* ---------- Triple buffer ----------
+ *
+ * Hands complete snapshots from one producer thread to one consumer
+ * without locks: the producer fills buf[back] and swaps it with the
+ * middle slot, the consumer swaps the middle slot with its front one
+ * when a fresh one is there. Neither side ever waits or sees a snapshot
+ * that is still being written; snapshots the consumer never looked at
+ * are simply overwritten. The TriBuf only holds the slot indices, the
+ * owner keeps the three buffers.
+ */
+#define TRIBUF_FRESH 4
+
+typedef struct
+{
+    _Atomic int middle; /* slot index | TRIBUF_FRESH */
+    int back;           /* producer only */
+    int front;          /* consumer only */
+} TriBuf;
+
+static inline void tribuf_init(TriBuf *t)
+{
+    t->back = 0;
+    atomic_store(&t->middle, 1);
+    t->front = 2;
+}
+
+/* Producer: buf[t->back] is complete, make it the latest */
+static inline void tribuf_publish(TriBuf *t)
+{
+    t->back = atomic_exchange_explicit(&t->middle, t->back | TRIBUF_FRESH,
+                                       memory_order_acq_rel) &
+              ~TRIBUF_FRESH;
+}
+
+/* Consumer: slot of the latest snapshot; FALSE in *fresh if unchanged */
+static inline int tribuf_front(TriBuf *t, gboolean *fresh)
+{
+    gboolean got = (atomic_load_explicit(&t->middle, memory_order_relaxed) &
+                    TRIBUF_FRESH) != 0;
+
+    if (got)
+        t->front = atomic_exchange_explicit(&t->middle, t->front,
+                                            memory_order_acq_rel) &
+                   ~TRIBUF_FRESH;
+    if (fresh)
+        *fresh = got;
+    return t->front;
+}
+
+/* ---------- Streaming statistics ----------
+ *
+ * Per gateway and channel, fed by the I/O thread for every buffered
+ * sample (a few adds, no allocation) and folded once per STATS_PERIOD_US
+ * into a StatsSnapshot: mean, RMS, min/max, received rate and the
+ * spread of the timestamp deltas (jitter). Gaps longer than a period
+ * are not counted as deltas. Snapshots go to the GTK thread through a
+ * TriBuf, so reading them never holds up ingest.
+ */
+#define STATS_PERIOD_US 1000000
+
+typedef struct
+{
+    uint64_t n;
+    double sum, sum_sq, min, max;
+
+    uint64_t last_ts; /* gateway time of the previous sample */
+    uint64_t dt_n;
+    double dt_sum, dt_sq;
+} StatsAccum;
+
+typedef struct
+{
+    uint64_t n; /* samples in the period, 0 = channel idle */
+    double mean, rms, min, max;
+    double rate_hz;
+    double dt_us, jitter_us; /* mean and standard deviation of deltas */
+} ChannelStats;
+
+typedef struct
+{
+    int64_t t_us;      /* local time the period ended */
+    int64_t period_us; /* its actual length */
+    ChannelStats ch[MAX_CHANNELS];
+} StatsSnapshot;
+
+typedef struct
+{
+    /* I/O thread only */
+    StatsAccum acc[MAX_CHANNELS];
+    int64_t period_start;
+
+    TriBuf tb;
+    StatsSnapshot buf[3];
+} RollingStats;
+
+void stats_init(RollingStats *s);
+void stats_flush(RollingStats *s, int64_t now_us);
+const StatsSnapshot *stats_latest(RollingStats *s);
+
+/* I/O thread, once per buffered sample */
+static inline void stats_add(RollingStats *s, int c, double v, uint64_t ts)
+{
+    StatsAccum *a = &s->acc[c];
+
+    if (a->n == 0 || v < a->min)
+        a->min = v;
+    if (a->n == 0 || v > a->max)
+        a->max = v;
+    a->n++;
+    a->sum += v;
+    a->sum_sq += v * v;
+
+    if (ts > a->last_ts && a->last_ts && ts - a->last_ts < STATS_PERIOD_US)
+    {
+        double dt = (double)(ts - a->last_ts);
+
+        a->dt_n++;
+        a->dt_sum += dt;
+        a->dt_sq += dt * dt;
+    }
+    a->last_ts = ts;
+}
+
+#endif
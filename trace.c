@@ -0,0 +1,195 @@
+#include "decimate.h"
+#include "trace.h"
+#include "xform.h"
+
+/* The span trace_points() fetched last, for trace_bit_points() */
+static HistorySpan span;
+static float *span_x = NULL;
+static int span_n = 0, span_w = 0;
+
+/* Decimated polyline, grown with the plot width */
+static double *dec_x = NULL, *dec_v = NULL;
+static int dec_cap = 0;
+
+/*
+ * Part of one series from t_min over `window`, decimated to at most two
+ * points (min/max) per pixel column of `plot_w`. x is in px from t_min.
+ * The buffers are shared and only valid until the next call.
+ */
+int trace_points(SensorHistory *h, uint64_t t_min, uint64_t window,
+                 int plot_w, const double **out_x, const double **out_v)
+{
+    span_n = 0;
+
+    if (plot_w <= 0 || window == 0)
+        return 0;
+
+    if (DECIMATE_MAX_POINTS(plot_w) > dec_cap)
+    {
+        dec_cap = DECIMATE_MAX_POINTS(plot_w);
+        dec_x = g_renew(double, dec_x, dec_cap);
+        dec_v = g_renew(double, dec_v, dec_cap);
+    }
+
+    if (SPAN_POINTS_PER_PX * plot_w > span.cap)
+    {
+        history_span_reserve(&span, SPAN_POINTS_PER_PX * plot_w);
+        span_x = g_renew(float, span_x, span.cap);
+    }
+
+    /* Consistent snapshot of the visible span; the RX thread keeps writing.
+       It may end before the newest sample when the view is frozen. */
+    int count = history_query_range(h, t_min, t_min + window, &span);
+
+    if (count < 2)
+        return 0;
+
+    /* Whole span to pixel columns in one pass */
+    xform_time_px(span.ts, count, t_min, (double)plot_w / (double)window,
+                  span_x);
+    span_n = count;
+    span_w = plot_w;
+
+    *out_x = dec_x;
+    *out_v = dec_v;
+    return decimate_minmax(span_x, span.lo, span.hi, count, plot_w,
+                           dec_x, dec_v);
+}
+
+/*
+ * Bit `bit` of the bit-mask span trace_points() fetched last, decimated
+ * the same way and placed in lane `bit` (bit 0 at the bottom): draw it
+ * with y_max = the mask's bit count. A bucket's AND and OR masks give
+ * the bit's min and max, so a flip inside a bucket still shows.
+ */
+int trace_bit_points(int bit, const double **out_x, const double **out_v)
+{
+    static double *lo = NULL, *hi = NULL;
+    static int cap = 0;
+
+    if (span_n < 2)
+        return 0;
+
+    if (span_n > cap)
+    {
+        cap = span.cap;
+        lo = g_renew(double, lo, cap);
+        hi = g_renew(double, hi, cap);
+    }
+
+    for (int i = 0; i < span_n; i++)
+    {
+        lo[i] = bit + TRACE_LANE_LOW +
+                TRACE_LANE_SWING * (((unsigned)span.lo[i] >> bit) & 1);
+        hi[i] = bit + TRACE_LANE_LOW +
+                TRACE_LANE_SWING * (((unsigned)span.hi[i] >> bit) & 1);
+    }
+
+    *out_x = dec_x;
+    *out_v = dec_v;
+    return decimate_minmax(span_x, lo, hi, span_n, span_w, dec_x, dec_v);
+}
+
+/*
+ * Decimated points of a digital channel as a step outline: a level is
+ * held until the next change, where the outline goes straight up or
+ * down, and the last point extends the final level. Shared buffers,
+ * valid until the next call.
+ */
+int trace_steps(const double *x, const double *v, int n,
+                const double **out_x, const double **out_v)
+{
+    static double *sx = NULL, *sv = NULL;
+    static int cap = 0;
+    int m = 0;
+
+    if (n <= 0)
+        return 0;
+
+    if (2 * n > cap)
+    {
+        cap = 2 * n;
+        sx = g_renew(double, sx, cap);
+        sv = g_renew(double, sv, cap);
+    }
+
+    sx[m] = x[0];
+    sv[m++] = v[0];
+
+    for (int i = 1; i < n; i++)
+    {
+        if (v[i] == sv[m - 1])
+            continue;
+
+        sx[m] = x[i];
+        sv[m] = sv[m - 1];
+        m++;
+        sx[m] = x[i];
+        sv[m++] = v[i];
+    }
+
+    if (x[n - 1] > sx[m - 1])
+    {
+        sx[m] = x[n - 1];
+        sv[m] = sv[m - 1];
+        m++;
+    }
+
+    *out_x = sx;
+    *out_v = sv;
+    return m;
+}
+
+/* One decimated polyline; x0 is where x == 0 lands, y0 the value-0 line */
+void trace_stroke(cairo_t *cr, const TraceStyle *st, double x0, double y0,
+                  int plot_h, const double *dec_x, const double *dec_v,
+                  int n)
+{
+    static float *y = NULL;
+    static int y_cap = 0;
+
+    if (n <= 0)
+        return;
+
+    if (st->steps)
+        n = trace_steps(dec_x, dec_v, n, &dec_x, &dec_v);
+
+    if (n > y_cap)
+    {
+        y_cap = n;
+        y = g_renew(float, y, y_cap);
+    }
+
+    /* ADC-style scaling (0–4095), clamped to the plot */
+    xform_value_px(dec_v, n, y0, plot_h, st->y_max, y);
+
+    cairo_set_source_rgb(cr, st->color[0], st->color[1], st->color[2]);
+
+    cairo_set_line_width(cr, 2.0);
+    cairo_set_dash(cr, st->dash, st->dash_count, 0);
+
+    cairo_move_to(cr, x0 + dec_x[0], y[0]);
+    for (int i = 1; i < n; i++)
+        cairo_line_to(cr, x0 + dec_x[i], y[i]);
+
+    cairo_stroke(cr);
+    cairo_set_dash(cr, NULL, 0, 0);
+}
+
+/* Every bit of the span trace_points() fetched last, one step lane each */
+void trace_stroke_bits(cairo_t *cr, const TraceStyle *st, int bits,
+                       double x0, double y0, int plot_h)
+{
+    TraceStyle lane = *st;
+
+    lane.y_max = bits;
+    lane.steps = TRUE;
+
+    for (int b = 0; b < bits; b++)
+    {
+        const double *x, *v;
+        int n = trace_bit_points(b, &x, &v);
+
+        trace_stroke(cr, &lane, x0, y0, plot_h, x, v, n);
+    }
+}
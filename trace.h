@@ -0,0 +1,48 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cairo.h>
+
+#include "history.h"
+
+/* Points fetched per sensor per frame before falling back to a coarser tier */
+#define SPAN_POINTS_PER_PX 8
+
+/* A bit lane's low and high level, as fractions of its height */
+#define TRACE_LANE_LOW 0.2
+#define TRACE_LANE_SWING 0.6
+
+/* ---------- Trace rendering ----------
+ *
+ * The Cairo trace path shared by the GUI and the bench driver: a
+ * visible span is pulled out of a SensorHistory, min/max decimated to
+ * the plot width and stroked as one polyline. Values are scaled by
+ * y_max and clamped to the plot.
+ *
+ * Digital channels (steps) are stroked as a step outline instead:
+ * trace_steps() collapses each run of one value to its ends, so a
+ * button that sits still costs two points however wide the plot is.
+ * A bit mask (channel_type()->bits) gets one such lane per bit, stacked
+ * from bit 0 at the bottom, so it shows which switch changed.
+ */
+typedef struct
+{
+    double color[3];
+    double y_max;
+    const double *dash; /* NULL / 0 for a solid line */
+    int dash_count;
+    gboolean steps; /* channel_type()->steps */
+} TraceStyle;
+
+int trace_points(SensorHistory *h, uint64_t t_min, uint64_t window,
+                 int plot_w, const double **out_x, const double **out_v);
+int trace_bit_points(int bit, const double **out_x, const double **out_v);
+int trace_steps(const double *x, const double *v, int n,
+                const double **out_x, const double **out_v);
+void trace_stroke(cairo_t *cr, const TraceStyle *st, double x0, double y0,
+                  int plot_h, const double *dec_x, const double *dec_v,
+                  int n);
+void trace_stroke_bits(cairo_t *cr, const TraceStyle *st, int bits,
+                       double x0, double y0, int plot_h);
+
+#endif
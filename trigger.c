@@ -0,0 +1,154 @@
+#include "gateway.h"
+#include "trigger.h"
+
+#define CAPTURE_CHUNK 4096
+
+Trigger trigger = {.channel = -1};
+
+/* ---------- Trigger ---------- */
+
+/* GTK thread: new channel, direction and level; armed right away */
+void trigger_set(int channel, TriggerEdge edge, double level)
+{
+    atomic_store(&trigger.channel, -1);
+    atomic_store(&trigger.level, level);
+    atomic_store(&trigger.edge, edge);
+    atomic_store(&trigger.fired, 0);
+    atomic_fetch_add(&trigger.gen, 1);
+    atomic_store(&trigger.armed, 1);
+    atomic_store(&trigger.channel, channel);
+}
+
+void trigger_off(void)
+{
+    atomic_store(&trigger.channel, -1);
+    atomic_store(&trigger.armed, 0);
+    atomic_store(&trigger.fired, 0);
+}
+
+/* GTK thread: wait for the next crossing */
+void trigger_arm(void)
+{
+    atomic_store(&trigger.fired, 0);
+    atomic_store(&trigger.armed, 1);
+}
+
+/* I/O thread: only the first crossing after arming counts */
+void trigger_fire(int gateway, uint64_t ts)
+{
+    int armed = 1;
+
+    if (!atomic_compare_exchange_strong(&trigger.armed, &armed, 0))
+        return;
+
+    trigger.fired_gateway = gateway;
+    trigger.fired_ts = ts;
+    atomic_store_explicit(&trigger.fired, 1, memory_order_release);
+}
+
+/* GTK thread: the crossing since the last call, FALSE if none */
+gboolean trigger_take(int *gateway, uint64_t *ts)
+{
+    if (!atomic_load_explicit(&trigger.fired, memory_order_acquire))
+        return FALSE;
+
+    *gateway = trigger.fired_gateway;
+    *ts = trigger.fired_ts;
+    atomic_store(&trigger.fired, 0);
+    return TRUE;
+}
+
+/* ---------- Capture buffer ---------- */
+
+static struct
+{
+    SensorHistory *hist[MAX_GATEWAYS][MAX_CHANNELS];
+    CaptureInfo info;
+} cap;
+
+static void capture_channel(SensorHistory *live, SensorHistory *h,
+                            uint64_t t_min, uint64_t t_max)
+{
+    static uint64_t ts[CAPTURE_CHUNK];
+    static double val[CAPTURE_CHUNK];
+    double *vals[1] = {val};
+    uint64_t from = t_min;
+
+    /* Oldest first; past CAPTURE_MAX_SAMPLES the ring keeps the newest */
+    for (;;)
+    {
+        int n = ring_read_since(&live->level[0], from, ts, vals,
+                                CAPTURE_CHUNK);
+
+        for (int i = 0; i < n; i++)
+        {
+            if (ts[i] > t_max)
+                return;
+            history_push(h, ts[i], val[i]);
+        }
+
+        if (n < CAPTURE_CHUNK)
+            return;
+        from = ts[n - 1] + 1;
+    }
+}
+
+/*
+ * GTK thread: replaces the capture with [t_trigger - pre_us, t_trigger +
+ * post_us] of the channels in mask, from every gateway. Reads the rings
+ * like any other consumer; whatever they no longer hold is missing.
+ */
+void capture_copy(uint64_t t_trigger, int gateway, int channel,
+                  uint64_t pre_us, uint64_t post_us, uint64_t mask)
+{
+    uint64_t t_min = t_trigger > pre_us ? t_trigger - pre_us : 0;
+    uint64_t t_max = t_trigger + post_us;
+
+    for (int g = 0; g < gateway_count; g++)
+    {
+        for (uint64_t m = mask; m; m &= m - 1)
+        {
+            int c = __builtin_ctzll(m);
+            SensorHistory *live = gateway_hist(&gateways[g], c);
+            SensorHistory *h = cap.hist[g][c];
+
+            if (!h && live)
+            {
+                const ChannelType *type = channel_type(c);
+
+                h = g_malloc0(sizeof(SensorHistory));
+                history_init(h, CAPTURE_MAX_SAMPLES,
+                             CAPTURE_MAX_SAMPLES / TIER_FACTOR, type->store,
+                             type->bits);
+                cap.hist[g][c] = h;
+            }
+            else if (h)
+                history_clear(h);
+
+            if (live)
+                capture_channel(live, h, t_min, t_max);
+        }
+    }
+
+    cap.info.valid = TRUE;
+    cap.info.gateway = gateway;
+    cap.info.channel = channel;
+    cap.info.t_trigger = t_trigger;
+    cap.info.t_min = t_min;
+    cap.info.t_max = t_max;
+    cap.info.mask = mask;
+    cap.info.count++;
+}
+
+const CaptureInfo *capture_info(void)
+{
+    return &cap.info;
+}
+
+/* NULL if the channel is not in the capture */
+SensorHistory *capture_hist(int gateway, int c)
+{
+    if (!cap.info.valid || !((cap.info.mask >> c) & 1))
+        return NULL;
+    return cap.hist[gateway][c];
+}
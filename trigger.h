@@ -0,0 +1,116 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "history.h"
+
+/* ---------- Threshold trigger ----------
+ *
+ * Scope-style trigger on one channel: fires when a sample crosses level
+ * in the chosen direction while the trigger is armed. The I/O threads
+ * check it in push_sample() (a channel compare per sample, plus a level
+ * compare for the trigger channel) and only record the time and gateway
+ * of the crossing; the first gateway to see one disarms it.
+ *
+ * The GTK thread then waits until the post-trigger part has arrived and
+ * copies [t - pre, t + post] of the checked channels out of the history
+ * rings into separate capture histories (capture_copy()). The rings are
+ * only read, so ingest carries on while it copies. Captures hold up to
+ * CAPTURE_MAX_SAMPLES per channel; a longer span keeps its newest part.
+ *
+ * Configuration is changed by the GTK thread only, with the channel set
+ * to -1 while it does.
+ */
+#define CAPTURE_MAX_SAMPLES 65536
+#define TRIGGER_DEFAULT_PRE_US 200000ULL
+#define TRIGGER_DEFAULT_POST_US 800000ULL
+#define TRIGGER_MAX_SPAN_US 60000000ULL /* pre + post */
+
+typedef enum
+{
+    TRIGGER_RISING,
+    TRIGGER_FALLING
+} TriggerEdge;
+
+typedef struct
+{
+    _Atomic int channel; /* registry index, -1 = off */
+    _Atomic double level;
+    _Atomic int edge;    /* TriggerEdge */
+    atomic_uint gen;     /* bumped by every trigger_set() */
+    atomic_int armed;
+
+    /* Set when it fires, cleared by trigger_take() */
+    atomic_int fired;
+    int fired_gateway;
+    uint64_t fired_ts; /* gateway-relative, like the histories */
+} Trigger;
+
+/* Per gateway, I/O thread only */
+typedef struct
+{
+    unsigned gen;  /* configuration the previous sample was seen with */
+    gboolean seen; /* have a previous sample */
+    gboolean above;
+} TriggerState;
+
+extern Trigger trigger;
+
+void trigger_set(int channel, TriggerEdge edge, double level);
+void trigger_off(void);
+void trigger_arm(void);
+void trigger_fire(int gateway, uint64_t ts);
+gboolean trigger_take(int *gateway, uint64_t *ts);
+
+static inline int trigger_channel(void)
+{
+    return atomic_load_explicit(&trigger.channel, memory_order_relaxed);
+}
+
+/* I/O thread, for samples of trigger_channel() */
+static inline void trigger_sample(TriggerState *st, int gateway, double v,
+                                  uint64_t ts)
+{
+    unsigned gen = atomic_load_explicit(&trigger.gen, memory_order_relaxed);
+    gboolean above =
+        v >= atomic_load_explicit(&trigger.level, memory_order_relaxed);
+
+    /* A new level or channel: no crossing until a sample against it */
+    if (gen != st->gen)
+    {
+        st->gen = gen;
+        st->seen = FALSE;
+    }
+
+    if (st->seen && above != st->above &&
+        above == (atomic_load_explicit(&trigger.edge,
+                                       memory_order_relaxed) ==
+                  TRIGGER_RISING) &&
+        atomic_load_explicit(&trigger.armed, memory_order_relaxed))
+        trigger_fire(gateway, ts);
+
+    st->seen = TRUE;
+    st->above = above;
+}
+
+/* ---------- Capture buffer (GTK thread) ---------- */
+
+typedef struct
+{
+    gboolean valid;
+    int gateway;             /* the one that fired */
+    int channel;             /* trigger channel */
+    uint64_t t_trigger;      /* gateway-relative */
+    uint64_t t_min, t_max;   /* captured span */
+    uint64_t mask;           /* channels captured */
+    unsigned count;          /* captures so far */
+} CaptureInfo;
+
+void capture_copy(uint64_t t_trigger, int gateway, int channel,
+                  uint64_t pre_us, uint64_t post_us, uint64_t mask);
+const CaptureInfo *capture_info(void);
+SensorHistory *capture_hist(int gateway, int c);
+
+#endif
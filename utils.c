@@ -2,6 +2,138 @@
 
 uint64_t time_window_us = 5000000ULL; // default: 5s fallback
 
+/*
+ * Opened in a terminal by the HELP command. Kept here rather than in
+ * utils.h so the one copy lives in utils.o and is only touched when
+ * HELP is used.
+ */
+static const char help_body[] =
+    "Measurement Network Gateway – CLI Help\n"
+    "\n"
+    "VALID COMMANDS:\n"
+    "\n"
+    "  CONFIGURE <SENSOR_ID> <FREQ_HZ> [<SENSOR_ID> <FREQ_HZ> ...]\n"
+    "\n"
+    "    Several sensors in one command are changed together: the\n"
+    "    gateway answers with a single RATES and the plot keeps running\n"
+    "    without a reset.\n"
+    "\n"
+    "    SENSOR_ID:\n"
+    "      TEMP   - Temperature sensor\n"
+    "      ADC0   - ADC channel 0\n"
+    "      ADC1   - ADC channel 1\n"
+    "      SW     - Switch inputs\n"
+    "      PB     - Push buttons\n"
+    "      ...    - any further channel the gateway advertises\n"
+    "               (also accepted: the checkbox label)\n"
+    "\n"
+    "    FREQ_HZ:\n"
+    "      Integer value between 10 and 1000\n"
+    "\n"
+    "  PROFILE <NAME> | PROFILE SAVE <NAME> | PROFILE LIST\n"
+    "\n"
+    "    Apply a named set of rates in one CONFIGURE, or save the\n"
+    "    current rates under NAME. Profiles can also be given at start\n"
+    "    with --profile NAME=ID:HZ,ID:HZ,...\n"
+    "\n"
+    "  WINDOW <SECONDS> | WINDOW AUTO\n"
+    "\n"
+    "    Visible time span, 0.05 s up to 24 h, shared by all sensors.\n"
+    "    Long spans are drawn from the downsampled history. AUTO gives\n"
+    "    each sensor its own span from its rate; the X axis follows the\n"
+    "    sensor picked in the dropdown.\n"
+    "\n"
+    "  RECORD <FILE> | RECORD STOP\n"
+    "\n"
+    "    Record the incoming stream to FILE while running.\n"
+    "\n"
+    "  EXPORT <FILE> [RECORDING]\n"
+    "\n"
+    "    Write the buffered raw samples of the checked sensors to a\n"
+    "    CSV file. While replaying, RECORDING exports the whole\n"
+    "    recording instead.\n"
+    "\n"
+    "  REPLAY SPEED <X> | REPLAY STOP\n"
+    "  SEEK <SECONDS>\n"
+    "\n"
+    "    While replaying (start with --replay FILE): change the\n"
+    "    playback speed, jump to an offset or end the replay.\n"
+    "\n"
+    "  STATUS | STATUS RESET\n"
+    "  HUD ON | HUD OFF\n"
+    "\n"
+    "    STATUS prints received vs. configured rates, throughput,\n"
+    "    drops, ring fill, frame times, gateway clock offsets and the\n"
+    "    sample-to-screen latency to the terminal (summary below the\n"
+    "    command line). STATUS RESET restarts the latency histograms.\n"
+    "    HUD shows the same over the graph. Every checked sensor also\n"
+    "    gets its mean, RMS, min/max and timestamp jitter over the\n"
+    "    last second.\n"
+    "\n"
+    "  OVERLOAD OFF | OVERLOAD DROP | OVERLOAD DECIMATE\n"
+    "\n"
+    "    What to do when the client falls behind a gateway. DROP (the\n"
+    "    default) discards batches that arrive over 0.5 s late, so the\n"
+    "    plot catches up; DECIMATE also asks the gateway for every 2nd,\n"
+    "    4th, ... sample until it keeps up again. Shed batches, lag and\n"
+    "    socket backlog are shown by STATUS. Recordings stay complete.\n"
+    "\n"
+    "  TRIGGER <SENSOR> RISING|FALLING <LEVEL> [SINGLE]\n"
+    "  TRIGGER WINDOW <PRE_S> <POST_S> | TRIGGER ARM | TRIGGER OFF\n"
+    "\n"
+    "    Like a scope: when SENSOR crosses LEVEL the checked sensors\n"
+    "    are captured from PRE_S before to POST_S after the crossing\n"
+    "    (default 0.2 s / 0.8 s, 60 s at most) and shown until the next\n"
+    "    trigger. SINGLE captures once; ARM waits for another. A right\n"
+    "    click on the plot or TRIGGER OFF goes back to the live view.\n"
+    "\n"
+    "  FFT <SENSOR> [GATEWAY] | FFT OFF\n"
+    "\n"
+    "    Show the spectrum of the newest 4096 raw samples of a sensor\n"
+    "    (e.g. ADC0) of gateway 1 or GATEWAY, updated four times a\n"
+    "    second, in dB of the sensor's full scale.\n"
+    "\n"
+    "EXAMPLES:\n"
+    "\n"
+    "  CONFIGURE TEMP 50\n"
+    "  CONFIGURE ADC0 200\n"
+    "  CONFIGURE TEMP 50 ADC0 1000 ADC1 1000\n"
+    "  PROFILE SAVE fast\n"
+    "  WINDOW 600\n"
+    "  RECORD /tmp/run1.rec\n"
+    "  SEEK 120\n"
+    "  FFT ADC0\n"
+    "  TRIGGER PB RISING 1\n"
+    "  TRIGGER ADC0 RISING 3000 SINGLE\n"
+    "  EXPORT /tmp/run1.csv\n"
+    "\n"
+    "INVALID EXAMPLES:\n"
+    "\n"
+    "  CONFIGURE TEMP 9        (frequency too low)\n"
+    "  CONFIGURE ADC1 1001     (frequency too high)\n"
+    "  CONFIGURE XYZ 100       (invalid sensor)\n"
+    "  CONFIGURE TEMP abc      (non-numeric frequency)\n"
+    "\n"
+    "NOTES:\n"
+    "\n"
+    "  - Commands are case-insensitive\n"
+    "  - Streaming must be running to apply configuration\n"
+    "  - A gateway whose link drops is reconnected in the background;\n"
+    "    its rates and START are restored and the missing span is\n"
+    "    shaded as a gap (--no-reconnect disconnects instead)\n"
+    "  - With --multicast the batches arrive over the gateway's UDP\n"
+    "    group; lost datagrams are counted in the PERF report\n"
+    "  - On the plot the mouse wheel zooms, dragging pans (and freezes\n"
+    "    the view, see the Freeze button) and a right click goes back\n"
+    "    to the live view. The cursor shows each sensor's value.\n"
+    "\n"
+    "Press Ctrl+C to close this window.\n";
+
+const char *help_text(void)
+{
+    return help_body;
+}
+
 gboolean is_valid_ipv4(const char *ip)
 {
     if (!ip || !*ip)
@@ -26,6 +158,37 @@ gboolean is_valid_ipv4(const char *ip)
     return TRUE;
 }
 
+/*
+ * Split "a.b.c.d, e.f.g.h ..." (comma or space separated) into out.
+ * Returns the number of addresses, or -1 if any of them is invalid or
+ * there are more than max.
+ */
+int parse_ipv4_list(const char *text, char out[][64], int max)
+{
+    if (!text)
+        return -1;
+
+    char **parts = g_strsplit_set(text, ", ", -1);
+    int n = 0;
+
+    for (int i = 0; parts[i]; i++)
+    {
+        if (!*parts[i])
+            continue;
+
+        if (n == max || !is_valid_ipv4(parts[i]))
+        {
+            n = -1;
+            break;
+        }
+
+        g_strlcpy(out[n++], parts[i], 64);
+    }
+
+    g_strfreev(parts);
+    return n;
+}
+
 void set_enabled(GtkWidget *w, gboolean e)
 {
     gtk_widget_set_sensitive(w, e);
@@ -76,6 +239,7 @@ gboolean clear_cmd_feedback(gpointer data)
     gtk_style_context_remove_class(lc, "text-red");
 
     gtk_label_set_text(GTK_LABEL(ctx->label), "");
+    gtk_widget_set_tooltip_text(ctx->label, NULL);
 
     /* RESET command icon to idle */
     gtk_entry_set_icon_from_icon_name(
@@ -85,7 +249,5 @@ gboolean clear_cmd_feedback(gpointer data)
 
     gtk_entry_set_text(GTK_ENTRY(ctx->entry), "");
     gtk_widget_set_sensitive(ctx->entry, TRUE);
-
-    g_free(ctx);
     return FALSE;
 }
@@ -1,53 +1,25 @@
+#ifndef UTILS_H
+#define UTILS_H
+
 #include <gtk/gtk.h>
 
 #include <unistd.h>
 #include <stdint.h>
 
 #define PORT 50012
-#define SENSOR_COUNT 5
+#define SENSOR_COUNT 5  /* built-in sensors, see sensor_id_t */
+#define MAX_CHANNELS 64 /* channel registry size, see channels.h */
 #define CMD_HISTORY_SIZE 5
-#define MAX_SAMPLES 1024
+#define CMD_LINE_MAX 1024 /* command entry text, history entries */
 // #define TIME_WINDOW_US 5e6 // 5 seconds visible
 #define Y_AXIS_MAX 5.0
 
 extern uint64_t time_window_us;
 
-static const char *HELP_TEXT =
-    "Measurement Network Gateway – CLI Help\n"
-    "\n"
-    "VALID COMMANDS:\n"
-    "\n"
-    "  CONFIGURE <SENSOR_ID> <FREQ_HZ>\n"
-    "\n"
-    "    SENSOR_ID:\n"
-    "      TEMP   - Temperature sensor\n"
-    "      ADC0   - ADC channel 0\n"
-    "      ADC1   - ADC channel 1\n"
-    "      SW     - Switch inputs\n"
-    "      PB     - Push buttons\n"
-    "\n"
-    "    FREQ_HZ:\n"
-    "      Integer value between 10 and 1000\n"
-    "\n"
-    "EXAMPLES:\n"
-    "\n"
-    "  CONFIGURE TEMP 50\n"
-    "  CONFIGURE ADC0 200\n"
-    "\n"
-    "INVALID EXAMPLES:\n"
-    "\n"
-    "  CONFIGURE TEMP 9        (frequency too low)\n"
-    "  CONFIGURE ADC1 1001     (frequency too high)\n"
-    "  CONFIGURE XYZ 100       (invalid sensor)\n"
-    "  CONFIGURE TEMP abc      (non-numeric frequency)\n"
-    "\n"
-    "NOTES:\n"
-    "\n"
-    "  - Commands are case-insensitive\n"
-    "  - Streaming must be running to apply configuration\n"
-    "\n"
-    "Press Ctrl+C to close this window.\n";
+/* Full HELP text */
+const char *help_text(void);
 
+/* Built-in sensors; also their channel registry indices */
 typedef enum
 {
     temp_sid = 0,
@@ -74,8 +46,10 @@ typedef struct
 typedef enum
 {
     STATE_DISCONNECTED,
+    STATE_CONNECTING,
     STATE_CONNECTED,
-    STATE_RUNNING
+    STATE_RUNNING,
+    STATE_REPLAYING
 } AppState;
 
 typedef struct
@@ -89,7 +63,13 @@ typedef enum
     CMD_OK = 0,
     CMD_ERR_SYNTAX,
     CMD_ERR_SENSOR,
-    CMD_ERR_FREQ_RANGE
+    CMD_ERR_FREQ_RANGE,
+    CMD_ERR_WINDOW_RANGE,
+    CMD_ERR_STATE,
+    CMD_ERR_FILE,
+    CMD_ERR_BUSY,
+    CMD_ERR_PROFILE,
+    CMD_ERR_TRIGGER_RANGE
 } CmdError;
 
 typedef enum
@@ -104,8 +84,12 @@ typedef enum
     CMD_HELP
 } CmdType;
 
+/* sensor_id is a channel registry index here, not the gateway's */
 typedef struct {
-    sensor_rate_t rates[SENSOR_COUNT];
+    int gateway;
+    guint gen;
+    int count;
+    sensor_rate_t rates[MAX_CHANNELS];
 } RatesMsg;
 
 
@@ -118,7 +102,10 @@ typedef struct
 } Cmd;
 
 gboolean is_valid_ipv4(const char *ip);
+int parse_ipv4_list(const char *text, char out[][64], int max);
 void set_enabled(GtkWidget *w, gboolean e);
 void load_css(void);
 
-gboolean clear_cmd_feedback(gpointer data);
\ No newline at end of file
+gboolean clear_cmd_feedback(gpointer data);
+
+#endif
@@ -0,0 +1,222 @@
+#include <pthread.h>
+
+#include "xform.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define XFORM_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define XFORM_NEON 1
+#endif
+
+/*
+ * Signed 64-bit integer to double without AVX-512: added to the bits of
+ * 2^52 + 2^51, a value below 2^51 in magnitude lands in the mantissa
+ * exactly, and subtracting that constant as a double leaves it.
+ */
+#define I64_MAGIC_BITS 0x4338000000000000LL
+#define I64_MAGIC 6755399441055744.0 /* 2^52 + 2^51 */
+
+/* ---------- Scalar ---------- */
+
+static void time_px_scalar(const uint64_t *ts, int n, uint64_t t_min,
+                           double px_per_us, float *out)
+{
+    for (int i = 0; i < n; i++)
+        out[i] = (float)((double)(int64_t)(ts[i] - t_min) * px_per_us);
+}
+
+static void value_px_scalar(const double *v, int n, double y0, double plot_h,
+                            double y_max, float *out)
+{
+    for (int i = 0; i < n; i++)
+    {
+        double norm = v[i] / y_max;
+
+        if (norm < 0.0)
+            norm = 0.0;
+        else if (norm > 1.0)
+            norm = 1.0;
+
+        out[i] = (float)(y0 - plot_h * norm);
+    }
+}
+
+/* ---------- x86-64 ---------- */
+
+#ifdef XFORM_X86
+/* SSE2 is part of x86-64, so this one needs no runtime check */
+static void time_px_sse2(const uint64_t *ts, int n, uint64_t t_min,
+                         double px_per_us, float *out)
+{
+    const __m128i base = _mm_set1_epi64x((long long)t_min);
+    const __m128i magic_i = _mm_set1_epi64x(I64_MAGIC_BITS);
+    const __m128d magic = _mm_set1_pd(I64_MAGIC);
+    const __m128d k = _mm_set1_pd(px_per_us);
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i d = _mm_sub_epi64(_mm_loadu_si128((const __m128i *)(ts + i)),
+                                  base);
+        __m128d x = _mm_sub_pd(_mm_castsi128_pd(_mm_add_epi64(d, magic_i)),
+                               magic);
+
+        _mm_storel_pi((__m64 *)(out + i), _mm_cvtpd_ps(_mm_mul_pd(x, k)));
+    }
+    time_px_scalar(ts + i, n - i, t_min, px_per_us, out + i);
+}
+
+static void value_px_sse2(const double *v, int n, double y0, double plot_h,
+                          double y_max, float *out)
+{
+    const __m128d vy0 = _mm_set1_pd(y0), vh = _mm_set1_pd(plot_h);
+    const __m128d vmax = _mm_set1_pd(y_max);
+    const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0);
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d norm = _mm_div_pd(_mm_loadu_pd(v + i), vmax);
+
+        norm = _mm_min_pd(_mm_max_pd(norm, zero), one);
+        _mm_storel_pi((__m64 *)(out + i),
+                      _mm_cvtpd_ps(_mm_sub_pd(vy0, _mm_mul_pd(vh, norm))));
+    }
+    value_px_scalar(v + i, n - i, y0, plot_h, y_max, out + i);
+}
+
+__attribute__((target("avx2"))) static void
+time_px_avx2(const uint64_t *ts, int n, uint64_t t_min, double px_per_us,
+             float *out)
+{
+    const __m256i base = _mm256_set1_epi64x((long long)t_min);
+    const __m256i magic_i = _mm256_set1_epi64x(I64_MAGIC_BITS);
+    const __m256d magic = _mm256_set1_pd(I64_MAGIC);
+    const __m256d k = _mm256_set1_pd(px_per_us);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i d = _mm256_sub_epi64(
+            _mm256_loadu_si256((const __m256i *)(ts + i)), base);
+        __m256d x = _mm256_sub_pd(
+            _mm256_castsi256_pd(_mm256_add_epi64(d, magic_i)), magic);
+
+        _mm_storeu_ps(out + i, _mm256_cvtpd_ps(_mm256_mul_pd(x, k)));
+    }
+    time_px_scalar(ts + i, n - i, t_min, px_per_us, out + i);
+}
+
+__attribute__((target("avx2"))) static void
+value_px_avx2(const double *v, int n, double y0, double plot_h, double y_max,
+              float *out)
+{
+    const __m256d vy0 = _mm256_set1_pd(y0), vh = _mm256_set1_pd(plot_h);
+    const __m256d vmax = _mm256_set1_pd(y_max);
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d norm = _mm256_div_pd(_mm256_loadu_pd(v + i), vmax);
+
+        norm = _mm256_min_pd(_mm256_max_pd(norm, zero), one);
+        _mm_storeu_ps(out + i, _mm256_cvtpd_ps(
+                                   _mm256_sub_pd(vy0, _mm256_mul_pd(vh, norm))));
+    }
+    value_px_scalar(v + i, n - i, y0, plot_h, y_max, out + i);
+}
+#endif
+
+/* ---------- AArch64 ---------- */
+
+#ifdef XFORM_NEON
+static void time_px_neon(const uint64_t *ts, int n, uint64_t t_min,
+                         double px_per_us, float *out)
+{
+    const uint64x2_t base = vdupq_n_u64(t_min);
+    const float64x2_t k = vdupq_n_f64(px_per_us);
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2)
+    {
+        int64x2_t d = vreinterpretq_s64_u64(vsubq_u64(vld1q_u64(ts + i), base));
+
+        vst1_f32(out + i, vcvt_f32_f64(vmulq_f64(vcvtq_f64_s64(d), k)));
+    }
+    time_px_scalar(ts + i, n - i, t_min, px_per_us, out + i);
+}
+
+static void value_px_neon(const double *v, int n, double y0, double plot_h,
+                          double y_max, float *out)
+{
+    const float64x2_t vy0 = vdupq_n_f64(y0), vh = vdupq_n_f64(plot_h);
+    const float64x2_t vmax = vdupq_n_f64(y_max);
+    const float64x2_t zero = vdupq_n_f64(0.0), one = vdupq_n_f64(1.0);
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2)
+    {
+        float64x2_t norm = vdivq_f64(vld1q_f64(v + i), vmax);
+
+        norm = vminq_f64(vmaxq_f64(norm, zero), one);
+        vst1_f32(out + i, vcvt_f32_f64(vsubq_f64(vy0, vmulq_f64(vh, norm))));
+    }
+    value_px_scalar(v + i, n - i, y0, plot_h, y_max, out + i);
+}
+#endif
+
+/* ---------- Dispatch ---------- */
+
+static struct
+{
+    void (*time_px)(const uint64_t *, int, uint64_t, double, float *);
+    void (*value_px)(const double *, int, double, double, double, float *);
+    const char *name;
+} impl = {time_px_scalar, value_px_scalar, "scalar"};
+
+static pthread_once_t impl_once = PTHREAD_ONCE_INIT;
+
+static void xform_pick(void)
+{
+#if defined(XFORM_X86)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        impl.time_px = time_px_avx2;
+        impl.value_px = value_px_avx2;
+        impl.name = "avx2";
+    }
+    else
+    {
+        impl.time_px = time_px_sse2;
+        impl.value_px = value_px_sse2;
+        impl.name = "sse2";
+    }
+#elif defined(XFORM_NEON)
+    impl.time_px = time_px_neon;
+    impl.value_px = value_px_neon;
+    impl.name = "neon";
+#endif
+}
+
+void xform_time_px(const uint64_t *ts, int n, uint64_t t_min,
+                   double px_per_us, float *out)
+{
+    pthread_once(&impl_once, xform_pick);
+    impl.time_px(ts, n, t_min, px_per_us, out);
+}
+
+void xform_value_px(const double *v, int n, double y0, double plot_h,
+                    double y_max, float *out)
+{
+    pthread_once(&impl_once, xform_pick);
+    impl.value_px(v, n, y0, plot_h, y_max, out);
+}
+
+const char *xform_backend(void)
+{
+    pthread_once(&impl_once, xform_pick);
+    return impl.name;
+}
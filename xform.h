@@ -0,0 +1,29 @@
+#ifndef XFORM_H
+#define XFORM_H
+
+#include <stdint.h>
+
+/* ---------- Batch sample transforms ----------
+ *
+ * The per-point arithmetic of the trace paths, over whole arrays at a
+ * time: timestamps to pixel columns, and values to pixel rows (scaled by
+ * the channel's full scale and clamped to the plot). Both write float
+ * pixel coordinates.
+ *
+ * The kernels use AVX2 or SSE2 on x86-64 and NEON on AArch64, picked
+ * once at runtime; anything else runs the scalar loop. All of them give
+ * the same results as the scalar code.
+ */
+
+/* out[i] = (ts[i] - t_min) * px_per_us; |ts[i] - t_min| < 2^51 us */
+void xform_time_px(const uint64_t *ts, int n, uint64_t t_min,
+                   double px_per_us, float *out);
+
+/* out[i] = y0 - plot_h * clamp(v[i] / y_max, 0, 1) */
+void xform_value_px(const double *v, int n, double y0, double plot_h,
+                    double y_max, float *out);
+
+/* "avx2", "sse2", "neon" or "scalar" */
+const char *xform_backend(void);
+
+#endif